@@ -0,0 +1,78 @@
+/** @file */
+#include "check.h"
+
+#include <time.h>
+
+#include <sys/random.h>
+#include <unistd.h>
+
+#include "aleatorio.h"
+
+uint64_t splitmix64 (uint64_t * x)
+{
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+void aleatorio_semeia (aleatorio * a, uint64_t semente)
+{
+	assert(a != NULL);
+
+	/* o splitmix64 nunca da quatro zeros seguidos */
+	for (size_t i = 0; i < 4; i++)
+		a->s[i] = splitmix64(&semente);
+}
+
+uint64_t aleatorio_semente (void)
+{
+	static _Atomic uint64_t contador = 0;
+	uint64_t ret = 0;
+
+	if (getrandom(&ret, sizeof(ret), GRND_NONBLOCK) != sizeof(ret)) {
+		/* sem entropia do kernel, mistura o relogio, o pid e um contador */
+		struct timespec t;
+		clock_gettime(CLOCK_MONOTONIC, &t);
+		ret = ((uint64_t) t.tv_sec << 32) ^ (uint64_t) t.tv_nsec ^ ((uint64_t) getpid() << 16);
+	}
+
+	ret ^= contador++;
+	return splitmix64(&ret);
+}
+
+/**
+ * @brief Roda um numero de 64 bits para a esquerda.
+ * @param x O numero.
+ * @param k O numero de bits, entre 1 e 63.
+ * @returns O numero rodado.
+ */
+uint64_t rotl (uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+uint64_t aleatorio_proximo (aleatorio * a)
+{
+	assert(a != NULL);
+
+	uint64_t * s = a->s;
+	uint64_t ret = rotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+
+	return ret;
+}
+
+uint32_t aleatorio_ate (aleatorio * a, uint32_t n)
+{
+	assert(n > 0);
+	/* multiplica em vez de dividir; o enviesamento e no maximo n / 2^32 */
+	return ((aleatorio_proximo(a) >> 32) * n) >> 32;
+}
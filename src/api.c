@@ -0,0 +1,384 @@
+/** @file */
+#include "check.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "posicao.h"
+#include "estado.h"
+#include "jogo.h"
+
+#include "html.h"
+#include "saida.h"
+
+#include "api.h"
+
+const api_formato_s * api_formatos (void)
+{
+	static const api_formato_s ret[API_FORMATOS_QUANTOS] = {
+		[API_HTML]    = { "html", CONTENT_TYPE,               imprime_jogo,        NULL },
+		[API_JSON]    = { "json", "application/json",         api_imprime_json,    api_imprime_json_delta },
+		[API_BINARIO] = { "bin",  "application/octet-stream", api_imprime_binario, api_imprime_binario_delta },
+	};
+	return ret;
+}
+
+bool api_mesmo_nivel (const estado_p a, const estado_p b)
+{
+	assert(a != NULL);
+	assert(b != NULL);
+
+	ifjmp(a->nivel != b->nivel || !posicao_igual(a->porta, b->porta), err);
+	ifjmp(a->num_obstaculos != b->num_obstaculos, err);
+
+	for (size_t i = 0; i < a->num_obstaculos; i++)
+		ifjmp(!posicao_igual(a->obstaculo[i].pos, b->obstaculo[i].pos), err);
+
+	return true;
+err:
+	return false;
+}
+
+/**
+ * @brief O que mudou nos inimigos entre dois estados do mesmo nivel.
+ */
+typedef struct {
+	/** Os indices, no estado novo, dos inimigos novos ou que mudaram. */
+	size_t * mudados;
+	/** O numero de inimigos em `mudados`. */
+	size_t num_mudados;
+	/** Os ids dos inimigos que morreram. */
+	uint32_t * removidos;
+	/** O numero de inimigos em `removidos`. */
+	size_t num_removidos;
+} api_delta;
+
+/**
+ * @brief Compara os inimigos de dois estados do mesmo nivel, pelo id.
+ * @param e O estado novo.
+ * @param antes O estado antigo.
+ * @returns O que mudou, que tem de ser libertado com `api_delta_liberta()`.
+ */
+api_delta api_delta_calcula (const estado_p e, const estado_p antes)
+{
+	api_delta ret = { 0 };
+	uint32_t max = 0;
+
+	for (size_t i = 0; i < e->num_inimigos; i++)
+		if (e->inimigo[i].id > max)
+			max = e->inimigo[i].id;
+	for (size_t i = 0; i < antes->num_inimigos; i++)
+		if (antes->inimigo[i].id > max)
+			max = antes->inimigo[i].id;
+
+	/* por id, o indice do inimigo em `antes` mais 1, para que 0 seja nenhum */
+	uint32_t * ind = calloc((size_t) max + 1, sizeof(uint32_t));
+	ret.mudados = malloc((e->num_inimigos + 1) * sizeof(size_t));
+	ret.removidos = malloc((antes->num_inimigos + 1) * sizeof(uint32_t));
+	check(ind == NULL || ret.mudados == NULL || ret.removidos == NULL, "could not allocate delta");
+
+	for (size_t i = 0; i < antes->num_inimigos; i++)
+		ind[antes->inimigo[i].id] = i + 1;
+
+	for (size_t i = 0; i < e->num_inimigos; i++) {
+		const entidade * novo = e->inimigo + i;
+		uint32_t k = ind[novo->id];
+		const entidade * velho = (k > 0) ? antes->inimigo + (k - 1) : NULL;
+
+		if (velho == NULL || !posicao_igual(novo->pos, velho->pos) || novo->vida != velho->vida)
+			ret.mudados[ret.num_mudados++] = i;
+
+		/* os que ficarem marcados morreram */
+		ind[novo->id] = 0;
+	}
+
+	for (size_t i = 0; i < antes->num_inimigos; i++)
+		if (ind[antes->inimigo[i].id] != 0)
+			ret.removidos[ret.num_removidos++] = antes->inimigo[i].id;
+
+	free(ind);
+	return ret;
+}
+
+/**
+ * @brief Liberta o que foi calculado por `api_delta_calcula()`.
+ * @param d O que mudou.
+ */
+void api_delta_liberta (api_delta * d)
+{
+	free(d->mudados);
+	free(d->removidos);
+	d->mudados = NULL;
+	d->removidos = NULL;
+}
+
+/**
+ * @brief Escreve uma string JSON na saida, com as aspas.
+ * @param s A string.
+ */
+void api_json_str (const char * s)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	assert(s != NULL);
+
+	saida_char('"');
+	for (; *s != '\0'; s++) {
+		unsigned char c = *s;
+		if (c == '"' || c == '\\') {
+			saida_char('\\');
+			saida_char(c);
+		} else if (c < 0x20) {
+			char u[] = "\\u00XX";
+			u[4] = hex[c >> 4];
+			u[5] = hex[c & 0xf];
+			SAIDA_LITERAL(u);
+		} else {
+			saida_char(c);
+		}
+	}
+	saida_char('"');
+}
+
+/**
+ * @brief Escreve uma posicao JSON na saida, `[x,y`, sem fechar o array.
+ * @param p A posicao.
+ */
+void api_json_posicao (posicao_s p)
+{
+	saida_char('[');
+	saida_num(p.x);
+	saida_char(',');
+	saida_num(p.y);
+}
+
+/**
+ * @brief Calcula as jogadas possiveis, que nao ha se o jogo tiver acabado.
+ * @param e O estado.
+ * @param dst Onde escrever as jogadas, com espaco para `NJOGADAS(e->tam)`.
+ * @returns O numero de jogadas.
+ */
+size_t api_jogadas (const estado_p e, jogada_p dst)
+{
+	return (fim_de_jogo(e)) ?
+		0 :
+		jogadas_possiveis(e, dst);
+}
+
+/**
+ * @brief Escreve um inimigo JSON na saida, `[id,x,y,vida]`.
+ * @param inimigo O inimigo.
+ */
+void api_json_inimigo (const entidade * inimigo)
+{
+	saida_char('[');
+	saida_num(inimigo->id);
+	saida_char(',');
+	saida_num(inimigo->pos.x);
+	saida_char(',');
+	saida_num(inimigo->pos.y);
+	saida_char(',');
+	saida_num(inimigo->vida);
+	saida_char(']');
+}
+
+/**
+ * @brief Escreve na saida os campos JSON que mudam em todos os turnos.
+ * @param e O estado.
+ */
+void api_json_turno (const estado_p e)
+{
+	SAIDA_LITERAL(",\"mov_type\":");
+	saida_num(e->mov_type);
+	SAIDA_LITERAL(",\"score\":");
+	saida_num(e->score);
+	if (fim_de_jogo(e))
+		SAIDA_LITERAL(",\"fim\":true");
+	else
+		SAIDA_LITERAL(",\"fim\":false");
+
+	/* o jogador leva a vida no fim */
+	SAIDA_LITERAL(",\"jogador\":");
+	api_json_posicao(e->jog.pos);
+	saida_char(',');
+	saida_num(e->jog.vida);
+	saida_char(']');
+}
+
+/**
+ * @brief Escreve na saida as jogadas possiveis, o ultimo campo JSON, e fecha o objecto.
+ * @param e O estado.
+ */
+void api_json_jogadas (const estado_p e)
+{
+	jogada_p j = aloca_jogadas(e);
+	size_t N = api_jogadas(e, j);
+
+	SAIDA_LITERAL(",\"jogadas\":[");
+	for (size_t i = 0; i < N; i++) {
+		if (i > 0)
+			saida_char(',');
+		api_json_posicao(j[i].dest);
+		saida_char(',');
+		api_json_str(j[i].link);
+		saida_char(']');
+	}
+	SAIDA_LITERAL("]}\n");
+
+	free(j);
+}
+
+void api_imprime_json (const estado_p e)
+{
+	assert(e != NULL);
+
+	SAIDA_LITERAL("{\"turno\":");
+	saida_num(e->turno);
+	SAIDA_LITERAL(",\"delta\":false,\"nome\":");
+	api_json_str(e->nome);
+	SAIDA_LITERAL(",\"nivel\":");
+	saida_num(e->nivel);
+	SAIDA_LITERAL(",\"tam\":");
+	api_json_posicao(e->tam);
+	saida_char(']');
+	api_json_turno(e);
+	SAIDA_LITERAL(",\"porta\":");
+	api_json_posicao(e->porta);
+
+	SAIDA_LITERAL("],\"inimigos\":[");
+	for (size_t i = 0; i < e->num_inimigos; i++) {
+		if (i > 0)
+			saida_char(',');
+		api_json_inimigo(e->inimigo + i);
+	}
+
+	SAIDA_LITERAL("],\"obstaculos\":[");
+	for (size_t i = 0; i < e->num_obstaculos; i++) {
+		if (i > 0)
+			saida_char(',');
+		api_json_posicao(e->obstaculo[i].pos);
+		saida_char(']');
+	}
+	saida_char(']');
+
+	api_json_jogadas(e);
+}
+
+void api_imprime_json_delta (const estado_p e, const estado_p antes)
+{
+	assert(e != NULL);
+	assert(antes != NULL);
+
+	api_delta d = api_delta_calcula(e, antes);
+
+	SAIDA_LITERAL("{\"turno\":");
+	saida_num(e->turno);
+	SAIDA_LITERAL(",\"delta\":true");
+	api_json_turno(e);
+
+	SAIDA_LITERAL(",\"inimigos\":[");
+	for (size_t i = 0; i < d.num_mudados; i++) {
+		if (i > 0)
+			saida_char(',');
+		api_json_inimigo(e->inimigo + d.mudados[i]);
+	}
+
+	SAIDA_LITERAL("],\"removidos\":[");
+	for (size_t i = 0; i < d.num_removidos; i++) {
+		if (i > 0)
+			saida_char(',');
+		saida_num(d.removidos[i]);
+	}
+	saida_char(']');
+
+	api_json_jogadas(e);
+	api_delta_liberta(&d);
+}
+
+/**
+ * @brief Escreve um inimigo na saida, no formato binario.
+ * @param inimigo O inimigo.
+ */
+void api_binario_inimigo (const entidade * inimigo)
+{
+	api_inimigo a = {
+		.id = inimigo->id,
+		.pos = inimigo->pos,
+		.vida = inimigo->vida,
+	};
+	saida_escreve(&a, sizeof(a));
+}
+
+/**
+ * @brief Escreve o cabecalho binario na saida.
+ * @param e O estado.
+ * @param delta Se a resposta so tem o que mudou.
+ * @param ni O numero de inimigos na resposta.
+ * @param no O numero de obstaculos na resposta.
+ * @param nr O numero de inimigos que morreram.
+ * @param nj O numero de jogadas possiveis.
+ */
+void api_binario_cabecalho (const estado_p e, bool delta, size_t ni, size_t no, size_t nr, size_t nj)
+{
+	api_cabecalho cab = {
+		.versao = API_VERSAO,
+		.nivel = e->nivel,
+		.mov_type = e->mov_type,
+		.fim = fim_de_jogo(e),
+		.tam = e->tam,
+		.jog = e->jog.pos,
+		.porta = e->porta,
+		.vida = e->jog.vida,
+		.delta = delta,
+		.turno = e->turno,
+		.score = e->score,
+		.num_inimigos = ni,
+		.num_obstaculos = no,
+		.num_removidos = nr,
+		.num_jogadas = nj,
+	};
+	memcpy(cab.magic, API_MAGIC, sizeof(cab.magic));
+	saida_escreve(&cab, sizeof(cab));
+}
+
+void api_imprime_binario (const estado_p e)
+{
+	assert(e != NULL);
+
+	jogada_p j = aloca_jogadas(e);
+	size_t N = api_jogadas(e, j);
+	api_binario_cabecalho(e, false, e->num_inimigos, e->num_obstaculos, 0, N);
+
+	for (size_t i = 0; i < e->num_inimigos; i++)
+		api_binario_inimigo(e->inimigo + i);
+
+	for (size_t i = 0; i < e->num_obstaculos; i++)
+		saida_escreve(&e->obstaculo[i].pos, sizeof(posicao_s));
+
+	for (size_t i = 0; i < N; i++)
+		saida_escreve(&j[i].dest, sizeof(posicao_s));
+
+	free(j);
+}
+
+void api_imprime_binario_delta (const estado_p e, const estado_p antes)
+{
+	assert(e != NULL);
+	assert(antes != NULL);
+
+	api_delta d = api_delta_calcula(e, antes);
+	jogada_p j = aloca_jogadas(e);
+	size_t N = api_jogadas(e, j);
+	api_binario_cabecalho(e, true, d.num_mudados, 0, d.num_removidos, N);
+
+	for (size_t i = 0; i < d.num_mudados; i++)
+		api_binario_inimigo(e->inimigo + d.mudados[i]);
+
+	saida_escreve(d.removidos, d.num_removidos * sizeof(uint32_t));
+
+	for (size_t i = 0; i < N; i++)
+		saida_escreve(&j[i].dest, sizeof(posicao_s));
+
+	free(j);
+	api_delta_liberta(&d);
+}
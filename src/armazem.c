@@ -0,0 +1,430 @@
+/** @file */
+#define _GNU_SOURCE
+#include "check.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "estado.h"
+#include "slab.h"
+
+#include "armazem.h"
+
+/**
+ * @brief As operacoes de um tipo de armazenamento.
+ */
+typedef struct {
+	/** O nome usado em `ROGUE_ARMAZEM`. */
+	const char * nome;
+	/** Le um estado; devolve falso se nao conseguir. */
+	bool (* ler) (const char * nome, estado_p e);
+	/** Escreve varios estados e, se pedido, espera que estejam no disco. */
+	void (* escreve) (const estado_s * es, size_t n, bool sync);
+	/** Verifica se um jogador existe. */
+	bool (* existe) (const char * nome);
+} armazem_handler;
+
+/**
+ * @brief O tipo de armazenamento em uso, ou `ARMAZEM_QUANTOS` se ainda nao foi escolhido.
+ */
+enum armazem_tipo armazem_actual = ARMAZEM_QUANTOS;
+
+enum durabilidade armazem_durabilidade (void)
+{
+	static const char * nomes[DURABILIDADE_QUANTOS] = {
+		[DURABILIDADE_NENHUMA] = "nenhuma",
+		[DURABILIDADE_FSYNC]   = "fsync",
+		[DURABILIDADE_GRUPO]   = "grupo",
+	};
+	static enum durabilidade ret = DURABILIDADE_QUANTOS;
+
+	if (ret == DURABILIDADE_QUANTOS) {
+		const char * env = getenv("ROGUE_DURABILIDADE");
+		ret = DURABILIDADE_NENHUMA;
+		for (size_t i = 0; env != NULL && i < DURABILIDADE_QUANTOS; i++)
+			if (strcmp(env, nomes[i]) == 0)
+				ret = i;
+	}
+
+	return ret;
+}
+
+unsigned armazem_grupo_ms (void)
+{
+	const char * env = getenv("ROGUE_GRUPO_MS");
+	unsigned ret = (env != NULL) ?
+		strtoul(env, NULL, 10) :
+		0;
+	return (ret > 0) ?
+		ret :
+		ARMAZEM_GRUPO_MS;
+}
+
+const char * armazem_pasta (void)
+{
+	static const char * ret = NULL;
+
+	if (ret == NULL) {
+		ret = getenv("ROGUE_BASE_PATH");
+		if (ret == NULL || *ret == '\0')
+			ret = BASE_PATH;
+	}
+
+	return ret;
+}
+
+char * armazem_slab_path (void)
+{
+	static _Thread_local char ret[PATH_MAX] = "";
+	int n = snprintf(ret, sizeof(ret), "%s", armazem_pasta());
+
+	while (n > 1 && ret[n - 1] == '/')
+		ret[--n] = '\0';
+	snprintf(ret + n, sizeof(ret) - n, ".slab");
+
+	return ret;
+}
+
+char * pathname (const char * name)
+{
+	static _Thread_local char ret[PATH_MAX] = "";
+	snprintf(ret, sizeof(ret), "%s%s", armazem_pasta(), name);
+	return ret;
+}
+
+/**
+ * @brief Le um estado de um ficheiro.
+ * @param path O caminho do ficheiro.
+ * @param e Onde guardar o estado.
+ * @returns Verdadeiro se conseguiu ler um estado valido, falso caso contrario.
+ */
+bool ficheiro_ler (const char * path, estado_p e)
+{
+	uchar * buf = NULL;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	ifjmp(fd < 0, err);
+
+	struct stat st;
+	ifjmp(fstat(fd, &st) < 0, err);
+	ifjmp((size_t) st.st_size < sizeof(estado_cabecalho), err);
+	ifjmp((size_t) st.st_size > ESTADO_TAMANHO_MAX(TAM_MAX, TAM_MAX), err);
+
+	buf = malloc(st.st_size);
+	ifjmp(buf == NULL, err);
+
+	ssize_t n = 0;
+	for (ssize_t r = 1; n < st.st_size && r > 0; n += r)
+		r = read(fd, buf + n, st.st_size - n);
+	ifjmp(n != st.st_size, err);
+
+	bool ret = estado_desserializa(e, buf, n);
+	free(buf);
+	close(fd);
+
+	return ret;
+err:
+	free(buf);
+	if (fd >= 0)
+		close(fd);
+	return false;
+}
+
+/**
+ * @brief Le um estado do ficheiro do jogador.
+ * @param nome Nome do jogador.
+ * @param e Onde guardar o estado.
+ * @returns Verdadeiro se conseguiu ler, falso caso contrario.
+ */
+bool ficheiros_ler (const char * nome, estado_p e)
+{
+	return ficheiro_ler(pathname(nome), e);
+}
+
+/**
+ * @brief Devolve um descritor da pasta dos estados, para a sincronizar.
+ * @returns O descritor.
+ */
+int ficheiros_pasta_fd (void)
+{
+	static int ret = -1;
+	if (ret < 0)
+		ret = open(armazem_pasta(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	check(ret < 0, "could not open state directory");
+	return ret;
+}
+
+/**
+ * @brief Calcula o caminho do ficheiro temporario de um jogador.
+ * @param nome Nome do jogador.
+ * @param tmp Onde guardar o caminho, com `PATH_MAX` bytes.
+ */
+void ficheiros_tmp (const char * nome, char * tmp)
+{
+	/* comeca por `.`, logo nao e confundido com um jogador */
+	snprintf(tmp, PATH_MAX, "%s.%s.%ld", armazem_pasta(), nome, (long) getpid());
+}
+
+/**
+ * @brief Escreve estados nos ficheiros dos jogadores.
+ *
+ * Cada estado e escrito num ficheiro temporario que depois substitui o
+ * ficheiro do jogador com `rename()`, por isso quem le ve sempre um estado
+ * completo. Com `sync`, os temporarios vao para o disco (com um unico
+ * `fsync()`/`syncfs()`) antes dos `rename()`, e a pasta depois deles.
+ * @param es Os estados.
+ * @param n O numero de estados.
+ * @param sync Se deve esperar que os estados estejam no disco.
+ */
+void ficheiros_escreve (const estado_s * es, size_t n, bool sync)
+{
+	char tmp[PATH_MAX] = "";
+	int fd = -1;
+	uchar * buf = NULL;
+	size_t cap = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		size_t tam = estado_tamanho((estado_p) es + i);
+		if (tam > cap) {
+			buf = realloc(buf, tam);
+			check(buf == NULL, "could not allocate state buffer");
+			cap = tam;
+		}
+		estado_serializa((estado_p) es + i, buf);
+
+		ficheiros_tmp(es[i].nome, tmp);
+
+		fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+		check(fd < 0, "could not open state file to write");
+
+		check(write(fd, buf, tam) != (ssize_t) tam,
+		      "could not write to state file");
+
+		if (sync && n == 1)
+			check(fsync(fd) < 0, "could not sync state file");
+
+		close(fd);
+	}
+
+	free(buf);
+
+	if (sync && n > 1)
+		check(syncfs(ficheiros_pasta_fd()) < 0, "could not sync state files");
+
+	for (size_t i = 0; i < n; i++) {
+		ficheiros_tmp(es[i].nome, tmp);
+		check(rename(tmp, pathname(es[i].nome)) < 0, "could not replace state file");
+	}
+
+	if (sync)
+		check(fsync(ficheiros_pasta_fd()) < 0, "could not sync state directory");
+}
+
+/**
+ * @brief Verifica se existe o ficheiro de um jogador.
+ * @param nome Nome do jogador.
+ * @returns Verdadeiro se existir e se puder ler e escrever, falso caso contrario.
+ */
+bool ficheiros_existe (const char * nome)
+{
+	return access(pathname(nome), F_OK | R_OK | W_OK) == 0;
+}
+
+/**
+ * @brief Abre o ficheiro slab, se ainda nao estiver aberto.
+ */
+void armazem_slab_abre (void)
+{
+	static bool aberto = false;
+	if (!aberto)
+		slab_abre(armazem_slab_path());
+	aberto = true;
+}
+
+/**
+ * @brief Le um estado do ficheiro slab.
+ * @param nome Nome do jogador.
+ * @param e Onde guardar o estado.
+ * @returns Verdadeiro se conseguiu ler, falso caso contrario.
+ */
+bool armazem_slab_ler (const char * nome, estado_p e)
+{
+	uchar buf[SLAB_DADOS];
+	size_t n = 0;
+
+	armazem_slab_abre();
+	ifjmp(!slab_ler(nome, buf, &n), err);
+
+	return (n == SLAB_EXTERNO) ?
+		ficheiros_ler(nome, e) :
+		estado_desserializa(e, buf, n);
+err:
+	return false;
+}
+
+/**
+ * @brief Escreve estados no ficheiro slab.
+ *
+ * Cada registo tem duas copias, logo uma escrita e sempre atomica; com
+ * `sync`, um lote e sincronizado de uma vez no fim. Os estados que nao
+ * cabem num registo vao para o ficheiro do jogador, e o registo fica
+ * marcado com `SLAB_EXTERNO`.
+ * @param es Os estados.
+ * @param n O numero de estados.
+ * @param sync Se deve esperar que os estados estejam no disco.
+ */
+void armazem_slab_escreve (const estado_s * es, size_t n, bool sync)
+{
+	uchar buf[SLAB_DADOS];
+
+	armazem_slab_abre();
+
+	for (size_t i = 0; i < n; i++) {
+		size_t tam = estado_tamanho((estado_p) es + i);
+
+		if (tam <= SLAB_DADOS) {
+			estado_serializa((estado_p) es + i, buf);
+			slab_escreve(es[i].nome, buf, tam, sync && n == 1);
+		} else {
+			ficheiros_escreve(es + i, 1, sync);
+			slab_escreve(es[i].nome, NULL, SLAB_EXTERNO, sync && n == 1);
+		}
+	}
+
+	if (sync && n > 1)
+		slab_sincroniza();
+}
+
+/**
+ * @brief Verifica se um jogador existe no ficheiro slab.
+ * @param nome Nome do jogador.
+ * @returns Verdadeiro se existir, falso caso contrario.
+ */
+bool armazem_slab_existe (const char * nome)
+{
+	armazem_slab_abre();
+	return slab_existe(nome);
+}
+
+/**
+ * @brief Devolve as operacoes de cada tipo de armazenamento.
+ * @returns Array de operacoes.
+ */
+const armazem_handler * armazem_handlers (void)
+{
+	static const armazem_handler ret[ARMAZEM_QUANTOS] = {
+		[ARMAZEM_FICHEIROS] = {
+			"ficheiros",
+			ficheiros_ler,
+			ficheiros_escreve,
+			ficheiros_existe,
+		},
+		[ARMAZEM_SLAB] = {
+			"slab",
+			armazem_slab_ler,
+			armazem_slab_escreve,
+			armazem_slab_existe,
+		},
+	};
+	return ret;
+}
+
+void armazem_usa (enum armazem_tipo t)
+{
+	assert(t < ARMAZEM_QUANTOS);
+	armazem_actual = t;
+}
+
+/**
+ * @brief Devolve as operacoes do tipo de armazenamento em uso.
+ * @returns As operacoes.
+ */
+const armazem_handler * armazem_handler_actual (void)
+{
+	const armazem_handler * handlers = armazem_handlers();
+
+	if (armazem_actual == ARMAZEM_QUANTOS) {
+		const char * env = getenv("ROGUE_ARMAZEM");
+		armazem_actual = ARMAZEM_FICHEIROS;
+		for (size_t i = 0; env != NULL && i < ARMAZEM_QUANTOS; i++)
+			if (strcmp(env, handlers[i].nome) == 0)
+				armazem_actual = i;
+	}
+
+	return handlers + armazem_actual;
+}
+
+bool armazem_ler (const char * nome, estado_p e)
+{
+	assert(nome != NULL);
+	assert(e != NULL);
+	return armazem_handler_actual()->ler(nome, e);
+}
+
+void armazem_escreve (const estado_p e)
+{
+	assert(e != NULL);
+	armazem_handler_actual()->escreve(e, 1, armazem_durabilidade() != DURABILIDADE_NENHUMA);
+}
+
+void armazem_escreve_lote (const estado_s * es, size_t n)
+{
+	assert(es != NULL);
+	ifjmp(n == 0, out);
+	armazem_handler_actual()->escreve(es, n, armazem_durabilidade() != DURABILIDADE_NENHUMA);
+out:
+	return;
+}
+
+bool armazem_existe (const char * nome)
+{
+	assert(nome != NULL);
+	return armazem_handler_actual()->existe(nome);
+}
+
+size_t armazem_importa (const char * pasta)
+{
+	assert(pasta != NULL);
+
+	DIR * d = opendir(pasta);
+	check(d == NULL, "could not open state directory");
+
+	size_t ret = 0;
+
+	for (struct dirent * de = readdir(d); de != NULL; de = readdir(d)) {
+		estado_s e;
+		char path[PATH_MAX] = "";
+		snprintf(path, sizeof(path), "%s/%s", pasta, de->d_name);
+
+		struct stat st;
+		if (de->d_name[0] == '.' || stat(path, &st) < 0 || !S_ISREG(st.st_mode))
+			continue;
+
+		/* so importa estados validos do jogador com o nome do ficheiro */
+		if (!ficheiro_ler(path, &e)) {
+			fprintf(stderr, "%s: not a state file, skipped\n", path);
+			continue;
+		}
+
+		if (strncmp(e.nome, de->d_name, sizeof(e.nome)) == 0) {
+			armazem_slab_escreve(&e, 1, false);
+			ret++;
+		} else {
+			fprintf(stderr, "%s: not a state file, skipped\n", path);
+		}
+
+		estado_liberta(&e);
+	}
+
+	closedir(d);
+
+	slab_sincroniza();
+
+	return ret;
+}
@@ -0,0 +1,90 @@
+/** @file */
+/**
+ * Compara o gerador de numeros aleatorios do jogo com os da libc.
+ *
+ * Uso: `bench-aleatorio [N]`
+ *
+ * Mede o custo de gerar `N` numeros com `rand()`, `random()`,
+ * `aleatorio_proximo()` e `aleatorio_ate()`, este ultimo com o limite
+ * usado para escolher uma casa de um tabuleiro de `TAM` por `TAM`.
+ */
+#include "check.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "aleatorio.h"
+#include "posicao.h"
+
+/**
+ * @brief Numero de numeros gerados, por omissao.
+ */
+#define NUMEROS	100000000UL
+
+/**
+ * @brief Devolve o tempo actual em nanossegundos.
+ * @returns O tempo.
+ */
+uint64_t agora (void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return ((uint64_t) t.tv_sec * 1000000000ULL) + t.tv_nsec;
+}
+
+/**
+ * @brief Mostra o resultado de uma medicao.
+ * @param nome O nome do gerador.
+ * @param t O tempo, em nanossegundos.
+ * @param n O numero de numeros gerados.
+ * @param soma A soma dos numeros, para o compilador nao os deitar fora.
+ */
+void mostra (const char * nome, uint64_t t, size_t n, uint64_t soma)
+{
+	printf("%-18s %6.2f ns/number  %8.1f M numbers/s  (%016lx)\n",
+	       nome,
+	       (double) t / n,
+	       (double) n * 1000.0 / t,
+	       soma);
+	fflush(stdout);
+}
+
+int main (int argc, char ** argv)
+{
+	size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : NUMEROS;
+	uint64_t soma = 0;
+	uint64_t t0 = 0;
+	aleatorio a;
+
+	srand(1);
+	soma = 0;
+	t0 = agora();
+	for (size_t i = 0; i < n; i++)
+		soma += rand();
+	mostra("rand()", agora() - t0, n, soma);
+
+	srandom(1);
+	soma = 0;
+	t0 = agora();
+	for (size_t i = 0; i < n; i++)
+		soma += random();
+	mostra("random()", agora() - t0, n, soma);
+
+	aleatorio_semeia(&a, 1);
+	soma = 0;
+	t0 = agora();
+	for (size_t i = 0; i < n; i++)
+		soma += aleatorio_proximo(&a);
+	mostra("aleatorio_proximo", agora() - t0, n, soma);
+
+	aleatorio_semeia(&a, 1);
+	soma = 0;
+	t0 = agora();
+	for (size_t i = 0; i < n; i++)
+		soma += aleatorio_ate(&a, TAM * TAM);
+	mostra("aleatorio_ate", agora() - t0, n, soma);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+/** @file */
+/**
+ * Compara o armazenamento de um ficheiro por jogador com o ficheiro slab.
+ *
+ * Uso: `bench-armazem [PASTA [N ...]]`
+ *
+ * Para cada numero de jogadores `N` e cada tipo de armazenamento, cria `N`
+ * jogadores e mede o custo de uma jogada (`armazem_ler` + `armazem_escreve`)
+ * de jogadores escolhidos ao acaso.
+ */
+#include "check.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "armazem.h"
+#include "estado.h"
+#include "slab.h"
+
+/**
+ * @brief Numero de jogadas medidas para cada `N`.
+ */
+#define JOGADAS	100000
+
+/**
+ * @brief Numeros de jogadores, por omissao.
+ */
+const char * num_jogadores[] = { "10000", "100000", "1000000" };
+
+/**
+ * @brief Devolve o tempo actual em nanossegundos.
+ * @returns O tempo.
+ */
+uint64_t agora (void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return ((uint64_t) t.tv_sec * 1000000000ULL) + t.tv_nsec;
+}
+
+/**
+ * @brief Gera um numero pseudo-aleatorio (xorshift64).
+ * @param s O estado do gerador.
+ * @returns O numero.
+ */
+uint64_t xorshift (uint64_t * s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+/**
+ * @brief Escreve o nome do jogador `i`.
+ * @param nome Onde escrever o nome.
+ * @param i O numero do jogador.
+ */
+void nome_jogador (char * nome, size_t i)
+{
+	sprintf(nome, "j%09zu", i % 1000000000);
+}
+
+/**
+ * @brief Apaga os dados de um tipo de armazenamento.
+ * @param t O tipo de armazenamento.
+ * @param n O numero de jogadores criados.
+ */
+void limpa (enum armazem_tipo t, size_t n)
+{
+	char nome[11] = "";
+
+	if (t == ARMAZEM_SLAB) {
+		slab_fecha();
+		unlink(armazem_slab_path());
+		return;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		nome_jogador(nome, i);
+		unlink(pathname(nome));
+	}
+}
+
+/**
+ * @brief Mede um tipo de armazenamento com `n` jogadores.
+ * @param t O tipo de armazenamento.
+ * @param nome_tipo O nome do tipo.
+ * @param n O numero de jogadores.
+ */
+void mede (enum armazem_tipo t, const char * nome_tipo, size_t n)
+{
+	estado_s e = init_estado(posicao_new(TAM, TAM), 0, 0, MOV_TYPE_QUANTOS, "j", 1);
+	uint64_t s = 0x9e3779b97f4a7c15ULL;
+
+	armazem_usa(t);
+	limpa(t, n);
+	if (t == ARMAZEM_SLAB)
+		slab_abre(armazem_slab_path());
+
+	uint64_t t0 = agora();
+	for (size_t i = 0; i < n; i++) {
+		nome_jogador(e.nome, i);
+		armazem_escreve(&e);
+	}
+	uint64_t t1 = agora();
+
+	for (size_t i = 0; i < JOGADAS; i++) {
+		char nome[11] = "";
+		nome_jogador(nome, xorshift(&s) % n);
+		estado_liberta(&e);
+		check(!armazem_ler(nome, &e), "could not read state");
+		e.score++;
+		armazem_escreve(&e);
+	}
+	uint64_t t2 = agora();
+
+	estado_liberta(&e);
+
+	printf("%-9s %8zu players  create %8.0f ns/player  move %8.0f ns/op\n",
+	       nome_tipo,
+	       n,
+	       (double) (t1 - t0) / n,
+	       (double) (t2 - t1) / JOGADAS);
+	fflush(stdout);
+
+	limpa(t, n);
+}
+
+/**
+ * @brief O entry point do benchmark.
+ * @param argc Numero de argumentos.
+ * @param argv Argumentos.
+ * @returns Codigo de sucesso.
+ */
+int main (int argc, char ** argv)
+{
+	const char * pasta = (argc > 1) ? argv[1] : "/tmp/rogue-bench/";
+	const char ** ns = (argc > 2) ? (const char **) argv + 2 : num_jogadores;
+	int num_ns = (argc > 2) ? argc - 2 : 3;
+
+	mkdir(pasta, 0777);
+	setenv("ROGUE_BASE_PATH", pasta, 1);
+
+	for (int i = 0; i < num_ns; i++) {
+		size_t n = strtoul(ns[i], NULL, 10);
+		mede(ARMAZEM_FICHEIROS, "ficheiros", n);
+		mede(ARMAZEM_SLAB, "slab", n);
+	}
+
+	return EXIT_SUCCESS;
+}
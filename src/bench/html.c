@@ -0,0 +1,102 @@
+/** @file */
+/**
+ * Mede quanto custa gerar a pagina do jogo.
+ *
+ * Uso: `bench-html [N]`
+ *
+ * Gera `N` vezes a pagina de um jogo em `TAM` por `TAM` para o buffer de
+ * saida, depois comprimida com gzip, e depois a resposta CGI inteira, com
+ * os cabecalhos, enviada com um so `write()` para `/dev/null`. Por fim
+ * gera-a outra vez com a camada fixa do nivel guardada em memoria, como
+ * num processo residente.
+ */
+#include "check.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "estado.h"
+#include "html.h"
+#include "saida.h"
+
+/**
+ * @brief Numero de paginas geradas, por omissao.
+ */
+#define PAGINAS	100000UL
+
+/**
+ * @brief Devolve o tempo actual em nanossegundos.
+ * @returns O tempo.
+ */
+uint64_t agora (void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return ((uint64_t) t.tv_sec * 1000000000ULL) + t.tv_nsec;
+}
+
+/**
+ * @brief O entry point do benchmark.
+ * @param argc Numero de argumentos.
+ * @param argv Argumentos.
+ * @returns Codigo de sucesso.
+ */
+int main (int argc, char ** argv)
+{
+	size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : PAGINAS;
+	estado_s e = init_estado(posicao_new(TAM, TAM), 0, 0, MOV_TYPE_QUANTOS, "bench", 1);
+	char * buf = NULL;
+	size_t tam = 0;
+
+	int fd = open("/dev/null", O_WRONLY);
+	check(fd < 0, "could not open /dev/null");
+
+	uint64_t t0 = agora();
+	for (size_t i = 0; i < n; i++) {
+		saida_inicio(CONTENT_TYPE);
+		imprime_jogo(&e);
+		tam = saida_fim(SAIDA_IDENTIDADE, &buf);
+	}
+	uint64_t t1 = agora();
+
+	/* o mesmo, comprimido como para um cliente com `Accept-Encoding: gzip` */
+	size_t tam_gzip = 0;
+	for (size_t i = 0; i < n; i++) {
+		saida_inicio(CONTENT_TYPE);
+		imprime_jogo(&e);
+		tam_gzip = saida_fim(SAIDA_GZIP, &buf);
+	}
+	uint64_t t2 = agora();
+
+	for (size_t i = 0; i < n; i++) {
+		saida_inicio(CONTENT_TYPE);
+		imprime_jogo(&e);
+		size_t len = saida_fim_cgi(SAIDA_IDENTIDADE, &buf);
+		check(write(fd, buf, len) != (ssize_t) len, "could not write page");
+	}
+	uint64_t t3 = agora();
+
+	/* a camada fixa e escrita na primeira pagina e copiada nas seguintes */
+	html_camadas_activa();
+	size_t tam_camada = 0;
+	for (size_t i = 0; i < n; i++) {
+		saida_inicio(CONTENT_TYPE);
+		imprime_jogo(&e);
+		tam_camada = saida_fim(SAIDA_IDENTIDADE, &buf);
+	}
+	uint64_t t4 = agora();
+
+	printf("render   %8.0f ns/page  (%zu bytes)\n", (double) (t1 - t0) / n, tam);
+	printf("gzip     %8.0f ns/page  (%zu bytes)\n", (double) (t2 - t1) / n, tam_gzip);
+	printf("cgi      %8.0f ns/page  (render + headers + write)\n", (double) (t3 - t2) / n);
+	printf("camada   %8.0f ns/page  (%zu bytes, board layer from memory)\n", (double) (t4 - t3) / n, tam_camada);
+
+	close(fd);
+	estado_liberta(&e);
+
+	return EXIT_SUCCESS;
+}
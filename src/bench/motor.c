@@ -0,0 +1,392 @@
+/** @file */
+/**
+ * Mede os caminhos mais usados do motor do jogo, em ns por operacao.
+ *
+ * Uso: `bench-motor [FILTRO [LOTES]]`
+ *
+ * Cada caso e corrido em lotes de operacoes, com o tamanho calibrado para
+ * cada lote demorar pelo menos `BENCH_LOTE_NS`. Os primeiros
+ * `BENCH_AQUECIMENTO` lotes nao contam; dos `LOTES` seguintes mostra-se a
+ * mediana, o minimo, o maximo e o desvio absoluto mediano, em percentagem
+ * da mediana. Com `FILTRO` so corre os casos cujo nome o contem.
+ *
+ * A saida tem uma linha por caso, com os campos separados por tabs e
+ * sempre pela mesma ordem, precedida de uma linha de cabecalho comecada
+ * por `#`. Os estados sao gerados sempre com as mesmas sementes e os
+ * ficheiros sao escritos numa pasta nova em `/dev/shm`, com o tipo de
+ * armazenamento de `ROGUE_ARMAZEM`.
+ */
+#include "check.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "armazem.h"
+#include "estado.h"
+#include "html.h"
+#include "jogo.h"
+#include "partida.h"
+#include "saida.h"
+#include "slab.h"
+
+/**
+ * @brief O tempo minimo de cada lote, em nanossegundos.
+ */
+#define BENCH_LOTE_NS	20000000ULL
+
+/**
+ * @brief O numero de lotes corridos antes de comecar a medir.
+ */
+#define BENCH_AQUECIMENTO	3
+
+/**
+ * @brief O numero de lotes medidos, por omissao.
+ */
+#define BENCH_LOTES	15
+
+/**
+ * @brief O numero maximo de lotes medidos.
+ */
+#define BENCH_LOTES_MAX	1000
+
+/**
+ * @brief O lado do tabuleiro grande.
+ */
+#define BENCH_TAM_GRANDE	40
+
+/**
+ * @brief Um caso: corre `n` vezes uma operacao.
+ */
+typedef struct {
+	/** O nome do caso, sem espacos. */
+	const char * nome;
+	/** Corre a operacao `n` vezes, com o argumento `arg`. */
+	void (* corre) (size_t n, size_t arg);
+	/** O argumento de `corre`. */
+	size_t arg;
+} bench_caso;
+
+/**
+ * @brief Os estados usados pelos casos: `TAM` por `TAM` e `BENCH_TAM_GRANDE`
+ * por `BENCH_TAM_GRANDE`.
+ */
+static estado_s bench_estados[2];
+
+/**
+ * @brief O descritor de `/dev/null`.
+ */
+static int bench_null = -1;
+
+/**
+ * @brief Onde os resultados sao acumulados, para o compilador nao deitar
+ * fora as operacoes.
+ */
+static volatile uint64_t bench_soma = 0;
+
+/**
+ * @brief Devolve o tempo actual em nanossegundos.
+ * @returns O tempo.
+ */
+uint64_t agora (void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return ((uint64_t) t.tv_sec * 1000000000ULL) + t.tv_nsec;
+}
+
+/**
+ * @brief Mede `posicoes_possiveis()` para o jogador, em todo o tabuleiro.
+ * @param n O numero de operacoes.
+ * @param mt O tipo de movimento.
+ */
+void corre_posicoes (size_t n, size_t mt)
+{
+	estado_s e = bench_estados[0];
+	e.mov_type = mt;
+	janela j = janela_tabuleiro(&e);
+
+	posicao_p dst = malloc(NJOGADAS(e.tam) * sizeof(posicao_s));
+	check(dst == NULL, "could not allocate moves");
+
+	for (size_t i = 0; i < n; i++)
+		bench_soma += posicoes_possiveis(&e, e.jog.pos, &j, false, dst);
+
+	free(dst);
+}
+
+/**
+ * @brief Mede `jogadas_possiveis()`, com os links.
+ * @param n O numero de operacoes.
+ * @param t O indice do estado em `bench_estados`.
+ */
+void corre_jogadas (size_t n, size_t t)
+{
+	jogada_p dst = aloca_jogadas(bench_estados + t);
+
+	for (size_t i = 0; i < n; i++)
+		bench_soma += jogadas_possiveis(bench_estados + t, dst);
+
+	free(dst);
+}
+
+/**
+ * @brief Mede `estado_copia()` e `estado_liberta()`, que `bot_joga` tambem paga.
+ * @param n O numero de operacoes.
+ * @param t O indice do estado em `bench_estados`.
+ */
+void corre_copia (size_t n, size_t t)
+{
+	for (size_t i = 0; i < n; i++) {
+		estado_s e = estado_copia(bench_estados + t);
+		bench_soma += e.num_inimigos;
+		estado_liberta(&e);
+	}
+}
+
+/**
+ * @brief Mede a ronda dos bots, sempre a partir do mesmo estado, copiado
+ * em cada operacao.
+ * @param n O numero de operacoes.
+ * @param t O indice do estado em `bench_estados`.
+ */
+void corre_bot_joga (size_t n, size_t t)
+{
+	for (size_t i = 0; i < n; i++) {
+		estado_s e = bot_joga(estado_copia(bench_estados + t));
+		bench_soma += e.jog.vida;
+		estado_liberta(&e);
+	}
+}
+
+/**
+ * @brief Mede a criacao de um nivel, com uma semente diferente em cada operacao.
+ * @param n O numero de operacoes.
+ * @param tam O lado do tabuleiro.
+ */
+void corre_init_estado (size_t n, size_t tam)
+{
+	for (size_t i = 0; i < n; i++) {
+		estado_s e = init_estado(posicao_new(tam, tam), 0, 0, MOV_TYPE_QUANTOS, "bench", i);
+		bench_soma += e.num_obstaculos;
+		estado_liberta(&e);
+	}
+}
+
+/**
+ * @brief Mede `accao_link()`.
+ * @param n O numero de operacoes.
+ * @param arg Nao e usado.
+ */
+void corre_accao_link (size_t n, size_t arg)
+{
+	UNUSED(arg);
+	char link[JOGADA_LINK_MAX_BUFFER];
+	accao_s a = accao_new("bench", ACCAO_MOVE, posicao_new(3, 4), posicao_new(4, 5));
+
+	for (size_t i = 0; i < n; i++) {
+		a.dest.x = i & 0xff;
+		bench_soma += accao_link(a, link)[0];
+	}
+}
+
+/**
+ * @brief Mede `str2accao()`.
+ * @param n O numero de operacoes.
+ * @param arg Nao e usado.
+ */
+void corre_str2accao (size_t n, size_t arg)
+{
+	UNUSED(arg);
+	char link[JOGADA_LINK_MAX_BUFFER];
+	accao_link(accao_new("bench", ACCAO_MOVE, posicao_new(3, 4), posicao_new(4, 5)), link);
+
+	for (size_t i = 0; i < n; i++)
+		bench_soma += str2accao(link).dest.x;
+}
+
+/**
+ * @brief Mede `escreve_estado()`, sempre do mesmo estado.
+ * @param n O numero de operacoes.
+ * @param t O indice do estado em `bench_estados`.
+ */
+void corre_escreve (size_t n, size_t t)
+{
+	for (size_t i = 0; i < n; i++)
+		escreve_estado(bench_estados + t);
+	bench_soma += n;
+}
+
+/**
+ * @brief Mede a leitura do estado guardado no inicio do benchmark, a parte
+ * de `ler_estado()` que nao executa a accao.
+ * @param n O numero de operacoes.
+ * @param t O indice do estado em `bench_estados`.
+ */
+void corre_ler (size_t n, size_t t)
+{
+	for (size_t i = 0; i < n; i++) {
+		estado_s e;
+		check(!estado_actual(bench_estados[t].nome, &e), "could not read state");
+		bench_soma += e.num_inimigos;
+		estado_liberta(&e);
+	}
+}
+
+/**
+ * @brief Mede a pagina de um estado, com os cabecalhos CGI, escrita em `/dev/null`.
+ * @param n O numero de operacoes.
+ * @param t O indice do estado em `bench_estados`.
+ */
+void corre_imprime_jogo (size_t n, size_t t)
+{
+	char * buf = NULL;
+
+	for (size_t i = 0; i < n; i++) {
+		saida_inicio(CONTENT_TYPE);
+		imprime_jogo(bench_estados + t);
+		size_t len = saida_fim_cgi(SAIDA_IDENTIDADE, &buf);
+		check(write(bench_null, buf, len) != (ssize_t) len, "could not write page");
+	}
+	bench_soma += n;
+}
+
+/**
+ * @brief Os casos, pela ordem em que sao corridos e mostrados.
+ */
+static const bench_caso bench_casos[] = {
+	{ "posicoes_possiveis/rei",    corre_posicoes,     MOV_TYPE_XADREZ_REI },
+	{ "posicoes_possiveis/cavalo", corre_posicoes,     MOV_TYPE_XADREZ_CAVALO },
+	{ "posicoes_possiveis/peao",   corre_posicoes,     MOV_TYPE_XADREZ_PEAO },
+	{ "posicoes_possiveis/torre",  corre_posicoes,     MOV_TYPE_XADREZ_TORRE },
+	{ "posicoes_possiveis/bispo",  corre_posicoes,     MOV_TYPE_XADREZ_BISPO },
+	{ "posicoes_possiveis/rainha", corre_posicoes,     MOV_TYPE_XADREZ_RAINHA },
+	{ "posicoes_possiveis/damas",  corre_posicoes,     MOV_TYPE_DAMAS },
+	{ "jogadas_possiveis/10",      corre_jogadas,      0 },
+	{ "jogadas_possiveis/40",      corre_jogadas,      1 },
+	{ "estado_copia/10",           corre_copia,        0 },
+	{ "estado_copia/40",           corre_copia,        1 },
+	{ "bot_joga/10",               corre_bot_joga,     0 },
+	{ "bot_joga/40",               corre_bot_joga,     1 },
+	{ "init_estado/10",            corre_init_estado,  TAM },
+	{ "init_estado/40",            corre_init_estado,  BENCH_TAM_GRANDE },
+	{ "accao_link",                corre_accao_link,   0 },
+	{ "str2accao",                 corre_str2accao,    0 },
+	{ "escreve_estado/10",         corre_escreve,      0 },
+	{ "ler_estado/10",             corre_ler,          0 },
+	{ "escreve_estado/40",         corre_escreve,      1 },
+	{ "ler_estado/40",             corre_ler,          1 },
+	{ "imprime_jogo/10",           corre_imprime_jogo, 0 },
+	{ "imprime_jogo/40",           corre_imprime_jogo, 1 },
+};
+
+/**
+ * @brief Numero de casos.
+ */
+#define BENCH_NUM_CASOS	(sizeof(bench_casos) / sizeof(*bench_casos))
+
+/**
+ * @brief Compara dois numeros, para o `qsort()`.
+ * @param a Um numero.
+ * @param b O outro numero.
+ * @returns Negativo, 0 ou positivo, se `a` for menor, igual ou maior que `b`.
+ */
+int compara (const void * a, const void * b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Corre um caso e mostra o resultado.
+ * @param c O caso.
+ * @param lotes O numero de lotes medidos.
+ */
+void mede (const bench_caso * c, size_t lotes)
+{
+	static double ns[BENCH_LOTES_MAX];
+	static double desvio[BENCH_LOTES_MAX];
+	size_t n = 1;
+
+	/* a calibracao tambem aquece: dobra o lote ate demorar o suficiente */
+	for (;;) {
+		uint64_t t0 = agora();
+		c->corre(n, c->arg);
+		if (agora() - t0 >= BENCH_LOTE_NS)
+			break;
+		n <<= 1;
+	}
+
+	for (size_t i = 0; i < BENCH_AQUECIMENTO; i++)
+		c->corre(n, c->arg);
+
+	for (size_t i = 0; i < lotes; i++) {
+		uint64_t t0 = agora();
+		c->corre(n, c->arg);
+		ns[i] = (double) (agora() - t0) / n;
+	}
+
+	qsort(ns, lotes, sizeof(*ns), compara);
+	double mediana = ns[lotes >> 1];
+
+	for (size_t i = 0; i < lotes; i++)
+		desvio[i] = (ns[i] > mediana) ? ns[i] - mediana : mediana - ns[i];
+	qsort(desvio, lotes, sizeof(*desvio), compara);
+
+	printf("%s\t%.1f\t%.1f\t%.1f\t%.2f\t%zu\t%zu\n",
+	       c->nome, mediana, ns[0], ns[lotes - 1],
+	       100.0 * desvio[lotes >> 1] / mediana, n, lotes);
+	fflush(stdout);
+}
+
+/**
+ * @brief O entry point do benchmark.
+ * @param argc Numero de argumentos.
+ * @param argv Argumentos.
+ * @returns Codigo de sucesso.
+ */
+int main (int argc, char ** argv)
+{
+	const char * filtro = (argc > 1) ? argv[1] : "";
+	size_t lotes = (argc > 2) ? strtoul(argv[2], NULL, 10) : BENCH_LOTES;
+	if (lotes < 1 || lotes > BENCH_LOTES_MAX)
+		lotes = BENCH_LOTES;
+
+	/* os ficheiros vao para memoria, para nao medir o disco */
+	char pasta[] = "/dev/shm/rogue-bench-XXXXXX";
+	check(mkdtemp(pasta) == NULL, "could not create the bench directory");
+	char base[sizeof(pasta) + 1];
+	snprintf(base, sizeof(base), "%s/", pasta);
+	setenv("ROGUE_BASE_PATH", base, 1);
+
+	bench_null = open("/dev/null", O_WRONLY);
+	check(bench_null < 0, "could not open /dev/null");
+
+	bench_estados[0] = init_estado(posicao_new(TAM, TAM), 0, 0, MOV_TYPE_QUANTOS, "bench10", 1);
+	bench_estados[1] = init_estado(posicao_new(BENCH_TAM_GRANDE, BENCH_TAM_GRANDE), 0, 0, MOV_TYPE_QUANTOS, "bench40", 1);
+
+	/* os casos `ler_estado` nao dependem de algum `escreve_estado` ter corrido */
+	for (size_t i = 0; i < 2; i++)
+		escreve_estado(bench_estados + i);
+
+	printf("# caso\tns/op\tmin\tmax\tmad%%\tops/lote\tlotes\n");
+	for (size_t i = 0; i < BENCH_NUM_CASOS; i++)
+		if (strstr(bench_casos[i].nome, filtro) != NULL)
+			mede(bench_casos + i, lotes);
+
+	for (size_t i = 0; i < 2; i++) {
+		unlink(pathname(bench_estados[i].nome));
+		estado_liberta(bench_estados + i);
+	}
+	slab_fecha();
+	unlink(armazem_slab_path());
+	rmdir(pasta);
+	close(bench_null);
+
+	return EXIT_SUCCESS;
+}
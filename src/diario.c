@@ -0,0 +1,256 @@
+/** @file */
+#include "check.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "armazem.h"
+#include "estado.h"
+#include "jogo.h"
+
+#include "diario.h"
+
+/**
+ * @brief Uma accao que ainda nao foi escrita no diario.
+ */
+typedef struct {
+	/** O nome do jogador. */
+	char nome[11];
+	/** A ordem por que a accao chegou, para a manter no diario. */
+	size_t ordem;
+	/** O registo. */
+	diario_accao r;
+} diario_pendente;
+
+/**
+ * @brief As accoes a espera de ser escritas, quando os diarios sao adiados.
+ */
+typedef struct {
+	/** Se os diarios sao adiados. */
+	bool adiado;
+	/** As accoes. */
+	diario_pendente * v;
+	/** O numero de accoes. */
+	size_t num;
+	/** O espaco reservado em `v`. */
+	size_t capacidade;
+	/** Protege as accoes. */
+	pthread_mutex_t lock;
+} diario_buffer;
+
+/**
+ * @brief As accoes por escrever, vazio ate `diario_adia()`.
+ */
+diario_buffer diario = {
+	.adiado = false,
+	.v = NULL,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+char * diario_path (const char * nome)
+{
+	static _Thread_local char ret[PATH_MAX] = "";
+	snprintf(ret, sizeof(ret), "%s.%s.diario", armazem_pasta(), nome);
+	return ret;
+}
+
+/**
+ * @brief Escreve num diario e, se pedido, espera que esteja no disco.
+ * @param fd O descritor do diario.
+ * @param buf O que escrever.
+ * @param n O numero de bytes.
+ */
+void diario_escreve (int fd, const void * buf, size_t n)
+{
+	check(write(fd, buf, n) != (ssize_t) n, "could not write to journal");
+
+	if (armazem_durabilidade() == DURABILIDADE_FSYNC)
+		check(fdatasync(fd) < 0, "could not sync journal");
+}
+
+void diario_inicia (const char * nome, posicao_s tam, uchar nivel, unsigned score, enum mov_type mt, uint64_t semente)
+{
+	assert(nome != NULL);
+
+	/* nenhuma accao adiada pode ir parar ao diario novo */
+	diario_flush();
+
+	diario_cabecalho cab = { .versao = DIARIO_VERSAO };
+	memcpy(cab.magic, DIARIO_MAGIC, sizeof(cab.magic));
+
+	diario_inicio inicio = {
+		.tipo = DIARIO_INICIO,
+		.nivel = nivel,
+		.mov_type = mt,
+		.tam = tam,
+		.score = score,
+		.semente = semente,
+	};
+
+	/* o cabecalho e o primeiro registo vao numa so escrita */
+	uchar buf[sizeof(cab) + sizeof(inicio)];
+	memcpy(buf, &cab, sizeof(cab));
+	memcpy(buf + sizeof(cab), &inicio, sizeof(inicio));
+
+	int fd = open(diario_path(nome), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	check(fd < 0, "could not open journal");
+	diario_escreve(fd, &buf, sizeof(buf));
+	close(fd);
+}
+
+/**
+ * @brief Acrescenta registos ao diario de um jogador, se ele tiver um.
+ * @param nome Nome do jogador.
+ * @param r Os registos.
+ * @param n O numero de registos.
+ */
+void diario_acrescenta_registos (const char * nome, const diario_accao * r, size_t n)
+{
+	/* os jogadores que comecaram antes de haver diarios nao tem um */
+	int fd = open(diario_path(nome), O_WRONLY | O_APPEND | O_CLOEXEC);
+	ifjmp(fd < 0 && errno == ENOENT, out);
+	check(fd < 0, "could not open journal");
+
+	/* com `O_APPEND` os registos sao sempre escritos inteiros no fim */
+	diario_escreve(fd, r, n * sizeof(diario_accao));
+	close(fd);
+
+out:
+	return;
+}
+
+void diario_acrescenta (const accao_s * accao)
+{
+	assert(accao != NULL);
+
+	diario_accao r = {
+		.tipo = DIARIO_ACCAO,
+		.accao = (accao->accao < ACCAO_INVALID) ?
+			accao->accao :
+			ACCAO_INVALID,
+		.jog = accao->jog,
+		.dest = accao->dest,
+	};
+
+	/* com `DURABILIDADE_FSYNC` a accao tem de estar no disco antes da resposta */
+	ifjmp(!diario.adiado || armazem_durabilidade() == DURABILIDADE_FSYNC, escreve);
+
+	pthread_mutex_lock(&diario.lock);
+	if (diario.num == diario.capacidade) {
+		diario.capacidade = (diario.capacidade > 0) ? diario.capacidade << 1 : 64;
+		diario.v = realloc(diario.v, diario.capacidade * sizeof(diario_pendente));
+		check(diario.v == NULL, "could not allocate journal buffer");
+	}
+	diario_pendente * p = diario.v + diario.num;
+	strcpy(p->nome, accao->nome);
+	p->ordem = diario.num++;
+	p->r = r;
+	pthread_mutex_unlock(&diario.lock);
+
+	return;
+escreve:
+	diario_acrescenta_registos(accao->nome, &r, 1);
+}
+
+void diario_adia (void)
+{
+	diario.adiado = true;
+}
+
+/**
+ * @brief Compara duas accoes adiadas por jogador e depois pela ordem, para o `qsort()`
+ * @param a Uma accao
+ * @param b Uma accao
+ * @returns Um numero negativo, 0 ou positivo
+ */
+int compara_pendentes (const void * a, const void * b)
+{
+	const diario_pendente * pa = a;
+	const diario_pendente * pb = b;
+	int r = strcmp(pa->nome, pb->nome);
+	return (r != 0) ? r :
+		(pa->ordem > pb->ordem) - (pa->ordem < pb->ordem);
+}
+
+void diario_flush (void)
+{
+	ifjmp(!diario.adiado, out);
+
+	pthread_mutex_lock(&diario.lock);
+
+	/* as accoes de cada jogador ficam seguidas, pela ordem em que chegaram */
+	qsort(diario.v, diario.num, sizeof(diario_pendente), compara_pendentes);
+
+	diario_accao * rs = malloc((diario.num + 1) * sizeof(diario_accao));
+	check(rs == NULL, "could not allocate journal buffer");
+
+	/* um so `write()` por jogador */
+	for (size_t i = 0, j = 0; i < diario.num; i = j) {
+		for (j = i; j < diario.num && strcmp(diario.v[j].nome, diario.v[i].nome) == 0; j++)
+			rs[j - i] = diario.v[j].r;
+		diario_acrescenta_registos(diario.v[i].nome, rs, j - i);
+	}
+
+	free(rs);
+	diario.num = 0;
+
+	pthread_mutex_unlock(&diario.lock);
+
+out:
+	return;
+}
+
+FILE * diario_abre (const char * nome)
+{
+	assert(nome != NULL);
+
+	diario_cabecalho cab;
+	FILE * f = fopen(diario_path(nome), "rb");
+	ifjmp(f == NULL, err);
+
+	ifjmp(fread(&cab, sizeof(cab), 1, f) != 1, err);
+	ifjmp(memcmp(cab.magic, DIARIO_MAGIC, sizeof(cab.magic)) != 0, err);
+	ifjmp(cab.versao != DIARIO_VERSAO, err);
+
+	return f;
+err:
+	ifnnull(f, fclose);
+	return NULL;
+}
+
+enum diario_tipo diario_le (FILE * f, diario_inicio * inicio, diario_accao * accao)
+{
+	assert(f != NULL);
+	assert(inicio != NULL);
+	assert(accao != NULL);
+
+	int tipo = fgetc(f);
+
+	/* o tipo ja foi lido, falta o resto do registo */
+	switch (tipo) {
+	case DIARIO_INICIO:
+		inicio->tipo = tipo;
+		ifjmp(fread(&inicio->tipo + 1, sizeof(*inicio) - 1, 1, f) != 1, err);
+		ifjmp(inicio->mov_type > MOV_TYPE_QUANTOS, err);
+		ifjmp(inicio->tam.x < TAM_MIN || inicio->tam.x > TAM_MAX, err);
+		ifjmp(inicio->tam.y < TAM_MIN || inicio->tam.y > TAM_MAX, err);
+		break;
+	case DIARIO_ACCAO:
+		accao->tipo = tipo;
+		ifjmp(fread(&accao->tipo + 1, sizeof(*accao) - 1, 1, f) != 1, err);
+		break;
+	default:
+		goto err;
+	}
+
+	return tipo;
+err:
+	return DIARIO_QUANTOS;
+}
@@ -1,6 +1,10 @@
 /** @file */
 #include "check.h"
 
+#include <stdlib.h>
+
+#include "bitboard.h"
+#include "grelha.h"
 #include "posicao.h"
 
 #include "entidades.h"
@@ -18,18 +22,79 @@ bool pos_inimigos (const entidades e, posicao_s p, size_t num_inimigos)
 	return pos_inimigos_ind(e, p, num_inimigos) < num_inimigos;
 }
 
+size_t entidade_procura (const entidades e, const grelha * g, posicao_s p, size_t N)
+{
+	assert(e != NULL);
+	assert(g != NULL);
+
+	size_t i = g->cabeca[GRELHA_CELULA(*g, p)];
+	for (; i != 0 && !posicao_igual(e[i - 1].pos, p); i = g->prox[i - 1]);
+
+	return (i != 0) ?
+		i - 1 :
+		N;
+}
+
+/**
+ * @brief Compara dois indices, para o `qsort()`
+ * @param a Um indice
+ * @param b Um indice
+ * @returns Negativo, 0 ou positivo se `a` for menor, igual ou maior que `b`
+ */
+int compara_indices (const void * a, const void * b)
+{
+	size_t x = *(const size_t *) a;
+	size_t y = *(const size_t *) b;
+	return (x > y) - (x < y);
+}
+
+size_t entidades_recolhe (const entidades e, const grelha * g, posicao_s min, posicao_s max, size_t * dst)
+{
+	assert(e != NULL);
+	assert(g != NULL);
+	assert(dst != NULL);
+
+	size_t ret = 0;
+	ifjmp(min.x >= max.x || min.y >= max.y, out);
+
+	/* so se visitam as celulas que tocam no rectangulo */
+	for (size_t cy = min.y / GRELHA_LADO; cy <= (size_t) (max.y - 1) / GRELHA_LADO; cy++) {
+		for (size_t cx = min.x / GRELHA_LADO; cx <= (size_t) (max.x - 1) / GRELHA_LADO; cx++) {
+			for (size_t i = g->cabeca[(cy * g->largura) + cx]; i != 0; i = g->prox[i - 1]) {
+				posicao_s p = e[i - 1].pos;
+				if (p.x >= min.x && p.x < max.x && p.y >= min.y && p.y < max.y)
+					dst[ret++] = i - 1;
+			}
+		}
+	}
+
+	qsort(dst, ret, sizeof(size_t), compara_indices);
+
+out:
+	return ret;
+}
+
 bool entidade_dead (const entidades e)
 {
 	assert(e != NULL);
 	return e->vida == 0;
 }
 
-uchar entidade_remove (entidades e, size_t i, size_t N)
+size_t entidade_remove (entidades e, size_t i, size_t N, bitboard * bb, grelha * g)
 {
 	assert(e != NULL);
 	assert(i < N);
+	assert(bb != NULL);
+	assert(g != NULL);
+
+	BB_DESLIGA(*bb, e[i].pos);
+	grelha_tira(g, e[i].pos, i);
 
 	N--;
+	if (i < N) {
+		grelha_tira(g, e[N].pos, N);
+		grelha_poe(g, e[N].pos, i);
+	}
 	e[i] = e[N];
 
 	return N;
@@ -1,6 +1,7 @@
 /** @file */
 #include "check.h"
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -17,27 +18,110 @@
 bool posicao_ocupada (const estado_p e, posicao_s p)
 {
 	assert(e != NULL);
-	return (pos_inimigos(e->inimigo, p,  e->num_inimigos)
-		|| pos_inimigos(e->obstaculo, p,  e->num_obstaculos)
-		|| posicao_igual(e->jog.pos, p));
+	/* os tres bitboards tem a mesma largura */
+	return (BB_PALAVRA(e->bb_inimigos, p)
+		| BB_PALAVRA(e->bb_obstaculos, p)
+		| BB_PALAVRA(e->bb_jogador, p))
+		& BB_BIT(e->bb_jogador, p);
 }
 
 /**
- * @brief Cria uma posicao aleatoria nao ocupada
- * @param e O estado do jogo
- * @returns A nova posicao unica
+ * @brief As casas livres de um tabuleiro, por ordem aleatoria
+ *
+ * Um Fisher-Yates parcial sobre os indices das casas: cada casa tirada e
+ * trocada com a primeira das que ainda nao foram tiradas. O array baralhado
+ * nao existe: so se guardam as posicoes que foram trocadas, numa tabela de
+ * hash, logo a memoria e proporcional ao numero de casas tiradas e nao ao
+ * tamanho do tabuleiro.
  */
-posicao_s nova_posicao_unica (const estado_p e)
+typedef struct {
+	/** Por entrada da tabela, a posicao trocada mais 1, ou 0 se estiver livre */
+	uint32_t * chave;
+	/** Por entrada da tabela, a casa que esta na posicao trocada */
+	uint32_t * valor;
+	/** O numero de entradas da tabela menos 1 (potencia de 2 menos 1) */
+	size_t mask;
+	/** O numero de casas ja tiradas */
+	size_t tiradas;
+	/** O gerador de numeros aleatorios */
+	aleatorio * gerador;
+	/** As dimensoes do tabuleiro */
+	posicao_s tam;
+} casas_livres;
+
+/**
+ * @brief Prepara as casas livres de um tabuleiro vazio
+ * @param l As casas livres
+ * @param tam As dimensoes do tabuleiro
+ * @param N O numero maximo de casas que vao ser tiradas
+ * @param gerador O gerador de numeros aleatorios
+ */
+void casas_livres_init (casas_livres * l, posicao_s tam, size_t N, aleatorio * gerador)
 {
-	assert(e != NULL);
-	posicao_s ret = { (~0), (~0) };
+	size_t n = 1;
+	for (; n < (N << 1); n <<= 1);
 
-	do {
-		ret.x = rand() % TAM;
-		ret.y = rand() % TAM;
-	} while (posicao_ocupada(e, ret));
+	l->chave = calloc(n, sizeof(uint32_t));
+	l->valor = malloc(n * sizeof(uint32_t));
+	check(l->chave == NULL || l->valor == NULL, "could not allocate state");
 
-	return ret;
+	l->mask = n - 1;
+	l->tiradas = 0;
+	l->tam = tam;
+	l->gerador = gerador;
+}
+
+/**
+ * @brief Liberta as casas livres
+ * @param l As casas livres
+ */
+void casas_livres_liberta (casas_livres * l)
+{
+	free(l->chave);
+	free(l->valor);
+}
+
+/**
+ * @brief Procura uma posicao do array baralhado na tabela
+ * @param l As casas livres
+ * @param i A posicao
+ * @returns A entrada da tabela da posicao, ou a entrada livre onde deve ficar
+ */
+size_t casas_livres_entrada (const casas_livres * l, size_t i)
+{
+	/* multiplicacao de Fibonacci, para espalhar posicoes seguidas */
+	size_t h = (size_t) ((i * 0x9e3779b97f4a7c15ULL) >> 32) & l->mask;
+	while (l->chave[h] != 0 && l->chave[h] != i + 1)
+		h = (h + 1) & l->mask;
+	return h;
+}
+
+/**
+ * @brief Tira uma casa livre ao acaso
+ * @param l As casas livres
+ * @returns A casa
+ */
+posicao_s nova_posicao_unica (casas_livres * l)
+{
+	assert(l != NULL);
+
+	size_t casas = (size_t) l->tam.x * l->tam.y;
+	assert(l->tiradas < casas);
+
+	/* troca a posicao `i` (a primeira por tirar) com uma posicao `j` ao acaso */
+	size_t i = l->tiradas++;
+	size_t j = i + aleatorio_ate(l->gerador, casas - i);
+
+	size_t hi = casas_livres_entrada(l, i);
+	size_t vi = (l->chave[hi] != 0) ? l->valor[hi] : i;
+	size_t hj = casas_livres_entrada(l, j);
+	size_t vj = (l->chave[hj] != 0) ? l->valor[hj] : j;
+
+	/* a posicao `i` nunca mais e lida, so a `j` precisa de ser guardada */
+	l->chave[hj] = j + 1;
+	l->valor[hj] = vi;
+
+	return posicao_new(vj % l->tam.x, vj / l->tam.x);
 }
 
 bool fim_de_jogo (const estado_p e)
@@ -52,6 +136,78 @@ bool fim_de_ronda (const estado_p e)
 	return e->num_inimigos == 0;
 }
 
+/**
+ * @brief Reserva os bitboards e as linhas de um estado, vazios
+ * @param e O estado do jogo
+ */
+void init_ocupacao (estado_p e)
+{
+	assert(e != NULL);
+
+	size_t n = BB_PALAVRAS(e->tam);
+	/* os tres bitboards ficam num unico bloco, libertado pelo do jogador */
+	uint64_t * w = calloc(3 * n, sizeof(uint64_t));
+	check(w == NULL, "could not allocate state");
+
+	e->bb_jogador = (bitboard) { .w = w, .largura = e->tam.x };
+	e->bb_inimigos = (bitboard) { .w = w + n, .largura = e->tam.x };
+	e->bb_obstaculos = (bitboard) { .w = w + (2 * n), .largura = e->tam.x };
+
+	/* o tabuleiro de `TAM` por `TAM` usa as tabelas */
+	e->linhas_inimigos = e->linhas_obstaculos = (linhas) { .tam = e->tam };
+	if (!BB_TEM_TABELAS(e->tam)) {
+		linhas_init(&e->linhas_inimigos, e->tam);
+		linhas_init(&e->linhas_obstaculos, e->tam);
+	}
+}
+
+/**
+ * @brief Marca as casas ocupadas por entidades num bitboard, nas linhas e numa grelha nova
+ * @param e O estado do jogo
+ * @param p As entidades
+ * @param N O numero de entidades
+ * @param bb O bitboard
+ * @param ls As linhas
+ * @param g A grelha
+ */
+void marca_entidades (const estado_p e, const entidades p, size_t N, bitboard * bb, linhas * ls, grelha * g)
+{
+	grelha_init(g, e->tam, N);
+	for (size_t i = 0; i < N; i++) {
+		BB_LIGA(*bb, p[i].pos);
+		grelha_poe(g, p[i].pos, i);
+	}
+	linhas_marca(ls, p, N);
+}
+
+/**
+ * @brief Calcula os bitboards e as grelhas de um estado a partir das entidades
+ * @param e O estado do jogo
+ */
+void estado_ocupacao (estado_p e)
+{
+	assert(e != NULL);
+
+	init_ocupacao(e);
+
+	BB_LIGA(e->bb_jogador, e->jog.pos);
+	marca_entidades(e, e->inimigo, e->num_inimigos, &e->bb_inimigos, &e->linhas_inimigos, &e->grelha_inimigos);
+	marca_entidades(e, e->obstaculo, e->num_obstaculos, &e->bb_obstaculos, &e->linhas_obstaculos, &e->grelha_obstaculos);
+}
+
+/**
+ * @brief Reserva um array de entidades
+ * @param N O numero de entidades
+ * @returns O array
+ */
+entidades aloca_entidades (size_t N)
+{
+	/* nunca devolve NULL, mesmo sem entidades */
+	entidades ret = malloc((N + 1) * sizeof(entidade));
+	check(ret == NULL, "could not allocate state");
+	return ret;
+}
+
 /**
  * @brief Inicializa um array de entidades
  * @param e O estado do jogo
@@ -59,19 +215,30 @@ bool fim_de_ronda (const estado_p e)
  * @param N O comprimento do array
  * @param num O numero de entidades que foram inicializadas
  * @param vida Vida a dar as entidades
+ * @param bb Onde marcar as casas ocupadas pelas entidades
+ * @param ls As linhas onde marcar as casas ocupadas pelas entidades
+ * @param g A grelha das entidades, que e criada
+ * @param l As casas livres
  */
-void init_entidades (estado_p e, entidades p, uchar N, uchar * num, uchar vida)
+void init_entidades (estado_p e, entidades p, size_t N, size_t * num, uchar vida, bitboard * bb, linhas * ls, grelha * g, casas_livres * l)
 {
 	assert(e != NULL);
 	assert(p != NULL);
 	assert(num != NULL);
 	assert(vida > 0);
+	assert(bb != NULL);
+	assert(g != NULL);
+
+	grelha_init(g, e->tam, N);
 
 	for ((*num) = 0; (*num) < N; (*num)++) {
-		p[(*num)].pos = nova_posicao_unica(e);
+		p[(*num)].pos = nova_posicao_unica(l);
+		BB_LIGA(*bb, p[(*num)].pos);
+		grelha_poe(g, p[(*num)].pos, *num);
 		p[(*num)].vida = vida;
 		p[(*num)].id = *num;
 	}
+	linhas_marca(ls, p, *num);
 }
 
 /**
@@ -81,39 +248,65 @@ void init_entidades (estado_p e, entidades p, uchar N, uchar * num, uchar vida)
  * @returns O minimo entre A e B
  */
 #define min(A, B)	((A) < (B)) ? (A) : (B)
+/**
+ * @brief Calcula o numero de inimigos de um nivel
+ * @param e O estado do jogo
+ * @returns O numero de inimigos
+ */
+size_t quantos_inimigos (const estado_p e)
+{
+	return min(MIN_INIMIGOS(e->tam.x, e->tam.y) + e->nivel, MAX_INIMIGOS(e->tam.x, e->tam.y));
+}
+
+/**
+ * @brief Calcula o numero de obstaculos de um nivel
+ * @param e O estado do jogo
+ * @returns O numero de obstaculos
+ */
+size_t quantos_obstaculos (const estado_p e)
+{
+	return min(MIN_OBSTACULOS(e->tam.x, e->tam.y) + e->nivel, MAX_OBSTACULOS(e->tam.x, e->tam.y));
+}
+#undef min
+
 /**
  * @brief Inicializa os inimigos
  * @param e O estado do jogo
+ * @param l As casas livres
  * @returns O novo estado
  */
-estado_s init_inimigos (estado_s e)
+estado_s init_inimigos (estado_s e, casas_livres * l)
 {
-	uchar N = min(MIN_INIMIGOS + e.nivel, MAX_INIMIGOS);
-	init_entidades(&e, e.inimigo, N, &e.num_inimigos, 1);
+	size_t N = quantos_inimigos(&e);
+	e.inimigo = aloca_entidades(N);
+	init_entidades(&e, e.inimigo, N, &e.num_inimigos, 1, &e.bb_inimigos, &e.linhas_inimigos, &e.grelha_inimigos, l);
 	return e;
 }
 
 /**
  * @brief Inicializa os obstaculos
  * @param e O estado do jogo
+ * @param l As casas livres
  * @returns O novo estado
  */
-estado_s init_obstaculos (estado_s e)
+estado_s init_obstaculos (estado_s e, casas_livres * l)
 {
-	uchar N = min(MIN_OBSTACULOS + e.nivel, MAX_OBSTACULOS);
-	init_entidades(&e, e.obstaculo, N, &e.num_obstaculos, 1);
+	size_t N = quantos_obstaculos(&e);
+	e.obstaculo = aloca_entidades(N);
+	init_entidades(&e, e.obstaculo, N, &e.num_obstaculos, 1, &e.bb_obstaculos, &e.linhas_obstaculos, &e.grelha_obstaculos, l);
 	return e;
 }
-#undef min
 
 /**
  * @brief Inicializa o jogador
  * @param e O estado do jogo
+ * @param l As casas livres
  * @returns O novo estado
  */
-estado_s init_jogador (estado_s e)
+estado_s init_jogador (estado_s e, casas_livres * l)
 {
-	e.jog.pos = nova_posicao_unica(&e);
+	e.jog.pos = nova_posicao_unica(l);
+	BB_LIGA(e.bb_jogador, e.jog.pos);
 	e.jog.vida = 20 + e.nivel;
 	return e;
 }
@@ -121,39 +314,284 @@ estado_s init_jogador (estado_s e)
 /**
  * @brief Inicializa a porta
  * @param e O estado do jogo
+ * @param l As casas livres
  * @returns O novo estado
  */
-estado_s init_porta (estado_s e)
+estado_s init_porta (estado_s e, casas_livres * l)
 {
-	e.porta = nova_posicao_unica(&e);
+	e.porta = nova_posicao_unica(l);
 	return e;
 }
 
-estado_s init_estado (uchar nivel, uchar score, enum mov_type mt, const char * nome)
+estado_s init_estado (posicao_s tam, uchar nivel, unsigned score, enum mov_type mt, const char * nome, uint64_t semente)
 {
 	assert(nome != NULL);
+	assert(tam.x >= TAM_MIN && tam.x <= TAM_MAX);
+	assert(tam.y >= TAM_MIN && tam.y <= TAM_MAX);
 
 	estado_s ret = {0};
 
 	strcpy(ret.nome, nome);
 
+	ret.tam = tam;
 	ret.nivel = nivel + 1;
 	ret.score = score;
 	ret.matou = false;
+	aleatorio_semeia(&ret.gerador, semente);
 	ret.mov_type = (mt >= MOV_TYPE_QUANTOS) ?
-		(random() % MOV_TYPE_QUANTOS) :
+		aleatorio_ate(&ret.gerador, MOV_TYPE_QUANTOS) :
 		mt;
 
-	ret = init_jogador(ret);
-	ret = init_obstaculos(ret);
-	ret = init_porta(ret);
-	ret = init_inimigos(ret);
+	init_ocupacao(&ret);
+
+	/* cada entidade (e a porta) fica numa casa diferente */
+	casas_livres l;
+	casas_livres_init(&l, tam, 2 + quantos_obstaculos(&ret) + quantos_inimigos(&ret), &ret.gerador);
+
+	ret = init_jogador(ret, &l);
+	ret = init_obstaculos(ret, &l);
+	ret = init_porta(ret, &l);
+	ret = init_inimigos(ret, &l);
+
+	casas_livres_liberta(&l);
 
 	return ret;
 }
 
+void estado_liberta (estado_p e)
+{
+	assert(e != NULL);
+
+	free(e->inimigo);
+	free(e->obstaculo);
+	free(e->bb_jogador.w);
+	grelha_liberta(&e->grelha_inimigos);
+	grelha_liberta(&e->grelha_obstaculos);
+	linhas_liberta(&e->linhas_inimigos);
+	linhas_liberta(&e->linhas_obstaculos);
+
+	e->inimigo = e->obstaculo = NULL;
+	e->bb_jogador.w = e->bb_inimigos.w = e->bb_obstaculos.w = NULL;
+}
+
+estado_s estado_copia (const estado_p e)
+{
+	assert(e != NULL);
+
+	estado_s ret = *e;
+
+	ret.inimigo = aloca_entidades(e->num_inimigos);
+	ret.obstaculo = aloca_entidades(e->num_obstaculos);
+	memcpy(ret.inimigo, e->inimigo, e->num_inimigos * sizeof(entidade));
+	memcpy(ret.obstaculo, e->obstaculo, e->num_obstaculos * sizeof(entidade));
+
+	/* num tabuleiro grande e mais barato recalcular do que copiar */
+	estado_ocupacao(&ret);
+
+	return ret;
+}
+
+size_t estado_tamanho (const estado_p e)
+{
+	assert(e != NULL);
+	return sizeof(estado_cabecalho)
+		+ ((e->num_inimigos + e->num_obstaculos) * sizeof(entidade))
+		+ sizeof(aleatorio)
+		+ sizeof(uint32_t);
+}
+
+void estado_serializa (const estado_p e, void * buf)
+{
+	assert(e != NULL);
+	assert(buf != NULL);
+
+	estado_cabecalho cab = {
+		.versao = ESTADO_VERSAO,
+		.mov_type = e->mov_type,
+		.tam = e->tam,
+		.nivel = e->nivel,
+		.score = e->score,
+		.matou = e->matou,
+		.num_inimigos = e->num_inimigos,
+		.num_obstaculos = e->num_obstaculos,
+		.jog = e->jog,
+		.porta = e->porta,
+	};
+	memcpy(cab.magic, ESTADO_MAGIC, sizeof(cab.magic));
+	memcpy(cab.nome, e->nome, sizeof(cab.nome));
+
+	uchar * p = buf;
+	memcpy(p, &cab, sizeof(cab));
+	p += sizeof(cab);
+	memcpy(p, e->inimigo, e->num_inimigos * sizeof(entidade));
+	p += e->num_inimigos * sizeof(entidade);
+	memcpy(p, e->obstaculo, e->num_obstaculos * sizeof(entidade));
+	p += e->num_obstaculos * sizeof(entidade);
+	memcpy(p, &e->gerador, sizeof(aleatorio));
+	p += sizeof(aleatorio);
+	memcpy(p, &e->turno, sizeof(uint32_t));
+}
+
+/**
+ * @brief Verifica se todas as entidades de um array estao dentro do tabuleiro
+ * @param p As entidades
+ * @param N O numero de entidades
+ * @param tam As dimensoes do tabuleiro
+ * @returns Verdadeiro se estiverem, falso caso contrario
+ */
+bool entidades_validas (const entidades p, size_t N, posicao_s tam)
+{
+	size_t i = 0;
+	for (i = 0; i < N && posicao_valida(p[i].pos, tam); i++);
+	return i == N;
+}
+
+/**
+ * @brief Converte as entidades de um estado guardado da versao 0
+ * @param dst Onde escrever as entidades
+ * @param src As entidades da versao 0
+ * @param N O numero de entidades
+ */
+void entidades_v0 (entidades dst, const entidade_v0 * src, size_t N)
+{
+	for (size_t i = 0; i < N; i++) {
+		dst[i].pos = posicao_new(src[i].pos.x, src[i].pos.y);
+		dst[i].vida = src[i].vida;
+		dst[i].id = src[i].id;
+	}
+}
+
+/**
+ * @brief Le um estado guardado da versao 0
+ * @param e Onde guardar o estado
+ * @param buf O estado guardado, com `sizeof(estado_v0)` bytes
+ * @returns Verdadeiro se o estado for valido, falso caso contrario
+ */
+bool estado_desserializa_v0 (estado_p e, const void * buf)
+{
+	estado_v0 v;
+	memcpy(&v, buf, sizeof(v));
+
+	posicao_s tam = posicao_new(ESTADO_V0_TAM, ESTADO_V0_TAM);
+
+	/* so havia o rei e o cavalo */
+	ifjmp(v.mov_type > MOV_TYPE_XADREZ_CAVALO, err);
+	ifjmp(v.num_inimigos > MAX_INIMIGOS(tam.x, tam.y), err);
+	ifjmp(v.num_obstaculos > MAX_OBSTACULOS(tam.x, tam.y), err);
+	ifjmp(memchr(v.nome, '\0', sizeof(v.nome)) == NULL, err);
+
+	estado_s ret = {0};
+
+	memcpy(ret.nome, v.nome, sizeof(ret.nome));
+	ret.nivel = v.nivel;
+	ret.matou = v.matou;
+	ret.mov_type = v.mov_type;
+	ret.tam = tam;
+	ret.score = v.score;
+	ret.num_inimigos = v.num_inimigos;
+	ret.num_obstaculos = v.num_obstaculos;
+	entidades_v0(&ret.jog, &v.jog, 1);
+	ret.porta = posicao_new(v.porta.x, v.porta.y);
+	aleatorio_semeia(&ret.gerador, aleatorio_semente());
+
+	ret.inimigo = aloca_entidades(ret.num_inimigos);
+	ret.obstaculo = aloca_entidades(ret.num_obstaculos);
+	entidades_v0(ret.inimigo, v.inimigo, ret.num_inimigos);
+	entidades_v0(ret.obstaculo, v.obstaculo, ret.num_obstaculos);
+
+	if (!posicao_valida(ret.jog.pos, tam) || !posicao_valida(ret.porta, tam)
+	    || !entidades_validas(ret.inimigo, ret.num_inimigos, tam)
+	    || !entidades_validas(ret.obstaculo, ret.num_obstaculos, tam)) {
+		free(ret.inimigo);
+		free(ret.obstaculo);
+		goto err;
+	}
+
+	estado_ocupacao(&ret);
+	*e = ret;
+
+	return true;
+err:
+	return false;
+}
+
+bool estado_desserializa (estado_p e, const void * buf, size_t n)
+{
+	assert(e != NULL);
+	assert(buf != NULL);
+
+	const uchar * p = buf;
+	estado_cabecalho cab;
+
+	/* um estado da versao 0 pode ter o mesmo tamanho que um mais recente, mas nao o magic */
+	if (n == sizeof(estado_v0) && memcmp(p, ESTADO_MAGIC, sizeof(cab.magic)) != 0)
+		return estado_desserializa_v0(e, buf);
+
+	ifjmp(n < sizeof(cab), err);
+	memcpy(&cab, p, sizeof(cab));
+	p += sizeof(cab);
+
+	ifjmp(memcmp(cab.magic, ESTADO_MAGIC, sizeof(cab.magic)) != 0, err);
+	ifjmp(cab.versao < 1 || cab.versao > ESTADO_VERSAO, err);
+	ifjmp(cab.tam.x < TAM_MIN || cab.tam.x > TAM_MAX, err);
+	ifjmp(cab.tam.y < TAM_MIN || cab.tam.y > TAM_MAX, err);
+	ifjmp(cab.mov_type >= MOV_TYPE_QUANTOS, err);
+	ifjmp(cab.num_inimigos > MAX_INIMIGOS(cab.tam.x, cab.tam.y), err);
+	ifjmp(cab.num_obstaculos > MAX_OBSTACULOS(cab.tam.x, cab.tam.y), err);
+	ifjmp(n != sizeof(cab) + (((size_t) cab.num_inimigos + cab.num_obstaculos) * sizeof(entidade))
+	      + ((cab.versao > 1) ? sizeof(aleatorio) : 0)
+	      + ((cab.versao > 2) ? sizeof(uint32_t) : 0), err);
+	ifjmp(memchr(cab.nome, '\0', sizeof(cab.nome)) == NULL, err);
+	ifjmp(!posicao_valida(cab.jog.pos, cab.tam) || !posicao_valida(cab.porta, cab.tam), err);
+
+	estado_s ret = {0};
+
+	memcpy(ret.nome, cab.nome, sizeof(ret.nome));
+	ret.nivel = cab.nivel;
+	ret.matou = cab.matou;
+	ret.mov_type = cab.mov_type;
+	ret.tam = cab.tam;
+	ret.score = cab.score;
+	ret.num_inimigos = cab.num_inimigos;
+	ret.num_obstaculos = cab.num_obstaculos;
+	ret.jog = cab.jog;
+	ret.porta = cab.porta;
+
+	ret.inimigo = aloca_entidades(ret.num_inimigos);
+	ret.obstaculo = aloca_entidades(ret.num_obstaculos);
+	memcpy(ret.inimigo, p, ret.num_inimigos * sizeof(entidade));
+	p += ret.num_inimigos * sizeof(entidade);
+	memcpy(ret.obstaculo, p, ret.num_obstaculos * sizeof(entidade));
+	p += ret.num_obstaculos * sizeof(entidade);
+
+	if (cab.versao > 1)
+		memcpy(&ret.gerador, p, sizeof(aleatorio));
+	else
+		aleatorio_semeia(&ret.gerador, aleatorio_semente());
+	p += (cab.versao > 1) ? sizeof(aleatorio) : 0;
+
+	if (cab.versao > 2)
+		memcpy(&ret.turno, p, sizeof(uint32_t));
+
+	if (!entidades_validas(ret.inimigo, ret.num_inimigos, ret.tam)
+	    || !entidades_validas(ret.obstaculo, ret.num_obstaculos, ret.tam)) {
+		free(ret.inimigo);
+		free(ret.obstaculo);
+		goto err;
+	}
+
+	estado_ocupacao(&ret);
+	*e = ret;
+
+	return true;
+err:
+	return false;
+}
+
 estado_s move_jogador (estado_s e, posicao_s p)
 {
+	BB_DESLIGA(e.bb_jogador, e.jog.pos);
+	BB_LIGA(e.bb_jogador, p);
 	e.jog.pos = p;
 	/* nao perde vida no fim de uma ronda */
 	if (!fim_de_ronda(&e) && !e.matou)
@@ -162,23 +600,42 @@ estado_s move_jogador (estado_s e, posicao_s p)
 	return e;
 }
 
+estado_s move_inimigo (estado_s e, size_t I, posicao_s p)
+{
+	assert(I < e.num_inimigos);
+	assert(!posicao_ocupada(&e, p));
+
+	BB_DESLIGA(e.bb_inimigos, e.inimigo[I].pos);
+	BB_LIGA(e.bb_inimigos, p);
+	linhas_desliga(&e.linhas_inimigos, e.inimigo[I].pos);
+	linhas_liga(&e.linhas_inimigos, p);
+	grelha_move(&e.grelha_inimigos, e.inimigo[I].pos, p, I);
+	e.inimigo[I].pos = p;
+
+	return e;
+}
+
 bool nao_tem_inimigos (const estado_p e, const posicao_p p)
 {
 	assert(e != NULL);
 	assert(p != NULL);
-	return !pos_inimigos(e->inimigo, *p, e->num_inimigos);
+	return !BB_TESTA(e->bb_inimigos, *p);
 }
 
-estado_s ataca_inimigo (estado_s ret, uchar I)
+estado_s ataca_inimigo (estado_s ret, size_t I)
 {
 	assert(ret.inimigo[I].vida > 0);
 
 	ret.inimigo[I].vida--;
-	ret.jog.vida += 5;
+	/* a vida e um `uchar`: satura em vez de dar a volta */
+	ret.jog.vida = (ret.jog.vida > UCHAR_MAX - 5) ?
+		UCHAR_MAX :
+		ret.jog.vida + 5;
 
 	ifjmp(!entidade_dead(ret.inimigo + I), out);
 
-	ret.num_inimigos = entidade_remove(ret.inimigo, I, ret.num_inimigos);
+	linhas_desliga(&ret.linhas_inimigos, ret.inimigo[I].pos);
+	ret.num_inimigos = entidade_remove(ret.inimigo, I, ret.num_inimigos, &ret.bb_inimigos, &ret.grelha_inimigos);
 	ret.matou = true;
 	ret.score++;
 
@@ -186,7 +643,7 @@ out:
 	return ret;
 }
 
-estado_s ataca_jogador (const estado_p e, uchar I)
+estado_s ataca_jogador (const estado_p e, size_t I)
 {
 	assert(e != NULL);
 
@@ -195,7 +652,8 @@ estado_s ataca_jogador (const estado_p e, uchar I)
 	ifjmp(fim_de_jogo(&ne), out);
 
 	ne.jog.vida--;
-	ne.inimigo[I].vida++;
+	if (ne.inimigo[I].vida < UCHAR_MAX)
+		ne.inimigo[I].vida++;
 
 out:
 	return ne;
@@ -0,0 +1,617 @@
+/** @file */
+#include "check.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "html.h"
+#include "posicao.h"
+#include "saida.h"
+
+#include "fcgi.h"
+
+/**
+ * @brief Tamanho do cabecalho de um record FastCGI.
+ */
+#define FCGI_HEADER_LEN		8
+
+/**
+ * @brief Tamanho maximo do conteudo de um record FastCGI.
+ */
+#define FCGI_CONTENT_MAX	0xffff
+
+/**
+ * @brief Versao do protocolo FastCGI.
+ */
+#define FCGI_VERSION_1		1
+
+/**
+ * @brief O unico papel suportado: responder a pedidos.
+ */
+#define FCGI_RESPONDER		1
+
+/**
+ * @brief Flag do `FCGI_BEGIN_REQUEST` para manter a ligacao aberta.
+ */
+#define FCGI_KEEP_CONN		1
+
+/**
+ * @brief Tipos de record FastCGI.
+ */
+enum fcgi_tipo {
+	/** Inicio de um pedido. */
+	FCGI_BEGIN_REQUEST = 1,
+	/** Pedido cancelado pelo servidor web. */
+	FCGI_ABORT_REQUEST,
+	/** Fim de um pedido. */
+	FCGI_END_REQUEST,
+	/** Variaveis de ambiente CGI. */
+	FCGI_PARAMS,
+	/** Corpo do pedido. */
+	FCGI_STDIN,
+	/** Resposta. */
+	FCGI_STDOUT,
+	/** Erros. */
+	FCGI_STDERR,
+	/** Dados extra (papel filter). */
+	FCGI_DATA,
+	/** Pergunta pelas capacidades da aplicacao. */
+	FCGI_GET_VALUES,
+	/** Resposta a FCGI_GET_VALUES. */
+	FCGI_GET_VALUES_RESULT,
+	/** Resposta a um record de gestao desconhecido. */
+	FCGI_UNKNOWN_TYPE,
+	/** Numero de tipos de record. */
+	FCGI_TIPO_QUANTOS,
+};
+
+/**
+ * @brief Estado do protocolo a terminar um pedido.
+ */
+enum fcgi_protocol_status {
+	/** Pedido terminado normalmente. */
+	FCGI_REQUEST_COMPLETE,
+	/** Pedido rejeitado, nao ha multiplexacao. */
+	FCGI_CANT_MPX_CONN,
+	/** Pedido rejeitado, sem recursos. */
+	FCGI_OVERLOADED,
+	/** Pedido rejeitado, papel desconhecido. */
+	FCGI_UNKNOWN_ROLE,
+};
+
+/**
+ * @brief O pedido activo numa ligacao.
+ */
+typedef struct {
+	/** A funcao que responde ao pedido. */
+	fcgi_handler handler;
+	/** O id do pedido, ou 0 se nao houver nenhum activo. */
+	unsigned id;
+	/** Se a ligacao fica aberta depois do pedido. */
+	bool keep_conn;
+	/** Os bytes dos `FCGI_PARAMS` recebidos ate agora. */
+	uchar * params;
+	/** O numero de bytes em `params`. */
+	size_t num_params;
+	/** A capacidade de `params`. */
+	size_t cap_params;
+} fcgi_pedido;
+
+bool fcgi_e_fcgi (void)
+{
+	struct sockaddr sa;
+	socklen_t len = sizeof(sa);
+	/* um socket a escuta nao tem peer */
+	return getpeername(FCGI_LISTENSOCK_FILENO, &sa, &len) < 0
+		&& errno == ENOTCONN;
+}
+
+/**
+ * @brief Le exactamente `n` bytes de um descritor.
+ * @param fd O descritor.
+ * @param buf Onde guardar os bytes.
+ * @param n O numero de bytes a ler.
+ * @returns Verdadeiro se conseguiu ler tudo, falso caso contrario.
+ */
+bool fcgi_le (int fd, void * buf, size_t n)
+{
+	uchar * p = buf;
+	while (n > 0) {
+		ssize_t r = read(fd, p, n);
+		if (r < 0 && errno == EINTR)
+			continue;
+		ifjmp(r <= 0, err);
+		p += r;
+		n -= r;
+	}
+	return true;
+err:
+	return false;
+}
+
+/**
+ * @brief Escreve exactamente `n` bytes num descritor.
+ * @param fd O descritor.
+ * @param buf Os bytes a escrever.
+ * @param n O numero de bytes a escrever.
+ * @returns Verdadeiro se conseguiu escrever tudo, falso caso contrario.
+ */
+bool fcgi_escreve (int fd, const void * buf, size_t n)
+{
+	const uchar * p = buf;
+	while (n > 0) {
+		ssize_t w = write(fd, p, n);
+		if (w < 0 && errno == EINTR)
+			continue;
+		/* um `EPIPE` so acaba com esta ligacao */
+		ifjmp(w <= 0, err);
+		p += w;
+		n -= w;
+	}
+	return true;
+err:
+	return false;
+}
+
+/**
+ * @brief Envia um record.
+ * @param fd O descritor da ligacao.
+ * @param tipo O tipo do record.
+ * @param id O id do pedido.
+ * @param buf O conteudo.
+ * @param n O tamanho do conteudo (no maximo `FCGI_CONTENT_MAX`).
+ * @returns Verdadeiro se conseguiu enviar, falso caso contrario.
+ */
+bool fcgi_envia (int fd, enum fcgi_tipo tipo, unsigned id, const void * buf, size_t n)
+{
+	assert(n <= FCGI_CONTENT_MAX);
+
+	uchar cab[FCGI_HEADER_LEN] = {
+		FCGI_VERSION_1,
+		tipo,
+		(id >> 8) & 0xff,
+		id & 0xff,
+		(n >> 8) & 0xff,
+		n & 0xff,
+		0,
+		0,
+	};
+
+	return fcgi_escreve(fd, cab, FCGI_HEADER_LEN)
+		&& fcgi_escreve(fd, buf, n);
+}
+
+/**
+ * @brief Envia uma stream, partida em records, terminada por um record vazio.
+ * @param fd O descritor da ligacao.
+ * @param tipo O tipo da stream.
+ * @param id O id do pedido.
+ * @param buf O conteudo.
+ * @param n O tamanho do conteudo.
+ * @returns Verdadeiro se conseguiu enviar, falso caso contrario.
+ */
+bool fcgi_envia_stream (int fd, enum fcgi_tipo tipo, unsigned id, const char * buf, size_t n)
+{
+	/* multiplo de 8, para nao precisar de padding */
+	const size_t bloco = FCGI_CONTENT_MAX & ~7UL;
+
+	for (size_t i = 0; i < n; i += bloco) {
+		size_t len = (n - i < bloco) ? (n - i) : bloco;
+		ifjmp(!fcgi_envia(fd, tipo, id, buf + i, len), err);
+	}
+
+	return fcgi_envia(fd, tipo, id, NULL, 0);
+err:
+	return false;
+}
+
+/**
+ * @brief Termina um pedido.
+ * @param fd O descritor da ligacao.
+ * @param id O id do pedido.
+ * @param status O estado do protocolo.
+ * @returns Verdadeiro se conseguiu enviar, falso caso contrario.
+ */
+bool fcgi_envia_fim (int fd, unsigned id, enum fcgi_protocol_status status)
+{
+	uchar corpo[8] = { 0, 0, 0, 0, status, 0, 0, 0 };
+	return fcgi_envia(fd, FCGI_END_REQUEST, id, corpo, sizeof(corpo));
+}
+
+/**
+ * @brief Le o comprimento de um nome ou valor de um par nome-valor.
+ * @param p O cursor, avancado para depois do comprimento.
+ * @param fim O fim do buffer.
+ * @param len Onde guardar o comprimento.
+ * @returns Verdadeiro se o comprimento cabe no buffer, falso caso contrario.
+ */
+bool fcgi_le_comprimento (const uchar ** p, const uchar * fim, size_t * len)
+{
+	ifjmp(*p >= fim, err);
+
+	if (**p >> 7) {
+		ifjmp(fim - *p < 4, err);
+		*len = (((size_t) (*p)[0] & 0x7f) << 24)
+			| ((size_t) (*p)[1] << 16)
+			| ((size_t) (*p)[2] << 8)
+			| (size_t) (*p)[3];
+		*p += 4;
+	} else {
+		*len = **p;
+		*p += 1;
+	}
+
+	return true;
+err:
+	return false;
+}
+
+/**
+ * @brief Percorre os pares nome-valor de um buffer.
+ * @param buf O buffer.
+ * @param n O tamanho do buffer.
+ * @param f Funcao chamada com cada par.
+ * @param arg Argumento passado a `f`.
+ */
+void fcgi_pares (const uchar * buf, size_t n,
+		void (* f) (const uchar * nome, size_t nlen, const uchar * valor, size_t vlen, void * arg),
+		void * arg)
+{
+	const uchar * p = buf;
+	const uchar * fim = buf + n;
+
+	while (p < fim) {
+		size_t nlen = 0;
+		size_t vlen = 0;
+
+		ifjmp(!fcgi_le_comprimento(&p, fim, &nlen), out);
+		ifjmp(!fcgi_le_comprimento(&p, fim, &vlen), out);
+		ifjmp((size_t) (fim - p) < nlen + vlen, out);
+
+		f(p, nlen, p + nlen, vlen, arg);
+		p += nlen + vlen;
+	}
+
+out:
+	return;
+}
+
+/**
+ * @brief Copia o valor de `QUERY_STRING`, se for esse o par.
+ * @param nome O nome.
+ * @param nlen O comprimento do nome.
+ * @param valor O valor.
+ * @param vlen O comprimento do valor.
+ * @param arg Buffer de `FCGI_QS_MAX` bytes onde guardar a `QUERY_STRING`.
+ */
+void fcgi_par_qs (const uchar * nome, size_t nlen, const uchar * valor, size_t vlen, void * arg)
+{
+	char * qs = arg;
+
+	ifjmp(nlen != 12 || memcmp(nome, "QUERY_STRING", 12) != 0, out);
+
+	if (vlen >= FCGI_QS_MAX)
+		vlen = FCGI_QS_MAX - 1;
+	memcpy(qs, valor, vlen);
+	qs[vlen] = '\0';
+
+out:
+	return;
+}
+
+/**
+ * @brief Escolhe a codificacao da resposta, se o par for `HTTP_ACCEPT_ENCODING`.
+ * @param nome O nome.
+ * @param nlen O comprimento do nome.
+ * @param valor O valor.
+ * @param vlen O comprimento do valor.
+ * @param arg A `enum saida_codificacao` onde guardar a codificacao.
+ */
+void fcgi_par_codificacao (const uchar * nome, size_t nlen, const uchar * valor, size_t vlen, void * arg)
+{
+	enum saida_codificacao * cod = arg;
+
+	ifjmp(nlen != 20 || memcmp(nome, "HTTP_ACCEPT_ENCODING", 20) != 0, out);
+
+	*cod = saida_codificacao_aceite((const char *) valor, vlen);
+
+out:
+	return;
+}
+
+/**
+ * @brief Guarda o `If-None-Match` do pedido, se o par for `HTTP_IF_NONE_MATCH`.
+ * @param nome O nome.
+ * @param nlen O comprimento do nome.
+ * @param valor O valor.
+ * @param vlen O comprimento do valor.
+ * @param arg Nao e usado.
+ */
+void fcgi_par_condicao (const uchar * nome, size_t nlen, const uchar * valor, size_t vlen, void * arg)
+{
+	UNUSED(arg);
+
+	ifjmp(nlen != 18 || memcmp(nome, "HTTP_IF_NONE_MATCH", 18) != 0, out);
+
+	saida_condicao((const char *) valor, vlen);
+
+out:
+	return;
+}
+
+/**
+ * @brief Buffer de resposta a `FCGI_GET_VALUES`.
+ */
+typedef struct {
+	/** Os pares nome-valor. */
+	uchar buf[128];
+	/** Bytes usados. */
+	size_t n;
+} fcgi_valores;
+
+/**
+ * @brief Responde a uma variavel pedida em `FCGI_GET_VALUES`.
+ * @param nome O nome.
+ * @param nlen O comprimento do nome.
+ * @param valor O valor (vazio).
+ * @param vlen O comprimento do valor.
+ * @param arg O `fcgi_valores` onde acrescentar a resposta.
+ */
+void fcgi_par_valor (const uchar * nome, size_t nlen, const uchar * valor, size_t vlen, void * arg)
+{
+	static const char * conhecidos[][2] = {
+		{ "FCGI_MAX_CONNS",  "1" },
+		{ "FCGI_MAX_REQS",   "1" },
+		{ "FCGI_MPXS_CONNS", "0" },
+	};
+
+	UNUSED(valor);
+	UNUSED(vlen);
+
+	fcgi_valores * v = arg;
+
+	for (size_t i = 0; i < sizeof(conhecidos) / sizeof(*conhecidos); i++) {
+		size_t cn = strlen(conhecidos[i][0]);
+		if (cn != nlen || memcmp(nome, conhecidos[i][0], cn) != 0)
+			continue;
+		ifjmp(v->n + 2 + cn + 1 > sizeof(v->buf), out);
+		v->buf[v->n++] = cn;
+		v->buf[v->n++] = 1;
+		memcpy(v->buf + v->n, conhecidos[i][0], cn);
+		v->n += cn;
+		v->buf[v->n++] = conhecidos[i][1][0];
+	}
+
+out:
+	return;
+}
+
+/**
+ * @brief Tipo de funcoes que tratam um record de um pedido.
+ *
+ * Devolvem falso se a ligacao deve ser fechada.
+ */
+typedef bool (* fcgi_record_handler) (int fd, fcgi_pedido * p, unsigned id, const uchar * c, size_t len);
+
+/**
+ * @brief Trata um `FCGI_BEGIN_REQUEST`.
+ * @param fd O descritor da ligacao.
+ * @param p O pedido activo.
+ * @param id O id do record.
+ * @param c O conteudo do record.
+ * @param len O tamanho do conteudo.
+ * @returns Falso se a ligacao deve ser fechada.
+ */
+bool fcgi_begin_handler (int fd, fcgi_pedido * p, unsigned id, const uchar * c, size_t len)
+{
+	ifjmp(len < 8, err);
+
+	unsigned role = (c[0] << 8) | c[1];
+	bool keep_conn = c[2] & FCGI_KEEP_CONN;
+
+	/* um pedido de cada vez */
+	if (p->id != 0)
+		return fcgi_envia_fim(fd, id, FCGI_CANT_MPX_CONN);
+
+	if (role != FCGI_RESPONDER)
+		return fcgi_envia_fim(fd, id, FCGI_UNKNOWN_ROLE) && keep_conn;
+
+	p->id = id;
+	p->keep_conn = keep_conn;
+	p->num_params = 0;
+
+	return true;
+err:
+	return false;
+}
+
+/**
+ * @brief Trata um `FCGI_PARAMS`.
+ * @param fd O descritor da ligacao.
+ * @param p O pedido activo.
+ * @param id O id do record.
+ * @param c O conteudo do record.
+ * @param len O tamanho do conteudo.
+ * @returns Falso se a ligacao deve ser fechada.
+ */
+bool fcgi_params_handler (int fd, fcgi_pedido * p, unsigned id, const uchar * c, size_t len)
+{
+	UNUSED(fd);
+	ifjmp(id != p->id, out);
+
+	if (p->num_params + len > p->cap_params) {
+		p->cap_params = (p->num_params + len) << 1;
+		p->params = realloc(p->params, p->cap_params);
+		check(p->params == NULL, "could not allocate FastCGI params");
+	}
+
+	memcpy(p->params + p->num_params, c, len);
+	p->num_params += len;
+
+out:
+	return true;
+}
+
+/**
+ * @brief Trata um `FCGI_STDIN`; quando a stream acaba, responde ao pedido.
+ * @param fd O descritor da ligacao.
+ * @param p O pedido activo.
+ * @param id O id do record.
+ * @param c O conteudo do record.
+ * @param len O tamanho do conteudo.
+ * @returns Falso se a ligacao deve ser fechada.
+ */
+bool fcgi_stdin_handler (int fd, fcgi_pedido * p, unsigned id, const uchar * c, size_t len)
+{
+	UNUSED(c);
+	/* o corpo do pedido nao e usado, so interessa o fim da stream */
+	ifjmp(id != p->id || len > 0, out);
+
+	char qs[FCGI_QS_MAX] = "";
+	fcgi_pares(p->params, p->num_params, fcgi_par_qs, qs);
+
+	enum saida_codificacao cod = SAIDA_IDENTIDADE;
+	fcgi_pares(p->params, p->num_params, fcgi_par_codificacao, &cod);
+
+	char * buf = NULL;
+	saida_inicio(CONTENT_TYPE);
+	fcgi_pares(p->params, p->num_params, fcgi_par_condicao, NULL);
+	p->handler(qs);
+	size_t n = saida_fim_cgi(cod, &buf);
+
+	p->id = 0;
+
+	return fcgi_envia_stream(fd, FCGI_STDOUT, id, buf, n)
+		&& fcgi_envia_fim(fd, id, FCGI_REQUEST_COMPLETE)
+		&& p->keep_conn;
+out:
+	return true;
+}
+
+/**
+ * @brief Trata um `FCGI_ABORT_REQUEST`.
+ * @param fd O descritor da ligacao.
+ * @param p O pedido activo.
+ * @param id O id do record.
+ * @param c O conteudo do record.
+ * @param len O tamanho do conteudo.
+ * @returns Falso se a ligacao deve ser fechada.
+ */
+bool fcgi_abort_handler (int fd, fcgi_pedido * p, unsigned id, const uchar * c, size_t len)
+{
+	UNUSED(c);
+	UNUSED(len);
+	ifjmp(id != p->id, out);
+
+	p->id = 0;
+	return fcgi_envia_fim(fd, id, FCGI_REQUEST_COMPLETE) && p->keep_conn;
+out:
+	return true;
+}
+
+/**
+ * @brief Trata um `FCGI_GET_VALUES`.
+ * @param fd O descritor da ligacao.
+ * @param p O pedido activo.
+ * @param id O id do record.
+ * @param c O conteudo do record.
+ * @param len O tamanho do conteudo.
+ * @returns Falso se a ligacao deve ser fechada.
+ */
+bool fcgi_get_values_handler (int fd, fcgi_pedido * p, unsigned id, const uchar * c, size_t len)
+{
+	UNUSED(p);
+	fcgi_valores v = { .n = 0 };
+	fcgi_pares(c, len, fcgi_par_valor, &v);
+	return fcgi_envia(fd, FCGI_GET_VALUES_RESULT, id, v.buf, v.n);
+}
+
+/**
+ * @brief Devolve um array de apontadores para funcoes que tratam cada tipo de record.
+ * @returns Array de apontadores de funcoes.
+ */
+const fcgi_record_handler * fcgi_record_handlers (void)
+{
+	static const fcgi_record_handler ret[FCGI_TIPO_QUANTOS] = {
+		[FCGI_BEGIN_REQUEST] = fcgi_begin_handler,
+		[FCGI_ABORT_REQUEST] = fcgi_abort_handler,
+		[FCGI_PARAMS]        = fcgi_params_handler,
+		[FCGI_STDIN]         = fcgi_stdin_handler,
+		[FCGI_GET_VALUES]    = fcgi_get_values_handler,
+	};
+	return ret;
+}
+
+/**
+ * @brief Atende todos os pedidos de uma ligacao.
+ * @param fd O descritor da ligacao.
+ * @param handler A funcao que responde a cada pedido.
+ */
+void fcgi_conexao (int fd, fcgi_handler handler)
+{
+	static uchar conteudo[FCGI_CONTENT_MAX + 0xff];
+
+	const fcgi_record_handler * handlers = fcgi_record_handlers();
+	assert(handlers != NULL);
+
+	fcgi_pedido p = {
+		.handler = handler,
+		.id = 0,
+	};
+
+	uchar cab[FCGI_HEADER_LEN];
+
+	while (fcgi_le(fd, cab, FCGI_HEADER_LEN)) {
+		unsigned tipo = cab[1];
+		unsigned id = (cab[2] << 8) | cab[3];
+		size_t len = (cab[4] << 8) | cab[5];
+
+		ifjmp(!fcgi_le(fd, conteudo, len + cab[6]), out);
+
+		fcgi_record_handler h = (tipo < FCGI_TIPO_QUANTOS) ?
+			handlers[tipo] :
+			NULL;
+
+		if (h == NULL) {
+			/* records de gestao desconhecidos tem resposta, os outros ignoram-se */
+			uchar corpo[8] = { tipo, 0, 0, 0, 0, 0, 0, 0 };
+			if (id == 0)
+				ifjmp(!fcgi_envia(fd, FCGI_UNKNOWN_TYPE, 0, corpo, sizeof(corpo)), out);
+			continue;
+		}
+
+		ifjmp(!h(fd, &p, id, conteudo, len), out);
+	}
+
+out:
+	free(p.params);
+}
+
+int fcgi_serve (fcgi_handler handler)
+{
+	assert(handler != NULL);
+
+	/* o servidor web pode fechar a ligacao antes de ler a resposta */
+	signal(SIGPIPE, SIG_IGN);
+
+	for (;;) {
+		int fd = accept(FCGI_LISTENSOCK_FILENO, NULL, NULL);
+
+		if (fd < 0 && errno == EINTR)
+			continue;
+		ifjmp(fd < 0, err);
+
+		fcgi_conexao(fd, handler);
+		close(fd);
+	}
+
+err:
+	perror("could not accept FastCGI connection");
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,64 @@
+/** @file */
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "posicao.h"
+
+#include "grelha.h"
+
+void grelha_init (grelha * g, posicao_s tam, size_t N)
+{
+	assert(g != NULL);
+
+	size_t l = (tam.x + GRELHA_LADO - 1) / GRELHA_LADO;
+	size_t a = (tam.y + GRELHA_LADO - 1) / GRELHA_LADO;
+
+	g->largura = l;
+	g->cabeca = calloc(l * a, sizeof(uint32_t));
+	/* nunca e NULL, mesmo sem entidades */
+	g->prox = calloc(N + 1, sizeof(uint32_t));
+	check(g->cabeca == NULL || g->prox == NULL, "could not allocate grid");
+}
+
+void grelha_liberta (grelha * g)
+{
+	assert(g != NULL);
+
+	free(g->cabeca);
+	free(g->prox);
+
+	g->cabeca = g->prox = NULL;
+}
+
+void grelha_poe (grelha * g, posicao_s p, size_t i)
+{
+	assert(g != NULL);
+
+	uint32_t * c = g->cabeca + GRELHA_CELULA(*g, p);
+	g->prox[i] = *c;
+	*c = i + 1;
+}
+
+void grelha_tira (grelha * g, posicao_s p, size_t i)
+{
+	assert(g != NULL);
+
+	uint32_t * c = g->cabeca + GRELHA_CELULA(*g, p);
+	while (*c != i + 1) {
+		assert(*c != 0);
+		c = g->prox + (*c - 1);
+	}
+	*c = g->prox[i];
+}
+
+void grelha_move (grelha * g, posicao_s de, posicao_s para, size_t i)
+{
+	assert(g != NULL);
+
+	if (GRELHA_CELULA(*g, de) != GRELHA_CELULA(*g, para)) {
+		grelha_tira(g, de, i);
+		grelha_poe(g, para, i);
+	}
+}
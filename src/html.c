@@ -2,88 +2,142 @@
 #include "check.h"
 
 #include <stdlib.h>
+#include <string.h>
 
+#include "aleatorio.h"
 #include "posicao.h"
 #include "estado.h"
 #include "jogo.h"
 
+#include "saida.h"
+
 #include "html.h"
-#include <stdio.h>
-#include <stdlib.h>
+
+#ifdef HTML_IMAGENS_EMBUTIDAS
+#include "imagens.h"
+#endif
 
 /**
- * @brief Imprime entidades do jogo.
- * @param p As entidades.
- * @param max O numero de entidades.
- * @param img A imagem da entidade.
+ * @brief Verifica se uma posicao esta dentro da parte do tabuleiro que e mostrada.
+ * @param v A parte do tabuleiro que e mostrada.
+ * @param p A posicao.
+ * @returns Verdadeiro se estiver, falso caso contrario.
  */
-void imprime_entidades (const entidades p, size_t max, char * img)
+bool na_vista (const janela * v, posicao_s p)
 {
-	size_t i = 0;
+	return janela_contem(v, p.x, p.y);
+}
 
+/**
+ * @brief Imprime uma entidade do jogo, se estiver a vista.
+ * @param p A entidade.
+ * @param img O id, no `<defs>`, da imagem da entidade.
+ * @param v A parte do tabuleiro que e mostrada.
+ */
+void imprime_entidade (const entidade * p, const char * img, const janela * v)
+{
 	assert(p != NULL);
 	assert(img != NULL);
+	assert(v != NULL);
+
+	if (na_vista(v, p->pos))
+		USE(img, (size_t) (p->pos.x - v->min.x), (size_t) (p->pos.y - v->min.y));
+}
 
-	for (i = 0; i < max; i++)
-		IMAGE(p[i].pos.x, p[i].pos.y, ESCALA, img);
+/**
+ * @brief Imprime as entidades do jogo que estao a vista.
+ * @param p As entidades.
+ * @param g A grelha das entidades.
+ * @param img O id, no `<defs>`, da imagem das entidades.
+ * @param v A parte do tabuleiro que e mostrada.
+ */
+void imprime_entidades (const entidades p, const grelha * g, const char * img, const janela * v)
+{
+	static _Thread_local size_t ind[VISTA * VISTA];
+	size_t n = entidades_recolhe(p, g, v->min, v->max, ind);
+
+	for (size_t i = 0; i < n; i++)
+		imprime_entidade(p + ind[i], img, v);
 }
 
 /**
  * @brief Imprime os inimigos do jogo.
  * @param e O estado actual.
+ * @param v A parte do tabuleiro que e mostrada.
  */
-void imprime_inimigos (const estado_p e)
+void imprime_inimigos (const estado_p e, const janela * v)
 {
 	assert(e != NULL);
-	imprime_entidades(e->inimigo, e->num_inimigos, IMG_INIMIGO);
+	imprime_entidades(e->inimigo, &e->grelha_inimigos, DEF_INIMIGO, v);
 }
 
 /**
  * @brief Imprime os obstaculos do jogo.
  * @param e O estado actual.
+ * @param v A parte do tabuleiro que e mostrada.
  */
-void imprime_obstaculos (const estado_p e)
+void imprime_obstaculos (const estado_p e, const janela * v)
 {
 	assert(e != NULL);
-	imprime_entidades(e->obstaculo, e->num_obstaculos, IMG_OBSTACULO);
+	imprime_entidades(e->obstaculo, &e->grelha_obstaculos, DEF_OBSTACULO, v);
 }
 
 /**
  * @brief Imprime o link de uma jogada.
  * @param j A jogada.
+ * @param v A parte do tabuleiro que e mostrada.
  */
-void imprime_jogada (const jogada_p j)
+void imprime_jogada (const jogada_p j, const janela * v)
 {
 	assert(j != NULL);
 	assert(j->link != NULL);
 
 	GAME_LINK(j->link); {
-		RECT_TRANSPARENTE(j->dest.y, j->dest.x, ESCALA);
+		USE(DEF_JOGADA, (size_t) (j->dest.x - v->min.x), (size_t) (j->dest.y - v->min.y));
 	} FECHA_A;
 }
 
 /**
  * @brief Imprime as jogadas possiveis do jogador.
  * @param e O estado actual.
+ * @param v A parte do tabuleiro que e mostrada.
  */
-void imprime_jogadas (const estado_p e)
+void imprime_jogadas (const estado_p e, const janela * v)
 {
-	uchar N = 0;
-	uchar i = 0;
-	jogada_p j = NULL;
+	size_t N = 0;
+	size_t i = 0;
 
 	assert(e != NULL);
 
-	j = jogadas_possiveis(e);
-	assert(j != NULL);
+	jogada_p j = aloca_jogadas(e);
+	N = jogadas_possiveis(e, j);
 
 	/* imprimir o jogador */
-	imprime_entidades(&e->jog, 1, IMG_JOGADOR);
+	imprime_entidade(&e->jog, DEF_JOGADOR, v);
 
-	/* imprimir as jogadas */
-	N = quantas_jogadas(j);
+	/* imprimir as jogadas que se veem */
 	for (i = 0; i < N; i++)
-		imprime_jogada(j + i);
+		if (na_vista(v, j[i].dest))
+			imprime_jogada(j + i, v);
+
+	free(j);
+}
+
+/**
+ * @brief Escreve uma cor de 12 bits, `#rgb`.
+ * @param rgb A cor, menor que `1 << 12`.
+ * @returns A cor, num buffer da thread reutilizado na proxima chamada.
+ */
+char * cor_rgb (unsigned rgb)
+{
+	/* "#rgb0", um digito hexadecimal de cada vez, sem `sprintf` */
+	static const char hex[] = "0123456789abcdef";
+	static _Thread_local char ret[5] = "#";
+	for (size_t i = 3; i > 0; i--, rgb >>= 4)
+		ret[i] = hex[rgb & 0xf];
+	ret[4] = '\0';
+
+	return ret;
 }
 
 /**
@@ -98,46 +152,178 @@ void imprime_jogadas (const estado_p e)
 char * random_color (void)
 {
 	/*
-	 * cada cor tem 3 bytes,
-	 * logo existem 2 ^ (3 * 8)
+	 * cada cor tem 3 digitos hexadecimais, `#rgb`,
+	 * logo existem 2 ^ (3 * 4)
 	 * cores diferentes
 	 */
-#define NUM_CORES	(1 << (3 * 8))
-	unsigned int rgb = rand() % NUM_CORES;
-
-	/* "#rrggbb0" */
-	static char ret[8] = "#";
-	sprintf(ret+1, "%06x", rgb);
-	ret[7] = '\0';
+#define NUM_CORES	(1 << (3 * 4))
+	/* as cores nao fazem parte do jogo, logo nao usam o gerador do estado */
+	static _Thread_local aleatorio gerador;
+	static _Thread_local bool semeado = false;
+	if (!semeado)
+		aleatorio_semeia(&gerador, aleatorio_semente());
+	semeado = true;
+
+	return cor_rgb(aleatorio_ate(&gerador, NUM_CORES));
+#undef NUM_CORES
+}
 
+/**
+ * @brief Calcula a chave de um nivel, a partir do gerador do estado, que
+ * so e usado quando um nivel e criado.
+ * @param e O estado actual.
+ * @returns A chave.
+ */
+uint64_t html_nivel (const estado_p e)
+{
+	uint64_t ret = ((uint64_t) e->tam.x << 32) ^ ((uint64_t) e->tam.y << 16) ^ e->nivel;
+	for (size_t i = 0; i < 4; i++) {
+		ret ^= e->gerador.s[i];
+		ret = splitmix64(&ret);
+	}
 	return ret;
-#undef NUM_CORES
+}
+
+/**
+ * @brief Calcula a cor de uma casa, que e sempre a mesma durante um nivel.
+ * @param nivel A chave do nivel.
+ * @param p A casa.
+ * @returns A cor.
+ */
+char * cor_casa (uint64_t nivel, posicao_s p)
+{
+	uint64_t x = nivel ^ (((uint64_t) p.x << 16) | p.y);
+	/* os 12 bits de cima, os mais bem misturados */
+	return cor_rgb(splitmix64(&x) >> 52);
 }
 
 /**
  * @brief Imprime o tabuleiro.
- * @param L A largura do tabuleiro.
- * @param C A altura do tabuleiro.
+ * @param nivel A chave do nivel.
+ * @param v A parte do tabuleiro que e mostrada.
  */
-void imprime_tabuleiro (abcissa L, ordenada C)
+void imprime_tabuleiro (uint64_t nivel, const janela * v)
 {
+	size_t L = v->max.y - v->min.y;
+	size_t C = v->max.x - v->min.x;
 	size_t l = 0;
 	size_t c = 0;
 	for (l = 0; l < L; l++) {
 		for (c = 0; c < C; c++)
-			IMPRIME_CASA(l, c);
-		putchar('\n');
+			IMPRIME_CASA(l, c, cor_casa(nivel, posicao_new(v->min.x + c, v->min.y + l)));
+		saida_char('\n');
 	}
 }
 
 /**
  * @brief Imprime a porta.
  * @param e O estado actual.
+ * @param v A parte do tabuleiro que e mostrada.
+ */
+void imprime_porta (const estado_p e, const janela * v)
+{
+	assert(e != NULL);
+	if (na_vista(v, e->porta))
+		USE(DEF_PORTA, (size_t) (e->porta.x - v->min.x), (size_t) (e->porta.y - v->min.y));
+}
+
+/**
+ * @brief A camada fixa de um nivel, vista numa parte do tabuleiro: as
+ * casas, a porta e os obstaculos.
+ */
+typedef struct {
+	/** A chave do nivel. */
+	uint64_t nivel;
+	/** O gerador do estado, que confirma que e o mesmo nivel. */
+	aleatorio gerador;
+	/** A parte do tabuleiro que e mostrada. */
+	janela v;
+	/** O HTML, ou `NULL` se a entrada estiver vazia. */
+	char * buf;
+	/** O tamanho do HTML. */
+	size_t n;
+	/** A capacidade de `buf`. */
+	size_t cap;
+} html_camada;
+
+/**
+ * @brief As camadas fixas desta thread, indexadas pela chave do nivel e
+ * pela parte do tabuleiro que e mostrada.
+ */
+static _Thread_local html_camada html_camadas[HTML_CAMADAS];
+
+/**
+ * @brief Se as camadas fixas sao guardadas.
+ */
+static bool html_camadas_ligadas = false;
+
+void html_camadas_activa (void)
+{
+	html_camadas_ligadas = true;
+}
+
+/**
+ * @brief Procura a entrada onde fica a camada fixa de um nivel.
+ * @param nivel A chave do nivel.
+ * @param v A parte do tabuleiro que e mostrada.
+ * @returns A entrada, que pode ter a camada de outro nivel.
+ */
+html_camada * html_camada_procura (uint64_t nivel, const janela * v)
+{
+	uint64_t x = nivel ^ (((uint64_t) v->min.x << 16) | v->min.y);
+	return html_camadas + (splitmix64(&x) % HTML_CAMADAS);
+}
+
+/**
+ * @brief Imprime a camada fixa do nivel, da memoria se ja la estiver.
+ * @param e O estado actual.
+ * @param v A parte do tabuleiro que e mostrada.
  */
-void imprime_porta (const estado_p e)
+void imprime_camada (const estado_p e, const janela * v)
 {
 	assert(e != NULL);
-	IMAGE(e->porta.x, e->porta.y, ESCALA, IMG_PORTA);
+
+	uint64_t nivel = html_nivel(e);
+	html_camada * c = (html_camadas_ligadas) ?
+		html_camada_procura(nivel, v) :
+		NULL;
+
+	if (c != NULL && c->buf != NULL && c->nivel == nivel
+	    && memcmp(&c->gerador, &e->gerador, sizeof(aleatorio)) == 0
+	    && posicao_igual(c->v.min, v->min) && posicao_igual(c->v.max, v->max)) {
+		saida_escreve(c->buf, c->n);
+		goto out;
+	}
+
+	size_t pos = saida_posicao();
+
+	COMMENT("tabuleiro");
+	imprime_tabuleiro(nivel, v);
+
+	COMMENT("porta");
+	imprime_porta(e, v);
+
+	COMMENT("obstaculos");
+	imprime_obstaculos(e, v);
+
+	ifjmp(c == NULL, out);
+
+	size_t n = 0;
+	const char * buf = saida_desde(pos, &n);
+	if (n > c->cap) {
+		c->buf = realloc(c->buf, n);
+		check(c->buf == NULL, "could not allocate board layer");
+		c->cap = n;
+	}
+
+	memcpy(c->buf, buf, n);
+	c->n = n;
+	c->nivel = nivel;
+	c->gerador = e->gerador;
+	c->v = *v;
+
+out:
+	return;
 }
 
 /**
@@ -171,8 +357,10 @@ void imprime_menu (const estado_p e)
 
 	assert(e != NULL);
 
+	char link[JOGADA_LINK_MAX_BUFFER];
+
 	COMMENT("RESET"); {
-#define link_reset accao2str(accao_new(e->nome, ACCAO_RESET, posicao_new(0, 0), posicao_new(0,0)))
+#define link_reset accao_link(accao_new(e->nome, ACCAO_RESET, posicao_new(0, 0), posicao_new(0,0)), link)
 		botao("Reset", 1, link_reset);
 #undef link_reset
 	}
@@ -182,7 +370,7 @@ void imprime_menu (const estado_p e)
 		enum mov_type mt = mov_type_next(e->mov_type);
 
 #define link_mt(MT) \
-		accao2str(accao_new(e->nome, ACCAO_CHANGE_MT, e->jog.pos, posicao_new(MT, 0)))
+		accao_link(accao_new(e->nome, ACCAO_CHANGE_MT, e->jog.pos, posicao_new(MT, 0)), link)
 		botao("Movement Type", 2, link_mt(mt));
 #undef link_mt
 	}
@@ -195,67 +383,91 @@ void imprime_menu (const estado_p e)
  */
 void game_over (const estado_p e)
 {
-	printf(
-		"<TEXT Y=20 X=20 TEXT-ANCHOR=\"midle\" TEXT-ALIGN=\"center\""
-		"FONT-FAMILY=\"serif\" FONT-WEIGHT=\"bold\">"
-		"Game Over! Login as a new user or restart!\n O score do %s foi %hhu."
-		"</TEXT>", e->nome,e->score
-	      );
+	SAIDA_LITERAL(
+		"<text y=20 x=20>"
+		"Game Over! Login as a new user or restart!\n O score do ");
+	saida_str(e->nome);
+	SAIDA_LITERAL(" foi ");
+	saida_num(e->score);
+	SAIDA_LITERAL(".</text>");
+}
+
+void imprime_defs (void)
+{
+#ifdef HTML_IMAGENS_EMBUTIDAS
+	SAIDA_LITERAL(DEFS_FORMAS);
+	DEF_IMAGEM_EMBUTIDA(DEF_OBSTACULO, IMAGEM_OBSTACULO);
+	DEF_IMAGEM_EMBUTIDA(DEF_INIMIGO, IMAGEM_INIMIGO);
+	DEF_IMAGEM_EMBUTIDA(DEF_JOGADOR, IMAGEM_JOGADOR);
+	DEF_IMAGEM_EMBUTIDA(DEF_PORTA, IMAGEM_PORTA);
+	SAIDA_LITERAL("</defs>\n");
+#else
+	SAIDA_LITERAL(DEFS);
+#endif
 }
 
 void imprime_jogo (const estado_p e)
 {
 	assert(e != NULL);
 
+	/* num tabuleiro grande so se mostra a parte a volta do jogador */
+	janela v = janela_em_volta(e, e->jog.pos, VISTA);
+
 	ABRE_BODY(random_color()); {
 		ABRE_SVG(SVG_WIDTH, SVG_HEIGHT); {
 			if (fim_de_jogo(e)) {
 				COMMENT("GAME OVER");
 				game_over(e);
 			} else {
-				COMMENT("tabuleiro");
-				imprime_tabuleiro(TAM, TAM);
-
-				COMMENT("porta");
-				imprime_porta(e);
-
-				COMMENT("obstaculos");
-				imprime_obstaculos(e);
+				ABRE_TABULEIRO(ESCALA); {
+					imprime_camada(e, &v);
 
-				COMMENT("inimigos");
-				imprime_inimigos(e);
+					COMMENT("inimigos");
+					imprime_inimigos(e, &v);
 
-				COMMENT("jogadas");
-				imprime_jogadas(e);
+					COMMENT("jogadas");
+					imprime_jogadas(e, &v);
+				} FECHA_TABULEIRO;
 			}
 
 			COMMENT("menu");
 			imprime_menu(e);
 
-			printf(
-				"<TEXT Y=160 X=460 TEXT-ANCHOR=\"midle\" TEXT-ALIGN=\"center\""
-				"FONT-FAMILY=\"serif\" FONT-WEIGHT=\"bold\">"
-				"vida: %hhu, score %hhu"
-				"</TEXT>", e->jog.vida, e->score
-			      );
-
-
-			puts("<table><tr><th>ID</th><th>Posicao</th><th>Vida</th></tr>");
-
-			for (size_t i = 0; i < e->num_inimigos; i++)
-				printf(
-					"<tr>"
-					"<td>%lu</td>"
-					"<td>(%hhu, %hhu)</td>"
-					"<td>%hhu</td>"
-					"</tr>\n",
-					i,
-					e->inimigo[i].pos.x,
-					e->inimigo[i].pos.y,
-					e->inimigo[i].vida
-				      );
-
-			puts("</table>");
+			SAIDA_LITERAL(
+				"<text y=160 x=460>"
+				"vida: ");
+			saida_num(e->jog.vida);
+			SAIDA_LITERAL(", score ");
+			saida_num(e->score);
+			SAIDA_LITERAL(", (");
+			saida_num(e->jog.pos.x);
+			SAIDA_LITERAL(", ");
+			saida_num(e->jog.pos.y);
+			SAIDA_LITERAL(") de ");
+			saida_num(e->tam.x);
+			saida_char('x');
+			saida_num(e->tam.y);
+			SAIDA_LITERAL("</text>\n");
+
+			SAIDA_LITERAL("<table><tr><th>ID</th><th>Posicao</th><th>Vida</th></tr>\n");
+
+			static _Thread_local size_t ind[VISTA * VISTA];
+			size_t n = entidades_recolhe(e->inimigo, &e->grelha_inimigos, v.min, v.max, ind);
+
+			for (size_t i = 0; i < n; i++) {
+				const entidade * inimigo = e->inimigo + ind[i];
+				SAIDA_LITERAL("<tr><td>");
+				saida_num(ind[i]);
+				SAIDA_LITERAL("</td><td>(");
+				saida_num(inimigo->pos.x);
+				SAIDA_LITERAL(", ");
+				saida_num(inimigo->pos.y);
+				SAIDA_LITERAL(")</td><td>");
+				saida_num(inimigo->vida);
+				SAIDA_LITERAL("</td></tr>\n");
+			}
+
+			SAIDA_LITERAL("</table>\n");
 		} FECHA_SVG;
 	} FECHA_BODY;
 }
@@ -0,0 +1,515 @@
+/** @file */
+#define _GNU_SOURCE /* `accept4()`, `strcasestr()` */
+#include "check.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "html.h"
+#include "saida.h"
+
+#include "http.h"
+
+/**
+ * @brief Uma imagem servida pelo servidor.
+ */
+typedef struct {
+	/** O caminho no URL. */
+	const char * caminho;
+	/** O conteudo do ficheiro. */
+	char * dados;
+	/** O tamanho do ficheiro. */
+	size_t tam;
+} http_imagem;
+
+/**
+ * @brief As imagens do jogo, carregadas em memoria no arranque.
+ */
+http_imagem http_imagens[] = {
+	{ IMG_OBSTACULO, NULL, 0 },
+	{ IMG_INIMIGO,   NULL, 0 },
+	{ IMG_JOGADOR,   NULL, 0 },
+	{ IMG_PORTA,     NULL, 0 },
+};
+
+/**
+ * @brief Numero de imagens do jogo.
+ */
+#define HTTP_NUM_IMAGENS	(sizeof(http_imagens) / sizeof(*http_imagens))
+
+/**
+ * @brief Uma ligacao HTTP.
+ */
+typedef struct {
+	/** O descritor do socket. */
+	int fd;
+	/** Bytes recebidos e ainda nao tratados. */
+	char in[HTTP_IN_MAX];
+	/** Numero de bytes em `in`. */
+	size_t num_in;
+	/** Bytes a enviar. */
+	char * out;
+	/** Numero de bytes em `out`. */
+	size_t num_out;
+	/** Numero de bytes de `out` ja enviados. */
+	size_t enviados;
+	/** Capacidade de `out`. */
+	size_t cap_out;
+	/** Se a ligacao deve ser fechada depois de enviar `out`. */
+	bool fechar;
+} http_conexao;
+
+/**
+ * @brief Um pedido HTTP ja lido.
+ */
+typedef struct {
+	/** O metodo. */
+	const char * metodo;
+	/** O caminho, sem a query. */
+	const char * caminho;
+	/** A query, sem o `?`. */
+	const char * qs;
+	/** Se e um pedido `HEAD`. */
+	bool head;
+	/** Se a ligacao fica aberta depois da resposta. */
+	bool keep_alive;
+	/** A codificacao da resposta, do `Accept-Encoding`. */
+	enum saida_codificacao codificacao;
+	/** O `If-None-Match`, ou `NULL`. */
+	const char * condicao;
+	/** O tamanho de `condicao`. */
+	size_t num_condicao;
+} http_pedido;
+
+/**
+ * @brief Carrega as imagens do jogo.
+ * @param pasta A pasta das imagens.
+ */
+void http_carrega_imagens (const char * pasta)
+{
+	assert(pasta != NULL);
+
+	for (size_t i = 0; i < HTTP_NUM_IMAGENS; i++) {
+		http_imagem * img = http_imagens + i;
+		const char * nome = img->caminho + strlen(IMAGE_PATH);
+
+		char path[256] = "";
+		snprintf(path, sizeof(path), "%s/%s", pasta, nome);
+
+		FILE * f = fopen(path, "rb");
+		if (f == NULL) {
+			perror(path);
+			continue;
+		}
+
+		fseek(f, 0, SEEK_END);
+		long tam = ftell(f);
+		rewind(f);
+
+		img->dados = malloc(tam);
+		check(img->dados == NULL, "could not allocate image");
+		img->tam = fread(img->dados, 1, tam, f);
+
+		fclose(f);
+	}
+}
+
+/**
+ * @brief Acrescenta bytes ao buffer de saida de uma ligacao.
+ * @param c A ligacao.
+ * @param buf Os bytes.
+ * @param n O numero de bytes.
+ */
+void http_acrescenta (http_conexao * c, const void * buf, size_t n)
+{
+	assert(c != NULL);
+
+	if (c->num_out + n > c->cap_out) {
+		c->cap_out = (c->num_out + n) << 1;
+		c->out = realloc(c->out, c->cap_out);
+		check(c->out == NULL, "could not allocate HTTP output");
+	}
+
+	memcpy(c->out + c->num_out, buf, n);
+	c->num_out += n;
+}
+
+/**
+ * @brief Acrescenta uma resposta completa ao buffer de saida de uma ligacao.
+ * @param c A ligacao.
+ * @param p O pedido.
+ * @param status A linha de estado, sem o `HTTP/1.1`.
+ * @param cabecalhos Cabecalhos extra, cada um terminado em `\r\n`.
+ * @param corpo O corpo da resposta.
+ * @param n O tamanho do corpo.
+ */
+void http_responde (http_conexao * c, const http_pedido * p, const char * status,
+		const char * cabecalhos, const char * corpo, size_t n)
+{
+	/* um `304 Not Modified` nunca tem corpo, nem o tamanho dele */
+	bool sem_corpo = strncmp(status, "304", 3) == 0;
+
+	char cab[512] = "";
+	char tam[48] = "";
+	if (!sem_corpo)
+		snprintf(tam, sizeof(tam), "Content-Length: %zu\r\n", n);
+
+	int len = snprintf(cab, sizeof(cab),
+			"HTTP/1.1 %s\r\n"
+			"%s"
+			"%s"
+			"Connection: %s\r\n"
+			"\r\n",
+			status,
+			cabecalhos,
+			tam,
+			(p->keep_alive) ? "keep-alive" : "close"
+			);
+	assert(len > 0 && (size_t) len < sizeof(cab));
+
+	http_acrescenta(c, cab, len);
+	if (!p->head && !sem_corpo)
+		http_acrescenta(c, corpo, n);
+
+	c->fechar |= !p->keep_alive;
+}
+
+/**
+ * @brief Responde a um pedido ao jogo.
+ * @param c A ligacao.
+ * @param p O pedido.
+ * @param handler A funcao que responde ao pedido.
+ */
+void http_responde_jogo (http_conexao * c, const http_pedido * p, fcgi_handler handler)
+{
+	char * buf = NULL;
+	saida_inicio(CONTENT_TYPE);
+	saida_condicao(p->condicao, p->num_condicao);
+	handler(p->qs);
+	size_t n = saida_fim(p->codificacao, &buf);
+
+	bool nao_modificada = saida_nao_modificada();
+	const char * etag = saida_etag();
+	char cab[256] = "";
+	size_t len = 0;
+
+	if (!nao_modificada)
+		len += snprintf(cab + len, sizeof(cab) - len, "Content-Type: %s\r\n", saida_tipo());
+	if (!nao_modificada && p->codificacao != SAIDA_IDENTIDADE)
+		len += snprintf(cab + len, sizeof(cab) - len, "Content-Encoding: %s\r\n",
+				saida_codificacoes()[p->codificacao]);
+	if (etag != NULL)
+		len += snprintf(cab + len, sizeof(cab) - len, "ETag: %s\r\nCache-Control: no-cache\r\n", etag);
+	snprintf(cab + len, sizeof(cab) - len, "Vary: Accept-Encoding\r\n");
+
+	http_responde(c, p, (nao_modificada) ? "304 Not Modified" : "200 OK", cab, buf, n);
+}
+
+/**
+ * @brief Responde a um pedido de uma imagem.
+ * @param c A ligacao.
+ * @param p O pedido.
+ * @returns Verdadeiro se o caminho for uma imagem conhecida, falso caso contrario.
+ */
+bool http_responde_imagem (http_conexao * c, const http_pedido * p)
+{
+	for (size_t i = 0; i < HTTP_NUM_IMAGENS; i++) {
+		const http_imagem * img = http_imagens + i;
+		if (img->dados == NULL || strcmp(p->caminho, img->caminho) != 0)
+			continue;
+		http_responde(c, p, "200 OK",
+				"Content-Type: image/png\r\n"
+				"Cache-Control: max-age=86400\r\n",
+				img->dados, img->tam);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Le o pedido no inicio do buffer de entrada.
+ * @param c A ligacao.
+ * @param p Onde guardar o pedido.
+ * @returns O tamanho do pedido, 0 se ainda estiver incompleto ou -1 se for invalido.
+ */
+ssize_t http_le_pedido (http_conexao * c, http_pedido * p)
+{
+	char * fim = NULL;
+	for (size_t i = 3; i < c->num_in && fim == NULL; i++)
+		if (memcmp(c->in + i - 3, "\r\n\r\n", 4) == 0)
+			fim = c->in + i + 1;
+
+	if (fim == NULL)
+		return (c->num_in < HTTP_IN_MAX) ? 0 : -1;
+
+	/* o ultimo `\r\n` passa a terminar a string */
+	fim[-2] = '\0';
+
+	/* linha do pedido: METODO CAMINHO VERSAO */
+	char * l = c->in;
+	char * eol = strstr(l, "\r\n");
+	*eol = '\0';
+
+	char * metodo = strtok(l, " ");
+	char * uri = strtok(NULL, " ");
+	char * versao = strtok(NULL, " ");
+	ifjmp(metodo == NULL || uri == NULL || versao == NULL, err);
+	ifjmp(strncmp(versao, "HTTP/1.", 7) != 0, err);
+
+	*p = (http_pedido) {
+		.metodo = metodo,
+		.caminho = uri,
+		.qs = "",
+		.head = strcmp(metodo, "HEAD") == 0,
+		.keep_alive = strcmp(versao, "HTTP/1.0") != 0,
+		.codificacao = SAIDA_IDENTIDADE,
+		.condicao = NULL,
+		.num_condicao = 0,
+	};
+
+	char * q = strchr(uri, '?');
+	if (q != NULL) {
+		*q = '\0';
+		p->qs = q + 1;
+	}
+
+	/* so interessam os cabecalhos `Connection`, `Accept-Encoding` e `If-None-Match` */
+	for (l = eol + 2; *l != '\0'; l = eol + 2) {
+		eol = strstr(l, "\r\n");
+		*eol = '\0';
+		if (strncasecmp(l, "Accept-Encoding:", 16) == 0)
+			p->codificacao = saida_codificacao_aceite(l + 16, eol - (l + 16));
+		if (strncasecmp(l, "If-None-Match:", 14) == 0) {
+			p->condicao = l + 14;
+			p->num_condicao = eol - (l + 14);
+		}
+		if (strncasecmp(l, "Connection:", 11) != 0)
+			continue;
+		if (strcasestr(l + 11, "close") != NULL)
+			p->keep_alive = false;
+		else if (strcasestr(l + 11, "keep-alive") != NULL)
+			p->keep_alive = true;
+	}
+
+	return fim - c->in;
+err:
+	return -1;
+}
+
+/**
+ * @brief Trata todos os pedidos completos no buffer de entrada de uma ligacao.
+ * @param c A ligacao.
+ * @param handler A funcao que responde aos pedidos ao jogo.
+ */
+void http_trata_pedidos (http_conexao * c, fcgi_handler handler)
+{
+	static const http_pedido erro = {
+		.head = false,
+		.keep_alive = false,
+	};
+
+	while (!c->fechar) {
+		http_pedido p;
+		ssize_t n = http_le_pedido(c, &p);
+
+		ifjmp(n == 0, out);
+
+		if (n < 0) {
+			http_responde(c, &erro, "400 Bad Request", "", "", 0);
+			goto out;
+		}
+
+		if (strcmp(p.metodo, "GET") != 0 && !p.head)
+			http_responde(c, &p, "405 Method Not Allowed", "Allow: GET, HEAD\r\n", "", 0);
+		else if (strcmp(p.caminho, "/") == 0 || strcmp(p.caminho, "/cgi-bin/rogue") == 0)
+			http_responde_jogo(c, &p, handler);
+		else if (!http_responde_imagem(c, &p))
+			http_responde(c, &p, "404 Not Found", "", "", 0);
+
+		c->num_in -= n;
+		memmove(c->in, c->in + n, c->num_in);
+	}
+
+out:
+	return;
+}
+
+/**
+ * @brief Envia o que for possivel do buffer de saida de uma ligacao.
+ * @param c A ligacao.
+ * @returns Falso se ocorreu um erro, verdadeiro caso contrario.
+ */
+bool http_envia (http_conexao * c)
+{
+	while (c->enviados < c->num_out) {
+		ssize_t w = send(c->fd, c->out + c->enviados, c->num_out - c->enviados, MSG_NOSIGNAL);
+		if (w < 0 && errno == EINTR)
+			continue;
+		if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		ifjmp(w <= 0, err);
+		c->enviados += w;
+	}
+
+	if (c->enviados == c->num_out)
+		c->enviados = c->num_out = 0;
+
+	return true;
+err:
+	return false;
+}
+
+/**
+ * @brief Fecha uma ligacao e liberta a memoria associada.
+ * @param c A ligacao.
+ */
+void http_fecha (http_conexao * c)
+{
+	close(c->fd);
+	free(c->out);
+	free(c);
+}
+
+/**
+ * @brief Trata os eventos de uma ligacao.
+ * @param ep O descritor do epoll.
+ * @param c A ligacao.
+ * @param ev Os eventos.
+ * @param handler A funcao que responde aos pedidos ao jogo.
+ */
+void http_evento (int ep, http_conexao * c, unsigned ev, fcgi_handler handler)
+{
+	ifjmp(ev & (EPOLLERR | EPOLLHUP), fecha);
+
+	if (ev & EPOLLIN) {
+		for (;;) {
+			ssize_t r = read(c->fd, c->in + c->num_in, HTTP_IN_MAX - c->num_in);
+			if (r < 0 && errno == EINTR)
+				continue;
+			if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				break;
+			ifjmp(r <= 0, fecha);
+			c->num_in += r;
+			http_trata_pedidos(c, handler);
+			if (c->fechar || c->num_in == HTTP_IN_MAX)
+				break;
+		}
+	}
+
+	ifjmp(!http_envia(c), fecha);
+	ifjmp(c->fechar && c->num_out == 0, fecha);
+
+	/* so espera por `EPOLLOUT` enquanto houver bytes por enviar */
+	struct epoll_event e = {
+		.events = EPOLLIN | ((c->num_out > 0) ? EPOLLOUT : 0),
+		.data.ptr = c,
+	};
+	epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &e);
+
+	return;
+fecha:
+	epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+	http_fecha(c);
+}
+
+/**
+ * @brief Aceita todas as ligacoes pendentes.
+ * @param ep O descritor do epoll.
+ * @param sfd O socket a escuta.
+ */
+void http_aceita (int ep, int sfd)
+{
+	for (;;) {
+		int fd = accept4(sfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0 && errno == EINTR)
+			continue;
+		ifjmp(fd < 0, out);
+
+		int um = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &um, sizeof(um));
+
+		http_conexao * c = malloc(sizeof(http_conexao));
+		check(c == NULL, "could not allocate HTTP connection");
+		c->fd = fd;
+		c->num_in = 0;
+		c->out = NULL;
+		c->num_out = c->enviados = c->cap_out = 0;
+		c->fechar = false;
+
+		struct epoll_event e = {
+			.events = EPOLLIN,
+			.data.ptr = c,
+		};
+		if (epoll_ctl(ep, EPOLL_CTL_ADD, fd, &e) < 0)
+			http_fecha(c);
+	}
+
+out:
+	return;
+}
+
+int http_serve (unsigned short porta, const char * imagens, fcgi_handler handler)
+{
+	assert(imagens != NULL);
+	assert(handler != NULL);
+
+	http_carrega_imagens(imagens);
+
+	int sfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	check(sfd < 0, "could not create HTTP socket");
+
+	int um = 1;
+	setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &um, sizeof(um));
+
+	struct sockaddr_in sa = {
+		.sin_family = AF_INET,
+		.sin_port = htons(porta),
+		.sin_addr.s_addr = htonl(INADDR_ANY),
+	};
+
+	check(bind(sfd, (struct sockaddr *) &sa, sizeof(sa)) < 0, "could not bind HTTP socket");
+	check(listen(sfd, SOMAXCONN) < 0, "could not listen on HTTP socket");
+
+	int ep = epoll_create1(EPOLL_CLOEXEC);
+	check(ep < 0, "could not create epoll");
+
+	/* o socket a escuta e o unico com `data.ptr == NULL` */
+	struct epoll_event e = {
+		.events = EPOLLIN,
+		.data.ptr = NULL,
+	};
+	check(epoll_ctl(ep, EPOLL_CTL_ADD, sfd, &e) < 0, "could not watch HTTP socket");
+
+	signal(SIGPIPE, SIG_IGN);
+
+	for (;;) {
+		struct epoll_event evs[HTTP_EVENTOS];
+		int n = epoll_wait(ep, evs, HTTP_EVENTOS, -1);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		ifjmp(n < 0, err);
+
+		for (int i = 0; i < n; i++) {
+			if (evs[i].data.ptr == NULL)
+				http_aceita(ep, sfd);
+			else
+				http_evento(ep, evs[i].data.ptr, evs[i].events, handler);
+		}
+	}
+
+err:
+	perror("could not wait for HTTP events");
+	return EXIT_FAILURE;
+}
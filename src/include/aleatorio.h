@@ -0,0 +1,54 @@
+/** @file */
+#ifndef _ALEATORIO_H
+#define _ALEATORIO_H
+
+#include <stdint.h>
+
+/**
+ * @brief O estado de um gerador de numeros pseudo-aleatorios (xoshiro256**).
+ *
+ * Cada jogo tem o seu gerador, guardado no estado do jogo: o mesmo gerador
+ * gera sempre o mesmo nivel, e geradores diferentes nao partilham nada.
+ */
+typedef struct {
+	/** Os 256 bits do estado, nunca todos a 0. */
+	uint64_t s[4];
+} aleatorio;
+
+/**
+ * @brief Gera o proximo numero de um splitmix64, que serve para semear e
+ * para misturar os bits de um numero.
+ * @param x O estado do splitmix64.
+ * @returns O numero.
+ */
+uint64_t splitmix64 (uint64_t * x);
+
+/**
+ * @brief Inicializa um gerador a partir de uma semente.
+ * @param a O gerador.
+ * @param semente A semente; qualquer valor, incluindo 0.
+ */
+void aleatorio_semeia (aleatorio * a, uint64_t semente);
+
+/**
+ * @brief Calcula uma semente nova, diferente em cada chamada.
+ * @returns A semente.
+ */
+uint64_t aleatorio_semente (void);
+
+/**
+ * @brief Gera o proximo numero de um gerador.
+ * @param a O gerador.
+ * @returns Um numero de 64 bits.
+ */
+uint64_t aleatorio_proximo (aleatorio * a);
+
+/**
+ * @brief Gera um numero entre 0 (inclusive) e `n` (exclusive).
+ * @param a O gerador.
+ * @param n O limite, entre 1 e `UINT32_MAX`.
+ * @returns O numero.
+ */
+uint32_t aleatorio_ate (aleatorio * a, uint32_t n);
+
+#endif /* _ALEATORIO_H */
@@ -0,0 +1,174 @@
+/** @file */
+/**
+ * O estado do jogo e as jogadas possiveis num formato para clientes e bots,
+ * em vez da pagina HTML: pede-se acrescentando `&api=json` ou `&api=bin`
+ * ao link de uma jogada ou ao `nome=` do login.
+ *
+ * As accoes sao os mesmos links da pagina: `NOME,ACCAO,JX,JY,DX,DY`, com a
+ * accao em 8 digitos hexadecimais e as posicoes em 4. O JSON traz o link de
+ * cada jogada; no formato binario o cliente escreve-o a partir do destino.
+ *
+ * Com `&turno=N`, em que `N` e o turno da ultima resposta que o cliente
+ * recebeu, a resposta so traz o que mudou desde esse turno: os inimigos que
+ * se moveram ou perderam vida, os que morreram e as jogadas novas. Se o
+ * cliente estiver atrasado ou o nivel tiver mudado vem o estado inteiro.
+ */
+#ifndef _API_H
+#define _API_H
+
+#include <stdint.h>
+
+#include "posicao.h"
+#include "estado.h"
+
+/**
+ * @brief Identificacao de uma resposta no formato binario.
+ */
+#define API_MAGIC	"ROGA"
+
+/**
+ * @brief Versao do formato binario.
+ */
+#define API_VERSAO	2
+
+/**
+ * @brief Os formatos de resposta.
+ */
+enum api_formato {
+	/** A pagina HTML. */
+	API_HTML,
+	/** JSON compacto. */
+	API_JSON,
+	/** O formato binario, descrito por `api_cabecalho`. */
+	API_BINARIO,
+	/** Numero de formatos diferentes. */
+	API_FORMATOS_QUANTOS,
+};
+
+/**
+ * @brief Um formato de resposta.
+ */
+typedef struct {
+	/** O valor de `api=` na `QUERY_STRING`. */
+	const char * nome;
+	/** O `Content-Type` da resposta. */
+	const char * tipo;
+	/** A funcao que escreve o estado na saida. */
+	void (* imprime) (const estado_p e);
+	/** A funcao que escreve na saida o que mudou desde outro estado, ou `NULL`. */
+	void (* imprime_delta) (const estado_p e, const estado_p antes);
+} api_formato_s;
+
+/**
+ * @brief O cabecalho de uma resposta no formato binario.
+ *
+ * Todos os campos estao na ordem de bytes da maquina e alinhados, sem
+ * padding. A seguir vem `num_inimigos` `api_inimigo`, `num_obstaculos`
+ * `posicao_s`, `num_removidos` ids (`uint32_t`) dos inimigos que morreram
+ * e `num_jogadas` `posicao_s`, os destinos das jogadas. Numa resposta
+ * `delta` so vem os inimigos que mudaram e nenhum obstaculo.
+ */
+typedef struct {
+	/** `API_MAGIC`, sem o `'\0'`. */
+	char magic[4];
+	/** `API_VERSAO`. */
+	uint8_t versao;
+	/** O nivel actual. */
+	uint8_t nivel;
+	/** O tipo de movimento actual. */
+	uint8_t mov_type;
+	/** 1 se o jogo tiver acabado, 0 caso contrario. */
+	uint8_t fim;
+	/** As dimensoes do tabuleiro. */
+	posicao_s tam;
+	/** A posicao do jogador. */
+	posicao_s jog;
+	/** A porta de saida do nivel. */
+	posicao_s porta;
+	/** A vida do jogador. */
+	uint8_t vida;
+	/** 1 se a resposta so tiver o que mudou, 0 se tiver o estado inteiro. */
+	uint8_t delta;
+	/** Sempre 0. */
+	uint8_t reservado[2];
+	/** O turno do estado. */
+	uint32_t turno;
+	/** O score actual. */
+	uint32_t score;
+	/** O numero de inimigos na resposta. */
+	uint32_t num_inimigos;
+	/** O numero de obstaculos na resposta. */
+	uint32_t num_obstaculos;
+	/** O numero de inimigos que morreram. */
+	uint32_t num_removidos;
+	/** O numero de jogadas possiveis. */
+	uint32_t num_jogadas;
+} api_cabecalho;
+
+/**
+ * @brief Um inimigo no formato binario.
+ */
+typedef struct {
+	/** O id do inimigo, que nao muda durante o nivel. */
+	uint32_t id;
+	/** A posicao do inimigo. */
+	posicao_s pos;
+	/** A vida do inimigo. */
+	uint8_t vida;
+	/** Sempre 0. */
+	uint8_t reservado[3];
+} api_inimigo;
+
+/**
+ * @brief Devolve os formatos de resposta.
+ * @returns Um array com `API_FORMATOS_QUANTOS` formatos.
+ */
+const api_formato_s * api_formatos (void);
+
+/**
+ * @brief Escreve o estado e as jogadas possiveis na saida, em JSON.
+ *
+ * Um objecto com `turno`, `delta` (falso), `nome`, `nivel`, `mov_type`,
+ * `tam` (`[x,y]`), `score`, `fim`, `jogador` (`[x,y,vida]`), `porta`
+ * (`[x,y]`), `inimigos` (`[[id,x,y,vida],...]`), `obstaculos`
+ * (`[[x,y],...]`) e `jogadas` (`[[x,y,link],...]`).
+ * @param e O estado.
+ */
+void api_imprime_json (const estado_p e);
+
+/**
+ * @brief Escreve na saida, em JSON, o que mudou desde um estado do mesmo nivel.
+ *
+ * Um objecto com `turno`, `delta` (verdadeiro), `mov_type`, `score`, `fim`,
+ * `jogador`, `inimigos`, so os que mudaram, `removidos` (os ids dos que
+ * morreram) e `jogadas`.
+ * @param e O estado.
+ * @param antes O estado que o cliente ja tem.
+ */
+void api_imprime_json_delta (const estado_p e, const estado_p antes);
+
+/**
+ * @brief Escreve o estado e as jogadas possiveis na saida, no formato binario.
+ * @param e O estado.
+ */
+void api_imprime_binario (const estado_p e);
+
+/**
+ * @brief Escreve na saida, no formato binario, o que mudou desde um estado do mesmo nivel.
+ * @param e O estado.
+ * @param antes O estado que o cliente ja tem.
+ */
+void api_imprime_binario_delta (const estado_p e, const estado_p antes);
+
+/**
+ * @brief Verifica se dois estados estao no mesmo nivel do mesmo jogo.
+ *
+ * Os obstaculos e a porta nao mudam durante um nivel, logo um nivel novo
+ * ou um jogo novo tem outros.
+ * @param a Um estado.
+ * @param b O outro estado.
+ * @returns Verdadeiro se estiverem, falso caso contrario.
+ */
+bool api_mesmo_nivel (const estado_p a, const estado_p b);
+
+#endif /* _API_H */
@@ -0,0 +1,137 @@
+/** @file */
+#ifndef _ARMAZEM_H
+#define _ARMAZEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "estado.h"
+
+/**
+ * @brief Pasta, por omissao, para guardar os ficheiros de estado dos jogadores.
+ *
+ * Pode ser mudada com a variavel de ambiente `ROGUE_BASE_PATH`.
+ */
+#define BASE_PATH	"/var/www/html/files/"
+
+/**
+ * @brief Tipo de armazenamento dos estados.
+ *
+ * Escolhido com a variavel de ambiente `ROGUE_ARMAZEM` (`ficheiros` ou `slab`).
+ */
+enum armazem_tipo {
+	/** Um ficheiro por jogador, em `BASE_PATH`. */
+	ARMAZEM_FICHEIROS,
+	/** Um unico ficheiro mapeado em memoria com os estados de todos os jogadores. */
+	ARMAZEM_SLAB,
+	/** Numero de tipos de armazenamento. */
+	ARMAZEM_QUANTOS,
+};
+
+/**
+ * @brief Intervalo, por omissao, entre group commits, em milissegundos.
+ *
+ * Pode ser mudado com a variavel de ambiente `ROGUE_GRUPO_MS`.
+ */
+#define ARMAZEM_GRUPO_MS	100
+
+/**
+ * @brief Quando e que uma escrita tem de estar no disco.
+ *
+ * Escolhida com a variavel de ambiente `ROGUE_DURABILIDADE` (`nenhuma`,
+ * `fsync` ou `grupo`). Em todos os casos as escritas sao atomicas: quem le (ou
+ * um crash) ve sempre o estado antigo ou o novo, nunca um estado parcial.
+ */
+enum durabilidade {
+	/** O sistema operativo escreve quando quiser. */
+	DURABILIDADE_NENHUMA,
+	/** Cada escrita so retorna depois de estar no disco. */
+	DURABILIDADE_FSYNC,
+	/**
+	 * As escritas sao agrupadas e vao para o disco juntas a cada
+	 * `ROGUE_GRUPO_MS`; uma escrita isolada (sem um processo residente
+	 * para a agrupar) e sincronizada sozinha.
+	 */
+	DURABILIDADE_GRUPO,
+	/** Numero de politicas de durabilidade. */
+	DURABILIDADE_QUANTOS,
+};
+
+/**
+ * @brief Devolve a politica de durabilidade em uso.
+ * @returns A politica de durabilidade.
+ */
+enum durabilidade armazem_durabilidade (void);
+
+/**
+ * @brief Devolve o intervalo entre group commits.
+ * @returns O intervalo, em milissegundos.
+ */
+unsigned armazem_grupo_ms (void);
+
+/**
+ * @brief Escolhe o tipo de armazenamento, ignorando `ROGUE_ARMAZEM`.
+ * @param t O tipo de armazenamento.
+ */
+void armazem_usa (enum armazem_tipo t);
+
+/**
+ * @brief Devolve a pasta dos ficheiros de estado.
+ * @returns A pasta, terminada em `/`.
+ */
+const char * armazem_pasta (void);
+
+/**
+ * @brief Calcula o caminho do ficheiro slab: a pasta dos estados com `.slab` no lugar da `/` final.
+ * @returns O caminho do ficheiro.
+ */
+char * armazem_slab_path (void);
+
+/**
+ * @brief Calcula o caminho de um ficheiro de jogo.
+ * @param name Nome do jogador.
+ * @returns O caminho do ficheiro.
+ */
+char * pathname (const char * name);
+
+/**
+ * @brief Le o estado de um jogador do armazenamento.
+ * @param nome Nome do jogador.
+ * @param e Onde guardar o estado, que tem de ser libertado com `estado_liberta()`.
+ * @returns Verdadeiro se conseguiu ler um estado valido, falso caso contrario.
+ */
+bool armazem_ler (const char * nome, estado_p e);
+
+/**
+ * @brief Escreve o estado de um jogador no armazenamento.
+ *
+ * Excepto com `DURABILIDADE_NENHUMA`, so retorna quando o estado estiver no disco.
+ * @param e O estado a guardar.
+ */
+void armazem_escreve (const estado_p e);
+
+/**
+ * @brief Escreve os estados de varios jogadores no armazenamento.
+ *
+ * Excepto com `DURABILIDADE_NENHUMA`, so retorna quando os estados
+ * estiverem no disco, com uma unica sincronizacao para todos.
+ * @param es Os estados a guardar.
+ * @param n O numero de estados.
+ */
+void armazem_escreve_lote (const estado_s * es, size_t n);
+
+/**
+ * @brief Verifica se um jogador existe no armazenamento.
+ * @param nome Nome do jogador.
+ * @returns Verdadeiro se existir, falso caso contrario.
+ */
+bool armazem_existe (const char * nome);
+
+/**
+ * @brief Importa para o ficheiro slab todos os ficheiros de estado de uma pasta.
+ * @param pasta A pasta com um ficheiro por jogador.
+ * @returns O numero de estados importados.
+ */
+size_t armazem_importa (const char * pasta);
+
+#endif /* _ARMAZEM_H */
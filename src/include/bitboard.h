@@ -0,0 +1,162 @@
+/** @file */
+#ifndef _BITBOARD_H
+#define _BITBOARD_H
+
+#include <stdint.h>
+
+#include "posicao.h"
+
+/**
+ * @brief Um conjunto de casas do tabuleiro, um bit por casa.
+ *
+ * A casa `(x, y)` e o bit `y * largura + x`. Os bits estao em memoria
+ * dinamica, com o tamanho do tabuleiro do jogo.
+ */
+typedef struct {
+	/** Os bits. */
+	uint64_t * w;
+	/** A largura do tabuleiro. */
+	size_t largura;
+} bitboard;
+
+/**
+ * @brief Calcula o numero de palavras de 64 bits de um bitboard.
+ * @param T As dimensoes do tabuleiro.
+ */
+#define BB_PALAVRAS(T)		(((((size_t) (T).x) * (T).y) + 63) >> 6)
+
+/**
+ * @brief Calcula o indice de uma posicao num bitboard.
+ * @param B O bitboard.
+ * @param P A posicao, dentro do tabuleiro.
+ */
+#define BB_INDICE(B, P)		((((size_t) (P).y) * (B).largura) + (P).x)
+
+/**
+ * @brief Calcula a palavra de um bitboard que contem uma posicao.
+ * @param B O bitboard.
+ * @param P A posicao, dentro do tabuleiro.
+ */
+#define BB_PALAVRA(B, P)	((B).w[BB_INDICE(B, P) >> 6])
+
+/**
+ * @brief Calcula a mascara de uma posicao dentro da sua palavra.
+ * @param B O bitboard.
+ * @param P A posicao, dentro do tabuleiro.
+ */
+#define BB_BIT(B, P)		(((uint64_t) 1) << (BB_INDICE(B, P) & 63))
+
+/**
+ * @brief Testa se uma posicao pertence a um bitboard.
+ * @param B O bitboard.
+ * @param P A posicao, dentro do tabuleiro.
+ */
+#define BB_TESTA(B, P)		((BB_PALAVRA(B, P) & BB_BIT(B, P)) != 0)
+
+/**
+ * @brief Acrescenta uma posicao a um bitboard.
+ * @param B O bitboard.
+ * @param P A posicao, dentro do tabuleiro.
+ */
+#define BB_LIGA(B, P)		(BB_PALAVRA(B, P) |= BB_BIT(B, P))
+
+/**
+ * @brief Tira uma posicao de um bitboard.
+ * @param B O bitboard.
+ * @param P A posicao, dentro do tabuleiro.
+ */
+#define BB_DESLIGA(B, P)	(BB_PALAVRA(B, P) &= ~BB_BIT(B, P))
+
+/**
+ * @brief Verifica se um tabuleiro usa as tabelas geradas em tempo de compilacao.
+ *
+ * As tabelas sao para o tabuleiro de `TAM` por `TAM`, onde um `bitboard`
+ * tem as mesmas palavras que um `bitboard_tam`; nos outros as pecas
+ * deslizantes usam `linhas`.
+ * @param T As dimensoes do tabuleiro.
+ */
+#define BB_TEM_TABELAS(T)	((T).x == TAM && (T).y == TAM)
+
+/**
+ * @brief Numero de casas do tabuleiro de `TAM` por `TAM`.
+ */
+#define BB_TAM_CASAS		(TAM * TAM)
+
+/**
+ * @brief Numero de palavras de 64 bits de um `bitboard_tam`.
+ */
+#define BB_TAM_PALAVRAS		((BB_TAM_CASAS + 63) >> 6)
+
+/**
+ * @brief Um conjunto de casas do tabuleiro de `TAM` por `TAM`, com tamanho
+ * fixo, para as tabelas geradas em tempo de compilacao.
+ *
+ * A casa `(x, y)` e o bit `y * TAM + x`, como num `bitboard` desse tabuleiro.
+ */
+typedef struct {
+	/** Os bits. */
+	uint64_t w[BB_TAM_PALAVRAS];
+} bitboard_tam;
+
+/**
+ * @brief Calcula o indice de uma posicao num `bitboard_tam`.
+ * @param P A posicao, dentro do tabuleiro.
+ */
+#define BB_TAM_INDICE(P)	(((size_t) (P).y * TAM) + (P).x)
+
+/**
+ * @brief A abcissa de uma casa do tabuleiro de `TAM` por `TAM`, como `int`.
+ * @param S O indice da casa.
+ */
+#define BB_X(S)			((int) (S) % TAM)
+
+/**
+ * @brief A ordenada de uma casa do tabuleiro de `TAM` por `TAM`, como `int`.
+ * @param S O indice da casa.
+ */
+#define BB_Y(S)			((int) (S) / TAM)
+
+/**
+ * @brief Expressao constante com o bit da casa `(X, Y)` na palavra `W` de um `bitboard_tam`.
+ *
+ * E 0 se a casa estiver fora do tabuleiro ou noutra palavra, por isso serve
+ * para gerar tabelas em tempo de compilacao.
+ * @param W A palavra.
+ * @param X A abcissa, que pode estar fora do tabuleiro.
+ * @param Y A ordenada, que pode estar fora do tabuleiro.
+ */
+#define BB_CASA(W, X, Y)					\
+	((0 <= (X) && (X) < TAM && 0 <= (Y) && (Y) < TAM	\
+	  && ((((Y) * TAM) + (X)) >> 6) == (W)) ?		\
+	 (((uint64_t) 1) << ((((Y) * TAM) + (X)) & 63)) :	\
+	 0)
+
+/**
+ * @brief Aplica `M` a 10 casas seguidas.
+ * @param M A macro a aplicar a cada casa.
+ * @param S O indice da primeira casa.
+ */
+#define BB_10(M, S)							\
+	M((S) + 0), M((S) + 1), M((S) + 2), M((S) + 3), M((S) + 4),	\
+	M((S) + 5), M((S) + 6), M((S) + 7), M((S) + 8), M((S) + 9)
+
+/**
+ * @brief Gera o inicializador de uma tabela com uma entrada por casa.
+ * @param M A macro que calcula a entrada de uma casa.
+ */
+#define BB_TABELA(M)						\
+	BB_10(M, 0),  BB_10(M, 10), BB_10(M, 20), BB_10(M, 30),	\
+	BB_10(M, 40), BB_10(M, 50), BB_10(M, 60), BB_10(M, 70),	\
+	BB_10(M, 80), BB_10(M, 90)
+
+/**
+ * @brief Gera um `bitboard_tam` constante a partir das suas palavras.
+ * @param F A macro que calcula a palavra `W` da casa `S`, chamada como `F(S, W)`.
+ * @param S O indice da casa.
+ */
+#define BB_GERA(F, S)		{ { F(S, 0), F(S, 1) } }
+
+/* `BB_TABELA` e os inicializadores de bitboards estao escritos para 10x10 */
+_Static_assert(BB_TAM_CASAS == 100 && BB_TAM_PALAVRAS == 2, "BB_TABELA assumes a 10x10 board");
+
+#endif /* _BITBOARD_H */
@@ -0,0 +1,140 @@
+/** @file */
+#ifndef _DIARIO_H
+#define _DIARIO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "posicao.h"
+#include "estado.h"
+#include "jogo.h"
+
+/**
+ * @brief Identificacao de um diario.
+ */
+#define DIARIO_MAGIC	"ROGUEDIA"
+
+/**
+ * @brief Versao do formato de um diario.
+ */
+#define DIARIO_VERSAO	1
+
+/**
+ * @brief Tipo de registo de um diario.
+ */
+enum diario_tipo {
+	/** O jogo comecou: os argumentos de `init_estado()`. */
+	DIARIO_INICIO,
+	/** Uma accao executada por `ler_estado()`. */
+	DIARIO_ACCAO,
+	/** Numero de tipos de registo. */
+	DIARIO_QUANTOS,
+};
+
+/**
+ * @brief O cabecalho de um diario.
+ */
+typedef struct {
+	/** `DIARIO_MAGIC`. */
+	char magic[8];
+	/** `DIARIO_VERSAO`. */
+	uint32_t versao;
+} diario_cabecalho;
+
+/**
+ * @brief Um registo `DIARIO_INICIO`, como e guardado.
+ */
+typedef struct {
+	/** `DIARIO_INICIO`. */
+	uint8_t tipo;
+	/** O ultimo nivel completado. */
+	uint8_t nivel;
+	/** O tipo de movimento, ou `MOV_TYPE_QUANTOS` se foi escolhido ao acaso. */
+	uint8_t mov_type;
+	/** Nao usado, para que o registo nao tenha buracos. */
+	uint8_t reservado[5];
+	/** As dimensoes do tabuleiro. */
+	posicao_s tam;
+	/** O score. */
+	uint32_t score;
+	/** A semente do gerador de numeros aleatorios do jogo. */
+	uint64_t semente;
+} diario_inicio;
+
+/**
+ * @brief Um registo `DIARIO_ACCAO`, como e guardado.
+ */
+typedef struct {
+	/** `DIARIO_ACCAO`. */
+	uint8_t tipo;
+	/** O tipo da accao, ou `ACCAO_INVALID`. */
+	uint8_t accao;
+	/** A posicao do jogador antes de executar a accao. */
+	posicao_s jog;
+	/** A posicao de destino da accao. */
+	posicao_s dest;
+} diario_accao;
+
+/**
+ * @brief Calcula o caminho do diario de um jogador.
+ *
+ * Comeca por `.`, logo nao e confundido com um jogador.
+ * @param nome Nome do jogador.
+ * @returns O caminho.
+ */
+char * diario_path (const char * nome);
+
+/**
+ * @brief Comeca o diario de um jogador, apagando o que existir.
+ * @param nome Nome do jogador.
+ * @param tam As dimensoes do tabuleiro.
+ * @param nivel O ultimo nivel completado.
+ * @param score O score.
+ * @param mt O tipo de movimento.
+ * @param semente A semente do gerador de numeros aleatorios do jogo.
+ */
+void diario_inicia (const char * nome, posicao_s tam, uchar nivel, unsigned score, enum mov_type mt, uint64_t semente);
+
+/**
+ * @brief Acrescenta uma accao ao diario do jogador, se ele tiver um.
+ *
+ * Com `DURABILIDADE_FSYNC` so retorna quando a accao estiver no disco.
+ * Depois de `diario_adia()`, e com outra durabilidade, a accao fica em
+ * memoria ate ao proximo `diario_flush()`.
+ * @param accao A accao.
+ */
+void diario_acrescenta (const accao_s * accao);
+
+/**
+ * @brief Passa a guardar as accoes em memoria, para serem escritas por `diario_flush()`.
+ *
+ * Num processo residente as accoes vao para o disco com os estados, pela
+ * cache de sessoes, com um `open()` e um `write()` por jogador em vez de
+ * um por accao. Sem isto, como num pedido CGI, cada accao abre, escreve e
+ * fecha o diario do jogador.
+ */
+void diario_adia (void);
+
+/**
+ * @brief Escreve as accoes guardadas em memoria nos diarios.
+ */
+void diario_flush (void);
+
+/**
+ * @brief Abre o diario de um jogador para ler.
+ * @param nome Nome do jogador.
+ * @returns O diario, ou `NULL` se nao existir ou nao for valido.
+ */
+FILE * diario_abre (const char * nome);
+
+/**
+ * @brief Le o proximo registo de um diario.
+ * @param f O diario.
+ * @param inicio Onde guardar um registo `DIARIO_INICIO`.
+ * @param accao Onde guardar um registo `DIARIO_ACCAO`.
+ * @returns O tipo do registo lido, ou `DIARIO_QUANTOS` no fim ou num registo invalido.
+ */
+enum diario_tipo diario_le (FILE * f, diario_inicio * inicio, diario_accao * accao);
+
+#endif /* _DIARIO_H */
@@ -2,9 +2,10 @@
 #ifndef _ENTIDADES_H
 #define _ENTIDADES_H
 
+#include "bitboard.h"
+#include "grelha.h"
 #include "posicao.h"
 
-
 /**
  * @var typedef entidade * entidades
  * @brief Um apontador para uma entidade.
@@ -19,7 +20,7 @@ typedef struct {
 	/** A vida da entidade */
 	uchar vida;
 	/** O id da entidade */
-	uchar id;
+	uint32_t id;
 } entidade, * entidades;
 
 /**
@@ -40,14 +41,39 @@ bool pos_inimigos (const entidades e, posicao_s p, size_t num_inimigos);
  */
 size_t pos_inimigos_ind (const entidades e, posicao_s p, size_t num_inimigos);
 
+/**
+ * @brief Procura a entidade com uma certa posicao, com a grelha das entidades
+ * @param e As entidades
+ * @param g A grelha das entidades
+ * @param p A posicao a procurar
+ * @param N O numero de entidades
+ * @returns O indice da entidade com a posicao, ou N caso nao exista nenhuma
+ */
+size_t entidade_procura (const entidades e, const grelha * g, posicao_s p, size_t N);
+
+/**
+ * @brief Recolhe as entidades que estao dentro de um rectangulo, com a grelha das entidades
+ * @param e As entidades
+ * @param g A grelha das entidades
+ * @param min O canto superior esquerdo do rectangulo
+ * @param max O canto inferior direito do rectangulo, exclusive
+ * @param dst Onde guardar os indices das entidades, por ordem crescente
+ * @returns O numero de entidades
+ */
+size_t entidades_recolhe (const entidades e, const grelha * g, posicao_s min, posicao_s max, size_t * dst);
+
 /**
  * @brief Remove uma entidade de um array de entidades
+ *
+ * A ultima entidade passa para o lugar da removida, tambem na grelha.
  * @param e As entidades
  * @param i O indice da entidade a remover
  * @param N O numero de entidades
+ * @param bb As casas ocupadas pelas entidades, de onde sai a casa da entidade removida
+ * @param g A grelha das entidades
  * @returns O novo numero de entidades
  */
-uchar entidade_remove (entidades e, size_t i, size_t N);
+size_t entidade_remove (entidades e, size_t i, size_t N, bitboard * bb, grelha * g);
 
 /**
  * @brief Verifica se uma entidade esta morta
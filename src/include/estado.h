@@ -2,30 +2,53 @@
 #ifndef _ESTADO_H
 #define _ESTADO_H
 
+#include <stdint.h>
 #include <stdio.h>
 
+#include "aleatorio.h"
+#include "bitboard.h"
+#include "grelha.h"
+#include "linhas.h"
 #include "posicao.h"
 #include "entidades.h"
 
 /**
  * @brief O numero minimo de inimigos
+ * @param L A largura do tabuleiro
+ * @param A A altura do tabuleiro
  */
-#define MIN_INIMIGOS	(TAM)
+#define MIN_INIMIGOS(L, A)	((size_t) (((L) > (A)) ? (L) : (A)))
 
 /**
  * @brief O numero minimo de obstaculos
+ * @param L A largura do tabuleiro
+ * @param A A altura do tabuleiro
  */
-#define MIN_OBSTACULOS	(MIN_INIMIGOS << 1)
+#define MIN_OBSTACULOS(L, A)	(MIN_INIMIGOS(L, A) << 1)
 
 /**
  * @brief O numero maximo de obstaculos
+ * @param L A largura do tabuleiro
+ * @param A A altura do tabuleiro
  */
-#define MAX_OBSTACULOS	((TAM * TAM) >> 1)
+#define MAX_OBSTACULOS(L, A)	((((size_t) (L)) * (A)) >> 1)
 
 /**
  * @brief O numero maximo de inimigos
+ * @param L A largura do tabuleiro
+ * @param A A altura do tabuleiro
  */
-#define MAX_INIMIGOS	(MAX_OBSTACULOS >> 1)
+#define MAX_INIMIGOS(L, A)	(MAX_OBSTACULOS(L, A) >> 1)
+
+/**
+ * @brief Identificacao de um estado guardado.
+ */
+#define ESTADO_MAGIC	"ROGUEEST"
+
+/**
+ * @brief Versao do formato de um estado guardado.
+ */
+#define ESTADO_VERSAO	3
 
 /**
  * @brief O tipo de movimento
@@ -35,6 +58,16 @@ enum mov_type {
 	MOV_TYPE_XADREZ_REI,
 	/** Tipo de movimento do cavalo de xadrez. */
 	MOV_TYPE_XADREZ_CAVALO,
+	/** Tipo de movimento do peao de xadrez. */
+	MOV_TYPE_XADREZ_PEAO,
+	/** Tipo de movimento da torre de xadrez. */
+	MOV_TYPE_XADREZ_TORRE,
+	/** Tipo de movimento do bispo de xadrez. */
+	MOV_TYPE_XADREZ_BISPO,
+	/** Tipo de movimento da rainha de xadrez. */
+	MOV_TYPE_XADREZ_RAINHA,
+	/** Tipo de movimento das damas. */
+	MOV_TYPE_DAMAS,
 	/** Numero de tipos de movimentos diferentes. */
 	MOV_TYPE_QUANTOS,
 };
@@ -46,6 +79,128 @@ enum mov_type {
 
 /**
  * @brief O estado do jogo
+ *
+ * As entidades, os bitboards, as grelhas e as linhas estao em memoria
+ * dinamica: um estado criado por `init_estado()`, `estado_copia()` ou
+ * `estado_desserializa()` tem de ser libertado com `estado_liberta()`.
+ * Copiar um `estado_s` por valor partilha essa memoria.
+ */
+typedef struct {
+	/** O nome do jogador */
+	char nome[11];
+	/** O nivel actual */
+	uchar nivel;
+	/** Flag que indica se o ultimo ataque do jogador matou */
+	bool matou;
+	/** O tipo de movimento actual */
+	enum mov_type mov_type;
+	/** As dimensoes do tabuleiro */
+	posicao_s tam;
+	/** O score actual */
+	unsigned score;
+	/** O numero de inimigos vivos */
+	size_t num_inimigos;
+	/** O numero de obstaculos */
+	size_t num_obstaculos;
+	/** O jogador */
+	entidade jog;
+	/** A porta de saida do nivel */
+	posicao_s porta;
+	/** Os inimigos */
+	entidades inimigo;
+	/** Os obstaculos */
+	entidades obstaculo;
+	/** A casa ocupada pelo jogador */
+	bitboard bb_jogador;
+	/** As casas ocupadas por inimigos */
+	bitboard bb_inimigos;
+	/** As casas ocupadas por obstaculos */
+	bitboard bb_obstaculos;
+	/** Os inimigos, indexados pela posicao */
+	grelha grelha_inimigos;
+	/** Os obstaculos, indexados pela posicao */
+	grelha grelha_obstaculos;
+	/** As casas ocupadas por inimigos, por colunas e diagonais, se nao `BB_TEM_TABELAS(tam)` */
+	linhas linhas_inimigos;
+	/** As casas ocupadas por obstaculos, por colunas e diagonais, se nao `BB_TEM_TABELAS(tam)` */
+	linhas linhas_obstaculos;
+	/** O gerador de numeros aleatorios do jogo */
+	aleatorio gerador;
+	/** O numero de jogadas desde o inicio do jogo, contando com as dos niveis anteriores */
+	uint32_t turno;
+} estado_s, * estado_p;
+
+/**
+ * @brief O cabecalho de um estado guardado.
+ *
+ * A seguir vem os `num_inimigos` inimigos, os `num_obstaculos` obstaculos
+ * e, desde a versao 2, o gerador de numeros aleatorios; ao ler um estado da
+ * versao 1 o gerador e semeado de novo. Desde a versao 3 vem no fim o
+ * turno, que e 0 nos estados mais antigos. Os bitboards, as grelhas e as
+ * linhas nao sao guardados: sao recalculados ao ler.
+ */
+typedef struct {
+	/** `ESTADO_MAGIC`. */
+	char magic[8];
+	/** `ESTADO_VERSAO`. */
+	uint32_t versao;
+	/** O tipo de movimento actual */
+	uint32_t mov_type;
+	/** As dimensoes do tabuleiro */
+	posicao_s tam;
+	/** O nome do jogador */
+	char nome[11];
+	/** O nivel actual */
+	uchar nivel;
+	/** O score actual */
+	uint32_t score;
+	/** Flag que indica se o ultimo ataque do jogador matou */
+	uint32_t matou;
+	/** O numero de inimigos vivos */
+	uint32_t num_inimigos;
+	/** O numero de obstaculos */
+	uint32_t num_obstaculos;
+	/** O jogador */
+	entidade jog;
+	/** A porta de saida do nivel */
+	posicao_s porta;
+} estado_cabecalho;
+
+/**
+ * @brief O lado do tabuleiro de um estado guardado da versao 0.
+ */
+#define ESTADO_V0_TAM	10
+
+/**
+ * @brief Uma posicao num estado guardado da versao 0.
+ */
+typedef struct {
+	/** A abcissa da posicao. */
+	uchar x;
+	/** A ordenada da posicao. */
+	uchar y;
+} posicao_v0;
+
+/**
+ * @brief Uma entidade num estado guardado da versao 0.
+ */
+typedef struct {
+	/** A posicao da entidade */
+	posicao_v0 pos;
+	/** A vida da entidade */
+	uchar vida;
+	/** O id da entidade */
+	uchar id;
+} entidade_v0;
+
+/**
+ * @brief Um estado guardado da versao 0: o `estado_s` da primeira versao do
+ * jogo, escrito tal como estava em memoria, com 328 bytes.
+ *
+ * Nao tem `ESTADO_MAGIC` nem versao; reconhece-se pelo tamanho. O tabuleiro
+ * e sempre `ESTADO_V0_TAM` por `ESTADO_V0_TAM` e so havia os dois primeiros
+ * tipos de movimento. Ao ler um estado da versao 0 o gerador e semeado de
+ * novo e o turno e 0.
  */
 typedef struct {
 	/** O nome do jogador */
@@ -60,17 +215,26 @@ typedef struct {
 	uchar score;
 	/** Flag que indica se o ultimo ataque do jogador matou */
 	bool matou;
-	/** O tipo de movimento actual */
-	enum mov_type mov_type;
+	/** O tipo de movimento actual, um `enum` */
+	uint32_t mov_type;
 	/** O jogador */
-	entidade jog;
+	entidade_v0 jog;
 	/** A porta de saida do nivel */
-	posicao_s porta;
+	posicao_v0 porta;
 	/** Os inimigos */
-	entidade inimigo[MAX_INIMIGOS];
+	entidade_v0 inimigo[MAX_INIMIGOS(ESTADO_V0_TAM, ESTADO_V0_TAM)];
 	/** Os obstaculos */
-	entidade obstaculo[MAX_OBSTACULOS];
-} estado_s, * estado_p;
+	entidade_v0 obstaculo[MAX_OBSTACULOS(ESTADO_V0_TAM, ESTADO_V0_TAM)];
+} estado_v0;
+
+/**
+ * @brief O tamanho maximo de um estado guardado com um tabuleiro de `L` por `A`.
+ * @param L A largura do tabuleiro
+ * @param A A altura do tabuleiro
+ */
+#define ESTADO_TAMANHO_MAX(L, A) \
+	(sizeof(estado_cabecalho) + ((MAX_INIMIGOS(L, A) + MAX_OBSTACULOS(L, A)) * sizeof(entidade)) \
+	 + sizeof(aleatorio) + sizeof(uint32_t))
 
 /**
  * @brief Verifica se o jogo chegou ao fim
@@ -88,13 +252,52 @@ bool fim_de_ronda (const estado_p e);
 
 /**
  * @brief Inicializa o estado do jogo
+ * @param tam As dimensoes do tabuleiro, entre `TAM_MIN` e `TAM_MAX`
  * @param nivel O ultimo nivel completado
  * @param score Score obtido ate agora
  * @param mt O tipo de movimento actual
  * @param nome O nome do jogador
+ * @param semente A semente do gerador de numeros aleatorios do jogo; a mesma
+ * semente gera sempre o mesmo nivel
  * @returns O estado inicializado
  */
-estado_s init_estado (uchar nivel, uchar score, enum mov_type mt, const char * nome);
+estado_s init_estado (posicao_s tam, uchar nivel, unsigned score, enum mov_type mt, const char * nome, uint64_t semente);
+
+/**
+ * @brief Liberta a memoria dinamica de um estado
+ * @param e O estado
+ */
+void estado_liberta (estado_p e);
+
+/**
+ * @brief Copia um estado, incluindo a memoria dinamica
+ * @param e O estado
+ * @returns A copia, que tem de ser libertada com `estado_liberta()`
+ */
+estado_s estado_copia (const estado_p e);
+
+/**
+ * @brief Calcula o tamanho de um estado guardado
+ * @param e O estado
+ * @returns O tamanho, em bytes
+ */
+size_t estado_tamanho (const estado_p e);
+
+/**
+ * @brief Escreve um estado no formato em que e guardado
+ * @param e O estado
+ * @param buf Onde escrever, com `estado_tamanho(e)` bytes
+ */
+void estado_serializa (const estado_p e, void * buf);
+
+/**
+ * @brief Le um estado guardado, em qualquer versao, incluindo a 0
+ * @param e Onde guardar o estado, que tem de ser libertado com `estado_liberta()`
+ * @param buf O estado guardado
+ * @param n O tamanho do estado guardado
+ * @returns Verdadeiro se o estado for valido, falso caso contrario
+ */
+bool estado_desserializa (estado_p e, const void * buf, size_t n);
 
 /**
  * @brief Move o jogador pra uma posicao
@@ -104,13 +307,22 @@ estado_s init_estado (uchar nivel, uchar score, enum mov_type mt, const char * n
  */
 estado_s move_jogador (estado_s e, posicao_s p);
 
+/**
+ * @brief Move um inimigo pra uma posicao livre
+ * @param e O estado do jogo
+ * @param I O indice do inimigo
+ * @param p A posicao pra onde o inimigo vai ser movido
+ * @returns O novo estado
+ */
+estado_s move_inimigo (estado_s e, size_t I, posicao_s p);
+
 /**
  * @brief Ataca um inimigo
  * @param ret O estado do jogo
  * @param I O indice do inimigo a atacar
  * @returns O novo estado
  */
-estado_s ataca_inimigo (estado_s ret, uchar I);
+estado_s ataca_inimigo (estado_s ret, size_t I);
 
 /**
  * @brief Ataca o jogador
@@ -118,7 +330,7 @@ estado_s ataca_inimigo (estado_s ret, uchar I);
  * @param I Indice do inimigo que atacou
  * @returns O novo estado
  */
-estado_s ataca_jogador (const estado_p e, uchar I);
+estado_s ataca_jogador (const estado_p e, size_t I);
 
 /**
  * @brief Verifica se uma posicao contem algum inimigo
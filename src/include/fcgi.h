@@ -0,0 +1,42 @@
+/** @file */
+#ifndef _FCGI_H
+#define _FCGI_H
+
+#include <stdbool.h>
+
+/**
+ * @brief O descritor onde o servidor web passa o socket a escuta.
+ */
+#define FCGI_LISTENSOCK_FILENO	0
+
+/**
+ * @brief Tamanho maximo de uma `QUERY_STRING` recebida por FastCGI.
+ */
+#define FCGI_QS_MAX	1024
+
+/**
+ * @brief Tipo de funcoes que respondem a um pedido.
+ *
+ * O corpo da resposta e escrito com as funcoes `saida_*`, em `CONTENT_TYPE`
+ * a nao ser que o mude com `saida_muda_tipo()`; quem chama trata dos
+ * cabecalhos.
+ */
+typedef void (* fcgi_handler) (const char * qs);
+
+/**
+ * @brief Verifica se o programa foi lancado por um servidor FastCGI.
+ * @returns Verdadeiro se o `stdin` for um socket a escuta, falso caso contrario.
+ */
+bool fcgi_e_fcgi (void);
+
+/**
+ * @brief Atende pedidos FastCGI ate ocorrer um erro no socket a escuta.
+ *
+ * Ignora o `SIGPIPE`: uma ligacao que o servidor web fecha antes de ler a
+ * resposta so termina essa ligacao.
+ * @param handler A funcao que responde a cada pedido.
+ * @returns Codigo de erro.
+ */
+int fcgi_serve (fcgi_handler handler);
+
+#endif /* _FCGI_H */
@@ -0,0 +1,78 @@
+/** @file */
+#ifndef _GRELHA_H
+#define _GRELHA_H
+
+#include <stdint.h>
+
+#include "posicao.h"
+
+/**
+ * @brief O numero de casas de cada lado de uma celula da grelha.
+ */
+#define GRELHA_LADO	8
+
+/**
+ * @brief Uma grelha uniforme que indexa um array de entidades pela posicao.
+ *
+ * O tabuleiro e dividido em celulas de `GRELHA_LADO` por `GRELHA_LADO`
+ * casas e cada celula tem a lista das entidades que estao nela. As listas
+ * sao ligadas por indices do array de entidades, mais 1, para que 0 seja o
+ * fim da lista.
+ */
+typedef struct {
+	/** Por celula, a primeira entidade da celula. */
+	uint32_t * cabeca;
+	/** Por entidade, a entidade seguinte na mesma celula. */
+	uint32_t * prox;
+	/** O numero de celulas em cada linha. */
+	size_t largura;
+} grelha;
+
+/**
+ * @brief Calcula o indice da celula de uma posicao.
+ * @param G A grelha.
+ * @param P A posicao, dentro do tabuleiro.
+ */
+#define GRELHA_CELULA(G, P) \
+	((((size_t) (P).y / GRELHA_LADO) * (G).largura) + ((P).x / GRELHA_LADO))
+
+/**
+ * @brief Reserva uma grelha vazia.
+ * @param g A grelha.
+ * @param tam As dimensoes do tabuleiro.
+ * @param N O numero maximo de entidades.
+ */
+void grelha_init (grelha * g, posicao_s tam, size_t N);
+
+/**
+ * @brief Liberta a memoria de uma grelha.
+ * @param g A grelha.
+ */
+void grelha_liberta (grelha * g);
+
+/**
+ * @brief Acrescenta uma entidade a celula de uma posicao.
+ * @param g A grelha.
+ * @param p A posicao da entidade.
+ * @param i O indice da entidade.
+ */
+void grelha_poe (grelha * g, posicao_s p, size_t i);
+
+/**
+ * @brief Tira uma entidade da celula de uma posicao.
+ * @param g A grelha.
+ * @param p A posicao da entidade.
+ * @param i O indice da entidade.
+ */
+void grelha_tira (grelha * g, posicao_s p, size_t i);
+
+/**
+ * @brief Muda uma entidade de posicao.
+ * @param g A grelha.
+ * @param de A posicao antiga da entidade.
+ * @param para A posicao nova da entidade.
+ * @param i O indice da entidade.
+ */
+void grelha_move (grelha * g, posicao_s de, posicao_s para, size_t i);
+
+#endif /* _GRELHA_H */
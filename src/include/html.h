@@ -18,126 +18,200 @@
 #define ESCALA		40UL
 
 /**
- * @brief A pasta das imagens.
+ * @brief O numero de casas de cada lado da parte do tabuleiro que e mostrada.
  */
-#define IMAGE_PATH	"http://localhost/images/"
+#define VISTA		TAM
+
+/**
+ * @brief O numero de camadas fixas, de niveis diferentes, guardadas por cada thread.
+ */
+#define HTML_CAMADAS	128
+
+/**
+ * @brief A pasta das imagens, no servidor da pagina, seja qual for o nome dele.
+ */
+#define IMAGE_PATH	"/images/"
 
 /**
  * @brief A imagem dos obstaculos.
  */
-#define IMG_OBSTACULO	(IMAGE_PATH "lava_pool1.png")
+#define IMG_OBSTACULO	IMAGE_PATH "lava_pool1.png"
 
 /**
  * @brief A imagem dos inimigos.
  */
-#define IMG_INIMIGO	(IMAGE_PATH "Char_14.png")
+#define IMG_INIMIGO	IMAGE_PATH "Char_14.png"
 
 /**
  * @brief A imagem do jogador.
  */
-#define IMG_JOGADOR	(IMAGE_PATH "character_21.png")
+#define IMG_JOGADOR	IMAGE_PATH "character_21.png"
 
 /**
  * @brief A imagem da porta.
  */
-#define IMG_PORTA	(IMAGE_PATH "tombstone.png")
+#define IMG_PORTA	IMAGE_PATH "tombstone.png"
+
+#include "saida.h"
+
+/**
+ * @brief O id, no `<defs>`, de uma casa do tabuleiro.
+ */
+#define DEF_CASA	"c"
+
+/**
+ * @brief O id, no `<defs>`, da imagem dos obstaculos.
+ */
+#define DEF_OBSTACULO	"o"
+
+/**
+ * @brief O id, no `<defs>`, da imagem dos inimigos.
+ */
+#define DEF_INIMIGO	"i"
 
-#include <stdio.h>
+/**
+ * @brief O id, no `<defs>`, da imagem do jogador.
+ */
+#define DEF_JOGADOR	"j"
+
+/**
+ * @brief O id, no `<defs>`, da imagem da porta.
+ */
+#define DEF_PORTA	"p"
+
+/**
+ * @brief O id, no `<defs>`, do rectangulo transparente das jogadas.
+ */
+#define DEF_JOGADA	"a"
 
 /**
- * @brief Imprime um comentario HTML.
- * @param S O texto do comentario.
+ * @brief Imprime uma imagem do `<defs>`, com uma casa de lado.
+ * @param ID O id, uma string literal.
+ * @param I A imagem, uma string literal.
  */
-#define COMMENT(S)	(puts("\n<!-- " S " -->\n"))
+#define DEF_IMAGEM(ID, I)	"<image id=" ID " width=1 height=1 href=\"" I "\" />"
 
 /**
- * @brief Imprime o cabecalho da CGI.
+ * @brief O inicio do `<defs>` do quadro SVG, com o estilo e as formas.
  */
-#define CONTENT_TYPE	(puts("Content-Type: text/html\n\n"))
+#define DEFS_FORMAS \
+	"<defs><style>text{font-family:serif;font-weight:bold}</style>" \
+	"<rect id=" DEF_CASA " width=1 height=1 />" \
+	"<rect id=" DEF_JOGADA " width=1 height=1 fill-opacity=0 />"
 
 /**
- * @brief Abre o quadro SVG.
+ * @brief O `<defs>` do quadro SVG: cada forma e imagem e declarada uma vez
+ * e o tabuleiro so tem `<use>`.
+ *
+ * Tudo com uma casa de lado, porque o tabuleiro e desenhado numa escala em
+ * que cada casa mede 1.
+ */
+#define DEFS \
+	DEFS_FORMAS \
+	DEF_IMAGEM(DEF_OBSTACULO, IMG_OBSTACULO) \
+	DEF_IMAGEM(DEF_INIMIGO, IMG_INIMIGO) \
+	DEF_IMAGEM(DEF_JOGADOR, IMG_JOGADOR) \
+	DEF_IMAGEM(DEF_PORTA, IMG_PORTA) \
+	"</defs>\n"
+
+/**
+ * @brief Imprime uma imagem do `<defs>` embutida na pagina.
+ * @param ID O id, uma string literal.
+ * @param A O array com o data-URI da imagem, gerado em `imagens.h`.
+ */
+#define DEF_IMAGEM_EMBUTIDA(ID, A) \
+	(SAIDA_LITERAL("<image id=" ID " width=1 height=1 href=\""), \
+	 saida_escreve((A), sizeof(A)), \
+	 SAIDA_LITERAL("\" />"))
+
+#ifdef HTML_COMENTARIOS
+/**
+ * @brief Imprime um comentario HTML, se `HTML_COMENTARIOS` estiver definido.
+ * @param S O texto do comentario, uma string literal.
+ */
+#define COMMENT(S)	(SAIDA_LITERAL("\n<!-- " S " -->\n\n"))
+#else
+#define COMMENT(S)	((void) 0)
+#endif
+
+/**
+ * @brief O `Content-Type` das paginas do jogo.
+ */
+#define CONTENT_TYPE	"text/html"
+
+/**
+ * @brief Abre o quadro SVG e imprime o `<defs>`.
  * @param X Largura do quadro.
  * @param Y Altura do quadro.
  */
-#define ABRE_SVG(X, Y)	(printf("<SVG WIDTH=%u HEIGHT=%u>\n", (X), (Y)))
+#define ABRE_SVG(X, Y)	(SAIDA_LITERAL("<svg width="), saida_num(X), \
+			 SAIDA_LITERAL(" height="), saida_num(Y), \
+			 SAIDA_LITERAL(">\n"), imprime_defs())
 
 /**
  * @brief Fecha o quadro SVG.
  */
-#define FECHA_SVG	(puts("</SVG>\n"))
+#define FECHA_SVG	(SAIDA_LITERAL("</svg>\n"))
+
+/**
+ * @brief Abre o grupo do tabuleiro, em que cada casa mede 1.
+ * @param E Escala.
+ */
+#define ABRE_TABULEIRO(E)	(SAIDA_LITERAL("<g transform=scale("), saida_num(E), \
+				 SAIDA_LITERAL(")>\n"))
+
+/**
+ * @brief Fecha o grupo do tabuleiro.
+ */
+#define FECHA_TABULEIRO	(SAIDA_LITERAL("</g>\n"))
 
 /**
  * @brief Abre a tag HTML `<BODY>`.
  * @param C Cor do background.
  */
-#define ABRE_BODY(C)	(printf("<BODY STYLE=\"background-color:%s\">\n", (C)))
+#define ABRE_BODY(C)	(SAIDA_LITERAL("<body style=background:"), saida_str(C), \
+			 SAIDA_LITERAL(">\n"))
 
 /**
  * @brief Fecha o tag `<BODY>`.
  */
-#define FECHA_BODY	(puts("</BODY>\n"))
+#define FECHA_BODY	(SAIDA_LITERAL("</body>\n"))
 
 /**
  * @brief Abre um tag HTML `<A>` com um link.
  * @param Q O link.
  */
-#define GAME_LINK(Q)	(printf("<A XLINK:HREF=\"http://localhost/cgi-bin/rogue?%s\">\n", (Q)))
+#define GAME_LINK(Q)	(SAIDA_LITERAL("<a href=\"?"), saida_str(Q), \
+			 SAIDA_LITERAL("\">"))
 
 /**
  * @brief Fecha um tag HTML `<A>`.
  */
-#define FECHA_A		(puts("</A>\n"))
+#define FECHA_A		(SAIDA_LITERAL("</a>\n"))
 
 /**
- * @brief Imprime um rectangulo SVG.
- * @param L Ordenada.
- * @param C Abcissa.
- * @param E Escala.
- * @param COR A cor.
- */
-#define RECT(L, C, E, COR)		(printf("<RECT Y=%lu X=%lu WIDTH=%lu HEIGHT=%lu FILL=\"%s\"/>\n",\
-			((L) * (E)),\
-			((C) * (E)),\
-			(E),\
-			(E),\
-			(COR)\
-			))
-
-/**
- * @brief Imprime uma imagem.
+ * @brief Reutiliza uma forma ou imagem do `<defs>` numa casa do tabuleiro.
+ * @param ID O id.
  * @param X Abcissa.
  * @param Y Ordenada.
- * @param E Escala.
- * @param I Imagem.
- */
-#define IMAGE(X, Y, E, I)		(printf("<IMAGE X=%lu Y=%lu WIDTH=%lu HEIGHT=%lu XLINK:HREF=\"%s\"/>\n",\
-			((X) * (E)),\
-			((Y) * (E)),\
-			(E),\
-			(E),\
-			(I)\
-			))
-
-/**
- * @brief Imprime um rectangulo SVG transparente.
- * @param L Ordenada.
- * @param C Abcissa.
- * @param E Escala.
  */
-#define RECT_TRANSPARENTE(L, C, E)	(printf("<RECT Y=%lu X=%lu WIDTH=%lu HEIGHT=%lu STYLE=\"fill-opacity:0\"/>\n",\
-			((L) * (E)),\
-			((C) * (E)),\
-			(E),\
-			(E)\
-			))
+#define USE(ID, X, Y) \
+	(SAIDA_LITERAL("<use href=#"), saida_str(ID), \
+	 SAIDA_LITERAL(" x="), saida_num(X), \
+	 SAIDA_LITERAL(" y="), saida_num(Y), \
+	 SAIDA_LITERAL(" />"))
 
 /**
  * @brief Imprime uma casa do tabuleiro.
  * @param L Ordenada.
  * @param C Abcissa.
+ * @param COR Cor.
  */
-#define IMPRIME_CASA(L, C)		RECT((L), (C), ESCALA, random_color())
+#define IMPRIME_CASA(L, C, COR) \
+	(SAIDA_LITERAL("<use href=#" DEF_CASA " x="), saida_num(C), \
+	 SAIDA_LITERAL(" y="), saida_num(L), \
+	 SAIDA_LITERAL(" fill="), saida_str(COR), \
+	 SAIDA_LITERAL(" />"))
 
 /**
  * @brief Abcissa dos botoes do menu do jogo.
@@ -162,19 +236,37 @@
  * @param COR Cor.
  */
 #define BOTAO(X, Y, TXT, COR) \
-	(printf("<RECT Y=%u X=%u WIDTH=400 HEIGHT=40 FILL=\"%s\"/>" \
-		"<TEXT Y=%u X=%u TEXT-ANCHOR=\"midle\" TEXT-ALIGN=\"center\"" \
-		"FONT-FAMILY=\"serif\" FONT-WEIGHT=\"bold\">%s</TEXT>", \
-		(Y), \
-		(X), \
-		(COR), \
-		(Y) + (TEXT_OFFSET), \
-		(X) + (TEXT_OFFSET), \
-		(TXT)))
+	(SAIDA_LITERAL("<rect y="), saida_num(Y), \
+	 SAIDA_LITERAL(" x="), saida_num(X), \
+	 SAIDA_LITERAL(" width=400 height=40 fill="), saida_str(COR), \
+	 SAIDA_LITERAL(" /><text y="), saida_num((Y) + (TEXT_OFFSET)), \
+	 SAIDA_LITERAL(" x="), saida_num((X) + (TEXT_OFFSET)), \
+	 SAIDA_LITERAL(">"), \
+	 saida_str(TXT), \
+	 SAIDA_LITERAL("</text>"))
 #include "jogo.h"
 
 /**
- * @brief Imprime o jogo.
+ * @brief Imprime o `<defs>` do quadro SVG.
+ *
+ * Com `HTML_IMAGENS_EMBUTIDAS`, como no `make embutido`, as imagens vao
+ * dentro da pagina, em data-URIs gerados a partir de `IMAGENS` no build, e
+ * uma pagina carrega com um so pedido; caso contrario sao pedidas a
+ * `IMAGE_PATH`, no mesmo servidor, e ficam na cache do browser.
+ */
+void imprime_defs (void);
+
+/**
+ * @brief Passa a guardar em memoria a camada fixa de cada nivel.
+ *
+ * As casas, a porta e os obstaculos nao mudam durante um nivel: sao
+ * escritos uma vez para cada parte do tabuleiro que e mostrada e copiados
+ * para as paginas seguintes. So vale a pena num processo residente.
+ */
+void html_camadas_activa (void);
+
+/**
+ * @brief Imprime o jogo na saida.
  * @param e O estado a imprimir.
  */
 void imprime_jogo (const estado_p e);
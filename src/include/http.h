@@ -0,0 +1,35 @@
+/** @file */
+#ifndef _HTTP_H
+#define _HTTP_H
+
+#include "fcgi.h"
+
+/**
+ * @brief Numero maximo de bytes do cabecalho de um pedido HTTP.
+ */
+#define HTTP_IN_MAX	8192
+
+/**
+ * @brief Numero maximo de eventos tratados por cada `epoll_wait()`.
+ */
+#define HTTP_EVENTOS	64
+
+/**
+ * @brief A pasta, por omissao, de onde sao servidas as imagens.
+ */
+#define HTTP_IMAGENS	"images/"
+
+/**
+ * @brief Atende pedidos HTTP/1.1 num unico processo ate ocorrer um erro.
+ *
+ * Os pedidos a `/` ou `/cgi-bin/rogue` sao respondidos por `handler`, que
+ * escreve a pagina no buffer de saida, comprimida se o `Accept-Encoding`
+ * o permitir; as imagens do jogo sao servidas a partir da pasta `imagens`.
+ * @param porta A porta TCP onde escutar.
+ * @param imagens A pasta das imagens.
+ * @param handler A funcao que responde a cada pedido ao jogo.
+ * @returns Codigo de erro.
+ */
+int http_serve (unsigned short porta, const char * imagens, fcgi_handler handler);
+
+#endif /* _HTTP_H */
@@ -1,4 +1,11 @@
 /** @file */
+/**
+ * O motor do jogo, que faz parte da `librogue.a`: calcula jogadas e
+ * executa accoes sem ler nem escrever ficheiros e sem estado global.
+ * Quem chama da os buffers onde escrever os resultados, logo pode ser
+ * chamado por varias threads ao mesmo tempo, desde que cada uma tenha o
+ * seu estado.
+ */
 #ifndef _JOGO_H
 #define _JOGO_H
 
@@ -6,22 +13,29 @@
 #include "estado.h"
 
 /**
- * @brief Numero maximo de jogadas possiveis.
+ * @brief Numero maximo de jogadas possiveis num tabuleiro com as dimensoes `T`.
+ *
+ * Uma peca deslizante (a rainha) chega a ter `4 * (max(T.x, T.y) - 1)` jogadas.
+ * @param T As dimensoes do tabuleiro.
+ */
+#define NJOGADAS(T) (4 * (size_t) (((T).x > (T).y) ? (T).x : (T).y))
+
+/**
+ * @brief O tamanho de cada lado da janela, a volta do jogador, onde os bots jogam.
  */
-#define NJOGADAS 8
+#define CAMPO_TAM 64
 
 /**
- * @brief Calcula o numero de jogadas de um array de jogadas ou posicoes.
- * @param J Array de jogadas ou posicoes.
- * @returns Numero de jogadas de um array de jogadas ou posicoes.
+ * @brief Numero maximo de posicoes possiveis numa janela de `L` casas de lado.
+ * @param L O lado da janela.
  */
-#define quantas_jogadas(J) (*(((uchar *) (J)) - 1))
+#define NPOSICOES_JANELA(L) (4 * (L))
 
 /*
  * 10 for player name
  * 8 for action type
- * 4 for player position (x/y)
- * 4 for target position (x/y)
+ * 8 for player position (x/y)
+ * 8 for target position (x/y)
  * 5 for comma (,)
  * 1 for '\0'
  */
@@ -33,11 +47,6 @@
 	((((sizeof(enum accao)) + (sizeof(posicao_s) << 1)) << 1) \
 	 + 10 + 5 + 1)
 
-/**
- * @brief Pasta para guardar os ficheiros de estado dos jogadores.
- */
-#define BASE_PATH	"/var/www/html/files/"
-
 /**
  * @brief Tipo de accao.
  */
@@ -84,46 +93,110 @@ typedef struct {
 } jogada_s, * jogada_p;
 
 /**
- * @brief Ficheiro de highscore.
+ * @brief Um rectangulo do tabuleiro, de `min` (inclusive) a `max` (exclusive).
+ *
+ * Num tabuleiro grande so se trabalha numa parte dele: as jogadas dos bots
+ * sao calculadas numa janela a volta do jogador, e so se mostra outra.
  */
-#define SCOREFILE_PATH	"/var/www/html/highscoresfile"
+typedef struct {
+	/** O canto superior esquerdo. */
+	posicao_s min;
+	/** O canto inferior direito, exclusive. */
+	posicao_s max;
+} janela;
 
 /**
- * @brief Tipo de highscore.
+ * @brief Cria uma janela com o tabuleiro todo.
+ * @param e O estado actual.
+ * @returns A janela.
  */
-struct highscore {
-	/** Nome do jogador. */
-	char nome[11];
-	/** Score. */
-	uchar score;
-};
+janela janela_tabuleiro (const estado_p e);
+
+/**
+ * @brief Cria uma janela de `lado` por `lado` a volta de uma posicao, sem sair do tabuleiro.
+ *
+ * Se o tabuleiro for mais pequeno do que a janela, a janela e o tabuleiro.
+ * @param e O estado actual.
+ * @param c A posicao central.
+ * @param lado O tamanho de cada lado da janela.
+ * @returns A janela.
+ */
+janela janela_em_volta (const estado_p e, posicao_s c, size_t lado);
+
+/**
+ * @brief Verifica se uma casa esta dentro de uma janela.
+ * @param j A janela.
+ * @param x A abcissa, que pode estar fora do tabuleiro.
+ * @param y A ordenada, que pode estar fora do tabuleiro.
+ * @returns Verdadeiro se estiver dentro, falso caso contrario.
+ */
+bool janela_contem (const janela * j, long x, long y);
 
 /**
  * @brief Calcula todas as jogadas possiveis do jogador.
  * @param e O estado actual.
- * @returns Uma lista de jogadas.
+ * @param dst Onde escrever as jogadas, com espaco para `NJOGADAS(e->tam)`.
+ * @returns O numero de jogadas.
  */
-jogada_p jogadas_possiveis (const estado_p e);
+size_t jogadas_possiveis (const estado_p e, jogada_p dst);
 
 /**
- * @brief Le o estado a partir do ficheiro.
- * @param accao A accao a executar.
- * @returns O estado lido.
+ * @brief Reserva espaco para as jogadas possiveis de um estado.
+ * @param e O estado actual.
+ * @returns Um array com `NJOGADAS(e->tam)` jogadas, a libertar com `free()`.
  */
-estado_s ler_estado (accao_s accao);
+jogada_p aloca_jogadas (const estado_p e);
 
 /**
- * @brief Escreve o estado de jogo no ficheiro.
- * @param e O estado a guardar.
+ * @brief Calcula um conjunto de posicoes possiveis.
+ * @param e O estado actual.
+ * @param o A posicao de origem.
+ * @param j A janela onde procurar.
+ * @param inimigo Se quem joga e um inimigo, que nao pode ir para cima de outros.
+ * @param dst Onde escrever as posicoes, com espaco para `NJOGADAS(e->tam)`, ou
+ * `NPOSICOES_JANELA(L)` se a janela nao tiver mais de `L` casas de lado.
+ * @returns O numero de posicoes.
  */
-void escreve_estado (const estado_p e);
+size_t posicoes_possiveis (const estado_p e, posicao_s o, const janela * j, bool inimigo, posicao_p dst);
 
 /**
- * @brief Calcula o caminho de um ficheiro de jogo.
- * @param name Nome do jogador.
- * @returns O caminho do ficheiro.
+ * @brief Calcula o novo estado de acordo com a accao recebida.
+ * @param ret O estado actual.
+ * @param accao A accao.
+ * @returns O novo estado.
  */
-char * pathname (const char * name);
+estado_s corre_accao (estado_s ret, accao_s accao);
+
+/**
+ * @brief Verifica se uma accao nao muda nada no estado, a parte da jogada dos bots.
+ *
+ * Sao as accoes `ACCAO_IGNORE` e os links de jogadas antigas, cuja posicao
+ * do jogador ja nao e a actual, como quando a pagina e recarregada.
+ * @param e O estado actual.
+ * @param accao A accao.
+ * @returns Verdadeiro se a accao nao fizer nada, falso caso contrario.
+ */
+bool accao_nula (const estado_p e, accao_s accao);
+
+/**
+ * @brief Calcula o novo estado depois de todos os bots jogarem.
+ *
+ * So jogam os bots dentro da janela do campo de distancias; os outros
+ * estao longe demais do jogador e ficam a dormir.
+ * @param ret O estado actual.
+ * @returns O novo estado.
+ */
+estado_s bot_joga (estado_s ret);
+
+/**
+ * @brief Executa uma accao e a jogada dos bots, ou comeca um jogo novo se o jogo tiver acabado.
+ *
+ * Cada chamada avanca o turno do estado, mesmo que a accao nao mude nada.
+ * @param ret O estado do jogo.
+ * @param accao A accao a executar.
+ * @returns O novo estado.
+ */
+estado_s joga (estado_s ret, accao_s accao);
 
 /**
  * @brief Cria uma nova accao.
@@ -136,16 +209,17 @@ char * pathname (const char * name);
 accao_s accao_new (const char * nome, enum accao accao, posicao_s jog, posicao_s dest);
 
 /**
- * @brief Gera um Link.
+ * @brief Escreve o link de uma accao.
  * @param accao A accao.
- * @returns O link.
+ * @param dst Onde escrever o link, com `JOGADA_LINK_MAX_BUFFER` bytes.
+ * @returns `dst`.
  */
-char * accao2str (accao_s accao);
+char * accao_link (accao_s accao, char * dst);
 
 /**
  * @brief Le um link.
  * @param str O link.
- * @returns A nova accao.
+ * @returns A nova accao, `ACCAO_INVALID` se o link for mal formado.
  */
 accao_s str2accao (const char * str);
 
@@ -156,23 +230,4 @@ accao_s str2accao (const char * str);
  */
 enum mov_type mov_type_next (enum mov_type ret);
 
-/**
- * @brief Le os highscores a partir do ficheiro.
- * @returns O array de highscores.
- */
-struct highscore * ler_highscore (void);
-
-/**
- * @brief Escreve os highscores no ficheiro
- * @param hs O array de highscores.
- */
-void escreve_highscore (struct highscore hs[3]);
-
-/**
- * @brief Actualiza o array de highscores com o score do jogador actual.
- * @param e O estado actual.
- * @param hs O array de highscores.
- */
-void update_highscore (const estado_p e, struct highscore hs[3]);
-
 #endif /* _JOGO_H */
@@ -0,0 +1,112 @@
+/** @file */
+#ifndef _LINHAS_H
+#define _LINHAS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bitboard.h"
+#include "entidades.h"
+#include "posicao.h"
+
+/**
+ * @brief As arrumacoes das casas de um tabuleiro em `linhas`.
+ *
+ * Em cada arrumacao, as casas de uma coluna, de uma diagonal ou de uma
+ * anti-diagonal sao bits seguidos, como as de uma linha num `bitboard`.
+ * As diagonais sao guardadas modulo a altura: cada linha de bits tem duas
+ * diagonais, mas um raio que fica dentro do tabuleiro nunca passa de uma
+ * para a outra.
+ */
+enum linhas_arrumacao {
+	/** A casa `(x, y)` e o bit `x * altura + y`. */
+	LINHAS_COLUNAS,
+	/** A casa `(x, y)` e o bit `((y - x) mod altura) * largura + x`. */
+	LINHAS_DIAGONAIS,
+	/** A casa `(x, y)` e o bit `((x + y) mod altura) * largura + x`. */
+	LINHAS_ANTIDIAGONAIS,
+	/** Numero de arrumacoes diferentes. */
+	LINHAS_ARRUMACOES_QUANTAS,
+};
+
+/**
+ * @brief Um conjunto de casas do tabuleiro arrumado por colunas e por diagonais.
+ *
+ * Com um `bitboard` do mesmo conjunto, que esta arrumado por linhas, cada
+ * raio de uma peca deslizante e um intervalo de bits seguidos, onde se
+ * procura a primeira casa ocupada com `linhas_procura()`, 64 casas de cada
+ * vez. Os bits estao em memoria dinamica, com o tamanho do tabuleiro do jogo.
+ */
+typedef struct {
+	/** Os bits, uma arrumacao a seguir a outra, ou `NULL` se nao tiverem sido reservados. */
+	uint64_t * w;
+	/** As dimensoes do tabuleiro. */
+	posicao_s tam;
+} linhas;
+
+/**
+ * @brief Calcula as palavras de uma arrumacao de um conjunto reservado.
+ * @param L O conjunto.
+ * @param A A arrumacao.
+ */
+#define LINHAS_PALAVRAS(L, A)	((L).w + ((A) * BB_PALAVRAS((L).tam)))
+
+/**
+ * @brief Reserva um conjunto vazio.
+ * @param l O conjunto.
+ * @param tam As dimensoes do tabuleiro.
+ */
+void linhas_init (linhas * l, posicao_s tam);
+
+/**
+ * @brief Liberta a memoria de um conjunto.
+ * @param l O conjunto.
+ */
+void linhas_liberta (linhas * l);
+
+/**
+ * @brief Calcula o indice de uma posicao numa arrumacao.
+ * @param l O conjunto.
+ * @param a A arrumacao.
+ * @param p A posicao, dentro do tabuleiro.
+ * @returns O indice.
+ */
+size_t linhas_indice (const linhas * l, enum linhas_arrumacao a, posicao_s p);
+
+/**
+ * @brief Acrescenta uma posicao a um conjunto; se nao tiver sido reservado, nao faz nada.
+ * @param l O conjunto.
+ * @param p A posicao, dentro do tabuleiro.
+ */
+void linhas_liga (linhas * l, posicao_s p);
+
+/**
+ * @brief Acrescenta as posicoes de varias entidades a um conjunto; se nao tiver sido reservado, nao faz nada.
+ * @param l O conjunto.
+ * @param p As entidades.
+ * @param N O numero de entidades.
+ */
+void linhas_marca (linhas * l, const entidades p, size_t N);
+
+/**
+ * @brief Tira uma posicao de um conjunto; se nao tiver sido reservado, nao faz nada.
+ * @param l O conjunto.
+ * @param p A posicao, dentro do tabuleiro.
+ */
+void linhas_desliga (linhas * l, posicao_s p);
+
+/**
+ * @brief Procura o primeiro bit ligado num intervalo de bits seguidos.
+ *
+ * Os bits sao os da uniao de `nw` arrays com a mesma arrumacao, que podem
+ * ser as palavras de um `bitboard` ou de uma arrumacao de `linhas`.
+ * @param w Os arrays de palavras.
+ * @param nw O numero de arrays.
+ * @param ini O indice do primeiro bit.
+ * @param n O numero de bits a ver.
+ * @param frente Se os bits sao `ini`, `ini + 1`, ... ou `ini`, `ini - 1`, ...
+ * @returns A distancia a `ini` do primeiro bit ligado, ou `n` se nao houver nenhum.
+ */
+size_t linhas_procura (const uint64_t * const * w, size_t nw, size_t ini, size_t n, bool frente);
+
+#endif /* _LINHAS_H */
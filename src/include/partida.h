@@ -0,0 +1,112 @@
+/** @file */
+#ifndef _PARTIDA_H
+#define _PARTIDA_H
+
+#include <stdbool.h>
+
+#include "estado.h"
+#include "jogo.h"
+
+/**
+ * @brief Ficheiro de highscore.
+ */
+#define SCOREFILE_PATH	"/var/www/html/highscoresfile"
+
+/**
+ * @brief Tipo de highscore.
+ */
+struct highscore {
+	/** Nome do jogador. */
+	char nome[11];
+	/** Score. */
+	unsigned score;
+};
+
+/**
+ * @brief Tipo de highscore no ficheiro escrito pela primeira versao do jogo,
+ * com o score num `uchar`.
+ *
+ * Um ficheiro com tres destes, 36 bytes em vez de 48, e convertido ao ler e
+ * reescrito no formato novo da proxima vez que houver um highscore.
+ */
+struct highscore_v0 {
+	/** Nome do jogador. */
+	char nome[11];
+	/** Score. */
+	uchar score;
+};
+
+/**
+ * @brief Le o estado de um jogador, da cache ou do armazenamento, sem executar nenhuma accao.
+ * @param nome Nome do jogador.
+ * @param e Onde guardar o estado lido, que tem de ser libertado com `estado_liberta()`.
+ * @returns Verdadeiro se conseguiu ler um estado valido, falso caso contrario.
+ */
+bool estado_actual (const char * nome, estado_p e);
+
+/**
+ * @brief Executa uma accao num estado lido por `estado_actual()` e acrescenta-a ao diario.
+ * @param e O estado.
+ * @param accao A accao a executar.
+ * @param antes Onde guardar uma copia do estado antes da accao, que tem de
+ * ser libertada com `estado_liberta()`, ou `NULL`.
+ * @returns O novo estado.
+ */
+estado_s joga_estado (estado_s e, accao_s accao, estado_p antes);
+
+/**
+ * @brief Le o estado, da cache ou do armazenamento, e executa uma accao.
+ * @param accao A accao a executar.
+ * @param antes Onde guardar uma copia do estado antes da accao, que tem de
+ * ser libertada com `estado_liberta()`, ou `NULL`.
+ * @returns O estado lido.
+ */
+estado_s ler_estado (accao_s accao, estado_p antes);
+
+/**
+ * @brief Reconstroi o estado de um jogador a partir do seu diario.
+ *
+ * Comeca pelo estado inicial guardado no diario e executa as accoes pela
+ * ordem em que foram guardadas, como `ler_estado()`, com o mesmo gerador
+ * de numeros aleatorios; o resultado e o mesmo estado. Se o diario nao
+ * existir ou nao for valido o estado fica a zeros.
+ * @param nome Nome do jogador.
+ * @param max O numero maximo de accoes a executar.
+ * @param e Onde guardar o estado, que tem de ser libertado com `estado_liberta()`.
+ * @returns O numero de accoes executadas.
+ */
+size_t repete_diario (const char * nome, size_t max, estado_p e);
+
+/**
+ * @brief Escreve o estado de jogo na cache ou, se esta estiver inactiva, no armazenamento.
+ * @param e O estado a guardar.
+ */
+void escreve_estado (const estado_p e);
+
+/**
+ * @brief Verifica se um jogador ja tem um estado guardado.
+ * @param nome Nome do jogador.
+ * @returns Verdadeiro se existir, falso caso contrario.
+ */
+bool existe_estado (const char * nome);
+
+/**
+ * @brief Le os highscores a partir do ficheiro, no formato actual ou no da primeira versao.
+ * @param hs Onde guardar os highscores.
+ */
+void ler_highscore (struct highscore hs[3]);
+
+/**
+ * @brief Escreve os highscores no ficheiro
+ * @param hs O array de highscores.
+ */
+void escreve_highscore (struct highscore hs[3]);
+
+/**
+ * @brief Actualiza o array de highscores com o score do jogador actual.
+ * @param e O estado actual.
+ * @param hs O array de highscores.
+ */
+void update_highscore (const estado_p e, struct highscore hs[3]);
+
+#endif /* _PARTIDA_H */
@@ -2,11 +2,23 @@
 #ifndef _POSICAO_H
 #define _POSICAO_H
 
+#include <stdint.h>
+
 /**
- * @brief O tamanho do tabuleiro.
+ * @brief O tamanho, por omissao, de cada lado do tabuleiro.
  */
 #define TAM		10
 
+/**
+ * @brief O tamanho minimo de cada lado do tabuleiro.
+ */
+#define TAM_MIN		4
+
+/**
+ * @brief O tamanho maximo de cada lado do tabuleiro.
+ */
+#define TAM_MAX		4096
+
 /**
  * @brief Um char sem sinal.
  */
@@ -15,12 +27,12 @@ typedef unsigned char uchar;
 /**
  * @brief Uma abcissa.
  */
-typedef uchar abcissa;
+typedef uint16_t abcissa;
 
 /**
  * @brief Uma ordenada.
  */
-typedef uchar ordenada;
+typedef uint16_t ordenada;
 
 /**
  * @var typedef posicao_s * posicao_p
@@ -51,9 +63,10 @@ bool posicao_igual (posicao_s p1, posicao_s p2);
 /**
  * @brief Verifica se uma posicao esta dentro do mapa
  * @param p A posicao a testar
+ * @param tam As dimensoes do mapa
  * @returns Verdadeiro caso a posicao esteja dentro do mapa, falso caso contrario
  */
-bool posicao_valida (posicao_s p);
+bool posicao_valida (posicao_s p, posicao_s tam);
 
 /**
  * @brief Cria uma nova posicao
@@ -63,15 +76,6 @@ bool posicao_valida (posicao_s p);
  */
 posicao_s posicao_new (abcissa x, ordenada y);
 
-/**
- * @brief Filtra um array de posicoes.
- * @param p Array de posicoes a filtrar.
- * @param num Numero de elementos do array.
- * @param f Funcao a testar em cada posicao.
- * @returns Numero de posicoes que satisfazem o predicado.
- */
-size_t pos_filter (posicao_p p, size_t num, bool (* f) (posicao_s));
-
 /**
  * @brief Calcula posicao mais proxima dentro de um conjunto de posicoes.
  * @param ps Array de posicoes.
@@ -0,0 +1,195 @@
+/** @file */
+/**
+ * A pagina de uma resposta e escrita num buffer em memoria, de cada
+ * thread, e enviada de uma vez, com o `Content-Length` certo. Se o
+ * cliente aceitar, o corpo e comprimido com gzip ou deflate antes de ser
+ * enviado.
+ *
+ * Uma resposta pode ter um `ETag`, a versao do que mostra; se o cliente ja
+ * a tiver, porque a mandou no `If-None-Match` do pedido, a resposta passa a
+ * ser um `304 Not Modified` sem corpo.
+ */
+#ifndef _SAIDA_H
+#define _SAIDA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief A capacidade inicial do buffer de saida.
+ */
+#define SAIDA_CAP	(64 * 1024)
+
+/**
+ * @brief O espaco reservado antes do corpo para os cabecalhos CGI.
+ */
+#define SAIDA_CABECALHOS	256
+
+/**
+ * @brief O tamanho maximo de um `ETag`, com o `'\0'`.
+ */
+#define SAIDA_ETAG_MAX	48
+
+/**
+ * @brief O tamanho maximo do `If-None-Match` de um pedido; um maior e ignorado.
+ */
+#define SAIDA_CONDICAO_MAX	256
+
+/**
+ * @brief As codificacoes do corpo de uma resposta (`Content-Encoding`).
+ */
+enum saida_codificacao {
+	/** O corpo tal como foi escrito. */
+	SAIDA_IDENTIDADE,
+	/** O corpo comprimido no formato gzip. */
+	SAIDA_GZIP,
+	/** O corpo comprimido no formato zlib, a que o HTTP chama deflate. */
+	SAIDA_DEFLATE,
+	/** Numero de codificacoes diferentes. */
+	SAIDA_CODIFICACOES_QUANTAS,
+};
+
+/**
+ * @brief Acrescenta uma string literal a saida, sem calcular o tamanho.
+ * @param S A string literal.
+ */
+#define SAIDA_LITERAL(S)	(saida_escreve((S), sizeof(S) - 1))
+
+/**
+ * @brief Comeca uma resposta nova, com o buffer de saida vazio.
+ * @param tipo O `Content-Type` da resposta, se nao for mudado com `saida_muda_tipo()`.
+ */
+void saida_inicio (const char * tipo);
+
+/**
+ * @brief Muda o `Content-Type` da resposta actual.
+ * @param tipo O `Content-Type`, uma string que tem de existir ate ao fim da resposta.
+ */
+void saida_muda_tipo (const char * tipo);
+
+/**
+ * @brief Devolve o `Content-Type` da resposta actual.
+ * @returns O `Content-Type`.
+ */
+const char * saida_tipo (void);
+
+/**
+ * @brief Guarda o `If-None-Match` do pedido da resposta actual, depois de `saida_inicio()`.
+ * @param s O valor do cabecalho, que nao precisa de terminar em `'\0'`, ou `NULL`.
+ * @param n O tamanho do valor.
+ */
+void saida_condicao (const char * s, size_t n);
+
+/**
+ * @brief Verifica se o cliente ja tem uma versao, por estar no `If-None-Match` do pedido.
+ *
+ * Os `ETag` sao comparados sem o `W/`, como num `GET`; `*` aceita qualquer um.
+ * @param etag O `ETag`, com as aspas.
+ * @returns Verdadeiro se tiver, falso caso contrario.
+ */
+bool saida_condicao_aceite (const char * etag);
+
+/**
+ * @brief Muda o `ETag` da resposta actual, que passa a ir com `Cache-Control: no-cache`
+ * para o cliente a validar sempre.
+ * @param etag O `ETag`, com as aspas e no maximo `SAIDA_ETAG_MAX - 1` caracteres.
+ */
+void saida_muda_etag (const char * etag);
+
+/**
+ * @brief Devolve o `ETag` da resposta actual.
+ * @returns O `ETag`, ou `NULL` se nao tiver.
+ */
+const char * saida_etag (void);
+
+/**
+ * @brief Transforma a resposta actual num `304 Not Modified`, sem corpo.
+ *
+ * Tem de ter um `ETag`; o que for escrito na saida e descartado.
+ */
+void saida_marca_nao_modificada (void);
+
+/**
+ * @brief Verifica se a resposta actual e um `304 Not Modified`.
+ * @returns Verdadeiro se for, falso caso contrario.
+ */
+bool saida_nao_modificada (void);
+
+/**
+ * @brief Devolve a posicao actual da saida, para obter mais tarde com
+ * `saida_desde()` o que for escrito a seguir.
+ * @returns A posicao.
+ */
+size_t saida_posicao (void);
+
+/**
+ * @brief Devolve o que foi escrito na saida desde uma posicao.
+ * @param pos A posicao, de `saida_posicao()`.
+ * @param n Onde guardar o numero de bytes.
+ * @returns Os bytes, validos ate a proxima escrita na saida.
+ */
+const char * saida_desde (size_t pos, size_t * n);
+
+/**
+ * @brief Acrescenta bytes a saida.
+ * @param buf Os bytes.
+ * @param n O numero de bytes.
+ */
+void saida_escreve (const void * buf, size_t n);
+
+/**
+ * @brief Acrescenta uma string a saida.
+ * @param s A string.
+ */
+void saida_str (const char * s);
+
+/**
+ * @brief Acrescenta um caracter a saida.
+ * @param c O caracter.
+ */
+void saida_char (char c);
+
+/**
+ * @brief Acrescenta um numero a saida, em decimal, sem `printf`.
+ * @param n O numero.
+ */
+void saida_num (unsigned long n);
+
+/**
+ * @brief Devolve os nomes das codificacoes, tal como aparecem nos cabecalhos HTTP.
+ * @returns Um array com `SAIDA_CODIFICACOES_QUANTAS` nomes.
+ */
+const char * const * saida_codificacoes (void);
+
+/**
+ * @brief Escolhe a codificacao do corpo a partir do `Accept-Encoding` do pedido.
+ *
+ * Prefere a codificacao com o maior `q`, e gzip em caso de empate; uma
+ * codificacao com `q=0` nunca e escolhida.
+ * @param s O valor do cabecalho, que nao precisa de terminar em `'\0'`, ou `NULL`.
+ * @param n O tamanho do valor.
+ * @returns A codificacao.
+ */
+enum saida_codificacao saida_codificacao_aceite (const char * s, size_t n);
+
+/**
+ * @brief Devolve o corpo da resposta, vazio num `304 Not Modified`.
+ * @param cod A codificacao do corpo.
+ * @param buf Onde guardar o apontador para o corpo, que pertence ao modulo
+ * e e reutilizado na proxima resposta da mesma thread.
+ * @returns O tamanho do corpo.
+ */
+size_t saida_fim (enum saida_codificacao cod, char ** buf);
+
+/**
+ * @brief Devolve a resposta CGI: os cabecalhos, com o `Content-Type`, o
+ * `Content-Length` e o `ETag`, e o corpo, ou so o `Status` e o `ETag` num
+ * `304 Not Modified`.
+ * @param cod A codificacao do corpo.
+ * @param buf Onde guardar o apontador para a resposta, que pertence ao
+ * modulo e e reutilizado na proxima resposta da mesma thread.
+ * @returns O tamanho da resposta.
+ */
+size_t saida_fim_cgi (enum saida_codificacao cod, char ** buf);
+
+#endif /* _SAIDA_H */
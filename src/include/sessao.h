@@ -0,0 +1,61 @@
+/** @file */
+#ifndef _SESSAO_H
+#define _SESSAO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "estado.h"
+
+/**
+ * @brief Numero, por omissao, de estados mantidos em memoria.
+ */
+#define SESSAO_CAPACIDADE	4096
+
+/**
+ * @brief Intervalo, por omissao, entre escritas dos estados alterados, em milissegundos.
+ */
+#define SESSAO_FLUSH_MS		1000
+
+/**
+ * @brief Activa a cache de estados em memoria.
+ *
+ * Os estados alterados sao escritos no disco por uma thread em background
+ * a cada `flush_ms` milissegundos, ou quando sao expulsos da cache. A mesma
+ * thread trata o `SIGINT` e o `SIGTERM`, escrevendo tudo antes de sair.
+ * @param capacidade Numero maximo de estados em memoria.
+ * @param flush_ms Intervalo entre escritas, em milissegundos.
+ */
+void sessao_activa (size_t capacidade, unsigned flush_ms);
+
+/**
+ * @brief Le um estado atraves da cache.
+ * @param nome O nome do jogador.
+ * @param e Onde guardar o estado, uma copia que tem de ser libertada com
+ * `estado_liberta()`. Se o estado nao existir ou nao for valido fica a zeros.
+ * @returns Falso se a cache nao estiver activa, verdadeiro caso contrario.
+ */
+bool sessao_ler (const char * nome, estado_p e);
+
+/**
+ * @brief Verifica se um jogador esta na cache.
+ * @param nome O nome do jogador.
+ * @returns Verdadeiro se estiver, falso caso contrario.
+ */
+bool sessao_existe (const char * nome);
+
+/**
+ * @brief Guarda um estado na cache, para ser escrito mais tarde.
+ *
+ * Com `DURABILIDADE_FSYNC` o estado e tambem escrito logo no disco.
+ * @param e O estado.
+ * @returns Falso se a cache nao estiver activa, verdadeiro caso contrario.
+ */
+bool sessao_escreve (const estado_p e);
+
+/**
+ * @brief Escreve no disco todos os estados alterados.
+ */
+void sessao_flush (void);
+
+#endif /* _SESSAO_H */
@@ -0,0 +1,135 @@
+/** @file */
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "estado.h"
+
+/**
+ * @brief Identificacao de um ficheiro slab.
+ */
+#define SLAB_MAGIC		"ROGUESLB"
+
+/**
+ * @brief Versao do formato do ficheiro slab.
+ */
+#define SLAB_VERSAO		5
+
+/**
+ * @brief Numero inicial de registos de um ficheiro slab (potencia de 2).
+ */
+#define SLAB_CAPACIDADE_MIN	1024
+
+/**
+ * @brief Offset do primeiro registo no ficheiro.
+ */
+#define SLAB_OFFSET		64
+
+/**
+ * @brief Espaco, em bytes, para um estado guardado num registo.
+ *
+ * Chega para qualquer estado de um tabuleiro de `TAM` por `TAM`; os
+ * estados maiores ficam no ficheiro do jogador.
+ */
+#define SLAB_DADOS		ESTADO_TAMANHO_MAX(TAM, TAM)
+
+/**
+ * @brief Tamanho de uma copia cujo estado esta no ficheiro do jogador.
+ */
+#define SLAB_EXTERNO		UINT32_MAX
+
+/**
+ * @brief Uma copia do estado de um jogador.
+ */
+typedef struct {
+	/** Numero de sequencia da escrita; 0 se a copia nunca foi escrita. */
+	uint64_t seq;
+	/** Checksum de `seq`, `tam` e `dados`. */
+	uint64_t soma;
+	/** O tamanho do estado guardado, ou `SLAB_EXTERNO`. */
+	uint32_t tam;
+	/** O estado guardado (ver `estado_serializa()`). */
+	uchar dados[SLAB_DADOS];
+} slab_copia;
+
+/**
+ * @brief O registo de um jogador.
+ *
+ * Cada escrita vai para a copia que nao e a mais recente, por isso uma
+ * escrita interrompida (um crash a meio) deixa sempre uma copia valida.
+ */
+typedef struct {
+	/** O nome do jogador; vazio se o registo estiver livre. */
+	char nome[16];
+	/** As duas copias do estado. */
+	slab_copia copia[2];
+} slab_registo;
+
+/**
+ * @brief O cabecalho de um ficheiro slab.
+ *
+ * Os registos vem a seguir, em `SLAB_OFFSET`: uma tabela de hash com
+ * enderecamento aberto (linear probing) de `capacidade` registos, indexada
+ * pelo nome do jogador. Um registo com o nome vazio esta livre.
+ */
+typedef struct {
+	/** `SLAB_MAGIC`. */
+	char magic[8];
+	/** `SLAB_VERSAO`. */
+	uint32_t versao;
+	/** `sizeof(slab_registo)`. */
+	uint32_t tam_registo;
+	/** Numero de registos (potencia de 2). */
+	uint64_t capacidade;
+	/** Numero de registos ocupados. */
+	uint64_t num;
+	/** Diferente de 0 depois de o ficheiro ter sido substituido por um maior. */
+	uint32_t substituido;
+} slab_cabecalho;
+
+/**
+ * @brief Abre (ou cria) um ficheiro slab, fechando o que estiver aberto.
+ * @param path O caminho do ficheiro.
+ */
+void slab_abre (const char * path);
+
+/**
+ * @brief Fecha o ficheiro slab aberto.
+ */
+void slab_fecha (void);
+
+/**
+ * @brief Le o estado guardado de um jogador.
+ * @param nome O nome do jogador.
+ * @param dados Onde guardar o estado, com `SLAB_DADOS` bytes.
+ * @param n Onde guardar o tamanho do estado, ou `SLAB_EXTERNO`.
+ * @returns Verdadeiro se o jogador existir, falso caso contrario.
+ */
+bool slab_ler (const char * nome, void * dados, size_t * n);
+
+/**
+ * @brief Escreve o estado guardado de um jogador, acrescentando-o se nao existir.
+ * @param nome O nome do jogador.
+ * @param dados O estado, ou `NULL` se `n` for `SLAB_EXTERNO`.
+ * @param n O tamanho do estado, no maximo `SLAB_DADOS`, ou `SLAB_EXTERNO`.
+ * @param sync Se so deve retornar depois de o registo estar no disco.
+ */
+void slab_escreve (const char * nome, const void * dados, size_t n, bool sync);
+
+/**
+ * @brief Espera que todas as escritas anteriores estejam no disco.
+ */
+void slab_sincroniza (void);
+
+/**
+ * @brief Verifica se um jogador existe.
+ *
+ * Um registo sem nenhuma copia valida nao conta como existente.
+ * @param nome O nome do jogador.
+ * @returns Verdadeiro se o jogador existir e tiver uma copia valida, falso caso contrario.
+ */
+bool slab_existe (const char * nome);
+
+#endif /* _SLAB_H */
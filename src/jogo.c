@@ -1,6 +1,8 @@
 /** @file */
 #include "check.h"
 
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "posicao.h"
@@ -12,34 +14,130 @@
  * Tipos de movimento:
  * [X] Rei do Xadrez
  * [X] Cavalo do Xadrez
- * [ ] Peao do Xadrez
- * [ ] Torre do Xadrez
- * [ ] Bispo do Xadrez
- * [ ] Rainha do Xadrez
- * [ ] Damas
+ * [X] Peao do Xadrez
+ * [X] Torre do Xadrez
+ * [X] Bispo do Xadrez
+ * [X] Rainha do Xadrez
+ * [X] Damas
  */
 
+janela janela_tabuleiro (const estado_p e)
+{
+	assert(e != NULL);
+	return (janela) { posicao_new(0, 0), e->tam };
+}
+
+janela janela_em_volta (const estado_p e, posicao_s c, size_t lado)
+{
+	assert(e != NULL);
+	assert(posicao_valida(c, e->tam));
+
+	size_t lx = (lado < e->tam.x) ? lado : e->tam.x;
+	size_t ly = (lado < e->tam.y) ? lado : e->tam.y;
+	size_t x = (c.x > (lx >> 1)) ? c.x - (lx >> 1) : 0;
+	size_t y = (c.y > (ly >> 1)) ? c.y - (ly >> 1) : 0;
+
+	x = (x + lx > e->tam.x) ? e->tam.x - lx : x;
+	y = (y + ly > e->tam.y) ? e->tam.y - ly : y;
+
+	return (janela) { posicao_new(x, y), posicao_new(x + lx, y + ly) };
+}
+
+bool janela_contem (const janela * j, long x, long y)
+{
+	assert(j != NULL);
+	return x >= j->min.x && x < j->max.x
+		&& y >= j->min.y && y < j->max.y;
+}
+
 /**
- * @brief Verifica se uma jogada e válida.
- * @param e Estado actual do jogo.
- * @param p Posicao a testar.
- * @returns Verdadeiro se for valida, falso caso contrario.
+ * @brief Verifica se uma casa bloqueia o caminho de uma peca.
+ * @param e O estado actual.
+ * @param p A casa.
+ * @param terreno Se so os obstaculos bloqueiam.
+ * @returns Verdadeiro se bloquear, falso caso contrario.
  */
-bool jogada_valida (const estado_p e, const posicao_p p)
+bool pospos_bloqueia (const estado_p e, posicao_s p, bool terreno)
 {
-	assert(e != NULL);
-	assert(p != NULL);
-	return posicao_valida(*p)
-	    && !(pos_inimigos(e->obstaculo, *p, e->num_obstaculos));
+	return BB_TESTA(e->bb_obstaculos, p)
+		|| (!terreno && (BB_TESTA(e->bb_inimigos, p) || BB_TESTA(e->bb_jogador, p)));
 }
 
 /**
- * @brief Calcula posicoes possiveis para o tipo de movimento rei de xadrez.
- * @param dst Array de destino.
+ * @brief Um deslocamento, em casas.
+ */
+typedef struct {
+	/** O deslocamento na horizontal. */
+	signed char dx;
+	/** O deslocamento na vertical. */
+	signed char dy;
+} deslocamento;
+
+/**
+ * @brief Calcula as casas para onde uma peca que salta pode ir.
  * @param o Posicao de origem.
- * @returns Numero de posicoes escritas.
+ * @param j A janela.
+ * @param d Os saltos.
+ * @param n O numero de saltos.
+ * @param dst Onde guardar as casas.
+ * @returns O numero de casas.
+ */
+size_t pospos_saltos (posicao_s o, const janela * j, const deslocamento * d, size_t n, posicao_p dst)
+{
+	size_t ret = 0;
+	for (size_t i = 0; i < n; i++)
+		if (janela_contem(j, (long) o.x + d[i].dx, (long) o.y + d[i].dy))
+			dst[ret++] = posicao_new(o.x + d[i].dx, o.y + d[i].dy);
+	return ret;
+}
+
+/**
+ * @brief Escreve as casas de um `bitboard_tam` que estao dentro de uma janela, por ordem de indice.
+ * @param b As casas.
+ * @param j A janela.
+ * @param dst Onde guardar as casas.
+ * @returns O numero de casas.
  */
-uchar pospos_xadrez_rei (posicao_p dst, const posicao_p o)
+size_t pospos_tabela (const bitboard_tam * b, const janela * j, posicao_p dst)
+{
+	/* com a janela do tabuleiro todo nao e preciso ver casa a casa */
+	bool todo = j->min.x == 0 && j->min.y == 0 && j->max.x == TAM && j->max.y == TAM;
+	size_t ret = 0;
+
+	for (size_t i = 0; i < BB_TAM_PALAVRAS; i++) {
+		for (uint64_t w = b->w[i]; w != 0; w &= w - 1) {
+			size_t s = (i << 6) + __builtin_ctzll(w);
+			if (todo || janela_contem(j, BB_X(s), BB_Y(s)))
+				dst[ret++] = posicao_new(BB_X(s), BB_Y(s));
+		}
+	}
+
+	return ret;
+}
+
+/**
+ * @def REI(S, W)
+ * @brief Calcula a palavra `W` das casas atacadas pelo rei de xadrez na casa `S`.
+ */
+
+/**
+ * @def REI_BB(S)
+ * @brief Calcula as casas atacadas pelo rei de xadrez na casa `S`.
+ */
+
+/**
+ * @brief Calcula as casas para onde o tipo de movimento rei de xadrez pode ir.
+ *
+ * No tabuleiro de `TAM` por `TAM` as casas vem de uma tabela gerada em
+ * tempo de compilacao; nos outros, dos saltos pela mesma ordem.
+ * @param e O estado actual.
+ * @param o Posicao de origem.
+ * @param j A janela.
+ * @param terreno Se so os obstaculos bloqueiam.
+ * @param dst Onde guardar as casas.
+ * @returns O numero de casas, sem ter em conta o que as ocupa.
+ */
+size_t pospos_xadrez_rei (const estado_p e, posicao_s o, const janela * j, bool terreno, posicao_p dst)
 {
 	/*
 	 *    1 0 1
@@ -49,36 +147,51 @@ uchar pospos_xadrez_rei (posicao_p dst, const posicao_p o)
 	 *   -------
 	 * 1 |X|X|X|
 	 */
-	assert(dst != NULL);
-	assert(o != NULL);
-
-	uchar ret = 0;
-	for (abcissa x = o->x; x < o->x + 3; x++) {
-		for (ordenada y = o->y; y < o->y + 3; y++) {
-			posicao_s p = posicao_new(x - 1, y - 1);
-			if (!posicao_igual(*o, p))
-				dst[ret++] = p;
-		}
-	}
+	UNUSED(terreno);
+	static const deslocamento d[] = {
+		{ -1, -1 }, { 0, -1 }, { 1, -1 },
+		{ -1,  0 },            { 1,  0 },
+		{ -1,  1 }, { 0,  1 }, { 1,  1 },
+	};
 
-	return ret;
+#define REI(S, W) (								\
+	BB_CASA(W, BB_X(S) - 1, BB_Y(S) - 1) | BB_CASA(W, BB_X(S), BB_Y(S) - 1)	\
+	| BB_CASA(W, BB_X(S) + 1, BB_Y(S) - 1) | BB_CASA(W, BB_X(S) - 1, BB_Y(S))	\
+	| BB_CASA(W, BB_X(S) + 1, BB_Y(S)) | BB_CASA(W, BB_X(S) - 1, BB_Y(S) + 1)	\
+	| BB_CASA(W, BB_X(S), BB_Y(S) + 1) | BB_CASA(W, BB_X(S) + 1, BB_Y(S) + 1))
+#define REI_BB(S) BB_GERA(REI, S)
+	static const bitboard_tam tabela[BB_TAM_CASAS] = { BB_TABELA(REI_BB) };
+#undef REI_BB
+#undef REI
+
+	return (BB_TEM_TABELAS(e->tam)) ?
+		pospos_tabela(tabela + BB_TAM_INDICE(o), j, dst) :
+		pospos_saltos(o, j, d, sizeof(d) / sizeof(*d), dst);
 }
 
 /**
- * @def F(X, Y)
- * @brief Calcula uma nova posicao e guarda-a no array de destino.
- * @param X Abcissa da nova posicao.
- * @param Y Ordenada da nova posicao.
- * @returns A nova posicao.
+ * @def CAVALO(S, W)
+ * @brief Calcula a palavra `W` das casas atacadas pelo cavalo de xadrez na casa `S`.
+ */
+
+/**
+ * @def CAVALO_BB(S)
+ * @brief Calcula as casas atacadas pelo cavalo de xadrez na casa `S`.
  */
 
 /**
- * @brief Calcula posicoes possiveis para o tipo de movimento cavalo de xadrez.
- * @param dst Array de destino.
+ * @brief Calcula as casas para onde o tipo de movimento cavalo de xadrez pode ir.
+ *
+ * No tabuleiro de `TAM` por `TAM` as casas vem de uma tabela gerada em
+ * tempo de compilacao; nos outros, dos saltos pela mesma ordem.
+ * @param e O estado actual.
  * @param o Posicao de origem.
- * @returns Numero de posicoes escritas.
+ * @param j A janela.
+ * @param terreno Se so os obstaculos bloqueiam.
+ * @param dst Onde guardar as casas.
+ * @returns O numero de casas, sem ter em conta o que as ocupa.
  */
-uchar pospos_xadrez_cavalo (posicao_p dst, const posicao_p o)
+size_t pospos_xadrez_cavalo (const estado_p e, posicao_s o, const janela * j, bool terreno, posicao_p dst)
 {
 	/*
 	 *    2 1 0 1 2
@@ -92,109 +205,476 @@ uchar pospos_xadrez_cavalo (posicao_p dst, const posicao_p o)
 	 *   -----------
 	 * 2 | |X| |X| |
 	 */
-	assert(dst != NULL);
-	assert(o != NULL);
-
-	uchar ret = 0;
-
-#define F(X, Y) dst[ret++] = posicao_new((X), (Y))
-	F(o->x - 2, o->y - 1);
-	F(o->x - 2, o->y + 1);
-	F(o->x - 1, o->y - 2);
-	F(o->x - 1, o->y + 2);
-	F(o->x + 1, o->y - 2);
-	F(o->x + 1, o->y + 2);
-	F(o->x + 2, o->y - 1);
-	F(o->x + 2, o->y + 1);
-	return ret;
+	UNUSED(terreno);
+	static const deslocamento d[] = {
+		{ -1, -2 }, {  1, -2 }, { -2, -1 }, {  2, -1 },
+		{ -2,  1 }, {  2,  1 }, { -1,  2 }, {  1,  2 },
+	};
 
-#undef F
+#define CAVALO(S, W) (								\
+	BB_CASA(W, BB_X(S) - 2, BB_Y(S) - 1) | BB_CASA(W, BB_X(S) - 2, BB_Y(S) + 1)	\
+	| BB_CASA(W, BB_X(S) - 1, BB_Y(S) - 2) | BB_CASA(W, BB_X(S) - 1, BB_Y(S) + 2)	\
+	| BB_CASA(W, BB_X(S) + 1, BB_Y(S) - 2) | BB_CASA(W, BB_X(S) + 1, BB_Y(S) + 2)	\
+	| BB_CASA(W, BB_X(S) + 2, BB_Y(S) - 1) | BB_CASA(W, BB_X(S) + 2, BB_Y(S) + 1))
+#define CAVALO_BB(S) BB_GERA(CAVALO, S)
+	static const bitboard_tam tabela[BB_TAM_CASAS] = { BB_TABELA(CAVALO_BB) };
+#undef CAVALO_BB
+#undef CAVALO
+
+	return (BB_TEM_TABELAS(e->tam)) ?
+		pospos_tabela(tabela + BB_TAM_INDICE(o), j, dst) :
+		pospos_saltos(o, j, d, sizeof(d) / sizeof(*d), dst);
 }
 
 /**
- * @brief Tipo de funcoes que calculam as posicoes possiveis para um tipo de movimento.
+ * @def PEAO(S, W)
+ * @brief Calcula a palavra `W` das casas atacadas pelo peao na casa `S`.
  */
-typedef uchar (* pospos_handler) (posicao_p dst, const posicao_p o);
 
 /**
- * @brief Devolve um array de apontadores para funcoes que calculam posicoes possiveis.
- * @returns Array de apontadores de funcoes.
+ * @def PEAO_BB(S)
+ * @brief Calcula as casas atacadas pelo peao na casa `S`.
  */
-const pospos_handler * pospos_handlers (void)
+
+/**
+ * @brief Calcula as casas para onde o tipo de movimento peao de xadrez pode ir.
+ *
+ * Como o tabuleiro nao tem lados, a "frente" do peao e qualquer uma das
+ * quatro direccoes ortogonais.
+ * @param e O estado actual.
+ * @param o Posicao de origem.
+ * @param j A janela.
+ * @param terreno Se so os obstaculos bloqueiam.
+ * @param dst Onde guardar as casas.
+ * @returns O numero de casas, sem ter em conta o que as ocupa.
+ */
+size_t pospos_xadrez_peao (const estado_p e, posicao_s o, const janela * j, bool terreno, posicao_p dst)
 {
-	static const pospos_handler ret[MOV_TYPE_QUANTOS] = {
-		[MOV_TYPE_XADREZ_REI]    = pospos_xadrez_rei,
-		[MOV_TYPE_XADREZ_CAVALO] = pospos_xadrez_cavalo,
+	/*
+	 *    1 0 1
+	 * 1 | |X| |
+	 *   -------
+	 * 0 |X|J|X|
+	 *   -------
+	 * 1 | |X| |
+	 */
+	UNUSED(terreno);
+	static const deslocamento d[] = {
+		{ 0, -1 }, { -1, 0 }, { 1, 0 }, { 0, 1 },
 	};
-	return ret;
+
+#define PEAO(S, W) (							\
+	BB_CASA(W, BB_X(S), BB_Y(S) - 1) | BB_CASA(W, BB_X(S) - 1, BB_Y(S))	\
+	| BB_CASA(W, BB_X(S) + 1, BB_Y(S)) | BB_CASA(W, BB_X(S), BB_Y(S) + 1))
+#define PEAO_BB(S) BB_GERA(PEAO, S)
+	static const bitboard_tam tabela[BB_TAM_CASAS] = { BB_TABELA(PEAO_BB) };
+#undef PEAO_BB
+#undef PEAO
+
+	return (BB_TEM_TABELAS(e->tam)) ?
+		pospos_tabela(tabela + BB_TAM_INDICE(o), j, dst) :
+		pospos_saltos(o, j, d, sizeof(d) / sizeof(*d), dst);
 }
 
 /**
- * @brief Filtra um conjunto de posicoes dado uma fucao.
- * @param e O estado actual.
- * @param p O array de posicoes.
- * @param num O numero de posicoes.
- * @param f O filtro.
- * @returns Numero de posicoes que satisfizeram o filtro.
+ * @brief As direccoes em que as pecas deslizantes se movem.
+ *
+ * As primeiras quatro vao para casas de indice maior num `bitboard_tam`,
+ * as outras para casas de indice menor.
+ */
+enum direccao {
+	/** Para a direita. */
+	DIRECCAO_E,
+	/** Para baixo. */
+	DIRECCAO_S,
+	/** Para baixo e para a direita. */
+	DIRECCAO_SE,
+	/** Para baixo e para a esquerda. */
+	DIRECCAO_SO,
+	/** Para a esquerda. */
+	DIRECCAO_O,
+	/** Para cima. */
+	DIRECCAO_N,
+	/** Para cima e para a esquerda. */
+	DIRECCAO_NO,
+	/** Para cima e para a direita. */
+	DIRECCAO_NE,
+	/** Numero de direccoes. */
+	DIRECCAO_QUANTAS,
+};
+
+/**
+ * @brief O deslocamento de cada direccao.
+ */
+static const deslocamento direccoes[DIRECCAO_QUANTAS] = {
+	[DIRECCAO_E]  = {  1,  0 }, [DIRECCAO_S]  = {  0,  1 },
+	[DIRECCAO_SE] = {  1,  1 }, [DIRECCAO_SO] = { -1,  1 },
+	[DIRECCAO_O]  = { -1,  0 }, [DIRECCAO_N]  = {  0, -1 },
+	[DIRECCAO_NO] = { -1, -1 }, [DIRECCAO_NE] = {  1, -1 },
+};
+
+/**
+ * @brief As direccoes ortogonais, pela ordem em que as casas sao escritas.
+ */
+static const enum direccao direccoes_ortogonais[] = {
+	DIRECCAO_E, DIRECCAO_S, DIRECCAO_O, DIRECCAO_N,
+};
+
+/**
+ * @brief As direccoes diagonais, pela ordem em que as casas sao escritas.
+ */
+static const enum direccao direccoes_diagonais[] = {
+	DIRECCAO_SE, DIRECCAO_SO, DIRECCAO_NO, DIRECCAO_NE,
+};
+
+/**
+ * @brief Procura a casa de menor indice de um `bitboard_tam` nao vazio.
+ * @param b O bitboard.
+ * @returns O indice da casa.
  */
-uchar pospos_filter (const estado_p e, posicao_p p, size_t num, bool (* f) (const estado_p, const posicao_p))
+size_t bb_primeira (const bitboard_tam * b)
 {
-	assert(e != NULL);
-	assert(p != NULL);
-	assert(num > 0);
-	assert(f != NULL);
+	size_t i = 0;
+	for (i = 0; b->w[i] == 0; i++);
+	return (i << 6) + __builtin_ctzll(b->w[i]);
+}
 
-	uchar ret = 0;
+/**
+ * @brief Procura a casa de maior indice de um `bitboard_tam` nao vazio.
+ * @param b O bitboard.
+ * @returns O indice da casa.
+ */
+size_t bb_ultima (const bitboard_tam * b)
+{
+	size_t i = BB_TAM_PALAVRAS - 1;
+	for (; b->w[i] == 0; i--);
+	return (i << 6) + 63 - __builtin_clzll(b->w[i]);
+}
 
-	for (size_t r = 0; r < num; r++) {
-		if (f(e, p + r)) {
-			p[ret] = p[r];
-			ret++;
-		}
+/**
+ * @def RAIO(S, W, DX, DY)
+ * @brief Calcula a palavra `W` do raio que sai da casa `S` na direccao `(DX, DY)`.
+ */
+
+/**
+ * @def RAIO_BB(S, DX, DY)
+ * @brief Calcula o raio que sai da casa `S` na direccao `(DX, DY)`.
+ */
+
+/**
+ * @def RAIOS(S)
+ * @brief Calcula os raios que saem da casa `S`, por ordem de `enum direccao`.
+ */
+
+/**
+ * @brief Conta as casas de um raio ate a primeira ocupada (inclusive), no tabuleiro de `TAM` por `TAM`.
+ *
+ * A primeira casa ocupada encontra-se com uma tabela de raios: e a de menor
+ * indice das casas ocupadas do raio, ou a de maior se a direccao for para
+ * indices menores.
+ * @param o Posicao de origem.
+ * @param d A direccao.
+ * @param ocupadas As casas ocupadas.
+ * @returns O numero de casas, ou `SIZE_MAX` se nenhuma estiver ocupada.
+ */
+size_t pospos_passos_tabela (posicao_s o, enum direccao d, const bitboard_tam * ocupadas)
+{
+#define RAIO(S, W, DX, DY) (							\
+	BB_CASA(W, BB_X(S) + (1 * (DX)), BB_Y(S) + (1 * (DY)))			\
+	| BB_CASA(W, BB_X(S) + (2 * (DX)), BB_Y(S) + (2 * (DY)))		\
+	| BB_CASA(W, BB_X(S) + (3 * (DX)), BB_Y(S) + (3 * (DY)))		\
+	| BB_CASA(W, BB_X(S) + (4 * (DX)), BB_Y(S) + (4 * (DY)))		\
+	| BB_CASA(W, BB_X(S) + (5 * (DX)), BB_Y(S) + (5 * (DY)))		\
+	| BB_CASA(W, BB_X(S) + (6 * (DX)), BB_Y(S) + (6 * (DY)))		\
+	| BB_CASA(W, BB_X(S) + (7 * (DX)), BB_Y(S) + (7 * (DY)))		\
+	| BB_CASA(W, BB_X(S) + (8 * (DX)), BB_Y(S) + (8 * (DY)))		\
+	| BB_CASA(W, BB_X(S) + (9 * (DX)), BB_Y(S) + (9 * (DY))))
+#define RAIO_BB(S, DX, DY) { { RAIO(S, 0, DX, DY), RAIO(S, 1, DX, DY) } }
+#define RAIOS(S) {							\
+	[DIRECCAO_E]  = RAIO_BB(S,  1,  0), [DIRECCAO_S]  = RAIO_BB(S,  0,  1),	\
+	[DIRECCAO_SE] = RAIO_BB(S,  1,  1), [DIRECCAO_SO] = RAIO_BB(S, -1,  1),	\
+	[DIRECCAO_O]  = RAIO_BB(S, -1,  0), [DIRECCAO_N]  = RAIO_BB(S,  0, -1),	\
+	[DIRECCAO_NO] = RAIO_BB(S, -1, -1), [DIRECCAO_NE] = RAIO_BB(S,  1, -1),	\
+}
+	static const bitboard_tam raios[BB_TAM_CASAS][DIRECCAO_QUANTAS] = { BB_TABELA(RAIOS) };
+#undef RAIOS
+#undef RAIO_BB
+#undef RAIO
+
+	const bitboard_tam * raio = raios[BB_TAM_INDICE(o)] + d;
+	bitboard_tam bloqueio;
+	bool bloqueado = false;
+	for (size_t i = 0; i < BB_TAM_PALAVRAS; i++) {
+		bloqueio.w[i] = raio->w[i] & ocupadas->w[i];
+		bloqueado |= bloqueio.w[i] != 0;
+	}
+	ifjmp(!bloqueado, livre);
+
+	/* a distancia a primeira casa ocupada, que e a mais perto da origem */
+	size_t b = (d < DIRECCAO_O) ?
+		bb_primeira(&bloqueio) :
+		bb_ultima(&bloqueio);
+	int dx = BB_X(b) - o.x;
+	int dy = BB_Y(b) - o.y;
+	dx = (dx < 0) ? -dx : dx;
+	dy = (dy < 0) ? -dy : dy;
+	return (dx > dy) ? dx : dy;
+livre:
+	return SIZE_MAX;
+}
+
+/**
+ * @brief Conta as casas de um raio ate a primeira ocupada (inclusive), nos tabuleiros sem tabelas.
+ *
+ * As casas ocupadas do raio sao bits seguidos de um bitboard (na horizontal)
+ * ou das linhas (na vertical e nas diagonais), onde a primeira se procura 64
+ * casas de cada vez. O jogador so ocupa uma casa, que se ve a parte.
+ * @param e O estado actual.
+ * @param o Posicao de origem.
+ * @param v A direccao.
+ * @param alcance O numero maximo de casas.
+ * @param terreno Se so os obstaculos bloqueiam.
+ * @returns O numero de casas, ou `alcance` se nenhuma estiver ocupada.
+ */
+size_t pospos_passos_linhas (const estado_p e, posicao_s o, deslocamento v, size_t alcance, bool terreno)
+{
+	const uint64_t * w[2];
+	size_t ini = 0;
+
+	if (v.dy == 0) {
+		w[0] = e->bb_obstaculos.w;
+		w[1] = e->bb_inimigos.w;
+		ini = BB_INDICE(e->bb_obstaculos, o);
+	} else {
+		enum linhas_arrumacao a = (v.dx == 0) ?
+			LINHAS_COLUNAS :
+			(v.dx == v.dy) ?
+			LINHAS_DIAGONAIS :
+			LINHAS_ANTIDIAGONAIS;
+		w[0] = LINHAS_PALAVRAS(e->linhas_obstaculos, a);
+		w[1] = LINHAS_PALAVRAS(e->linhas_inimigos, a);
+		ini = linhas_indice(&e->linhas_obstaculos, a, o);
 	}
 
+	/* em todas as arrumacoes, o indice cresce com o `x` ou, nas colunas, com o `y` */
+	bool frente = (v.dx != 0) ? v.dx > 0 : v.dy > 0;
+	size_t ret = linhas_procura(w, (terreno) ? 1 : 2, (frente) ? ini + 1 : ini - 1, alcance, frente);
+	ret = (ret < alcance) ? ret + 1 : alcance;
+
+	/* o jogador, se estiver neste raio */
+	long jx = (long) e->jog.pos.x - o.x;
+	long jy = (long) e->jog.pos.y - o.y;
+	long s = (v.dx != 0) ? jx * v.dx : jy * v.dy;
+	if (!terreno && s > 0 && (size_t) s < ret && jx == s * v.dx && jy == s * v.dy)
+		ret = s;
+
 	return ret;
 }
 
 /**
- * @def SIZE
- * @brief Tamanho maximo, em bytes, das posicoes possiveis.
+ * @brief Calcula quantas casas cabem na janela numa direccao, a partir de uma posicao.
+ * @param o A posicao, cuja casa seguinte na direccao esta dentro da janela.
+ * @param j A janela.
+ * @param d A direccao.
+ * @returns O numero de casas, sem contar com a posicao.
  */
+size_t pospos_alcance (posicao_s o, const janela * j, deslocamento d)
+{
+	size_t ret = SIZE_MAX;
+
+	if (d.dx != 0)
+		ret = (d.dx > 0) ? (size_t) (j->max.x - 1 - o.x) : (size_t) (o.x - j->min.x);
+	if (d.dy != 0) {
+		size_t ny = (d.dy > 0) ? (size_t) (j->max.y - 1 - o.y) : (size_t) (o.y - j->min.y);
+		ret = (ny < ret) ? ny : ret;
+	}
+
+	return ret;
+}
 
 /**
- * @brief Calcula um conjunto de posicoes possiveis.
+ * @brief Calcula as casas para onde uma peca deslizante pode ir.
+ *
+ * Em cada direccao vai ate a primeira casa ocupada (inclusive) ou ate ao
+ * fim da janela, com as casas pela ordem do raio. A primeira casa ocupada
+ * procura-se nas tabelas de raios no tabuleiro de `TAM` por `TAM` e nas
+ * linhas nos outros.
  * @param e O estado actual.
- * @param o A posicao de origem.
- * @returns As posicoes possiveis.
+ * @param o Posicao de origem.
+ * @param j A janela.
+ * @param terreno Se so os obstaculos bloqueiam.
+ * @param d As direccoes.
+ * @param n O numero de direccoes.
+ * @param dst Onde guardar as casas.
+ * @returns O numero de casas, sem ter em conta o que ocupa a ultima de cada direccao.
  */
-posicao_p posicoes_possiveis (const estado_p e, posicao_s o)
+size_t pospos_deslizante (const estado_p e, posicao_s o, const janela * j, bool terreno,
+			  const enum direccao * d, size_t n, posicao_p dst)
 {
 	assert(e != NULL);
-	assert(e->mov_type < MOV_TYPE_QUANTOS);
-	assert(posicao_valida(o));
+	assert(posicao_valida(o, e->tam));
+
+	/* os bitboards deste tabuleiro tem as mesmas palavras que um `bitboard_tam` */
+	bool tabelas = BB_TEM_TABELAS(e->tam);
+	bitboard_tam ocupadas;
+	for (size_t i = 0; tabelas && i < BB_TAM_PALAVRAS; i++)
+		ocupadas.w[i] = e->bb_obstaculos.w[i]
+			| ((terreno) ? 0 : e->bb_inimigos.w[i] | e->bb_jogador.w[i]);
+
+	size_t ret = 0;
+	for (size_t k = 0; k < n; k++) {
+		deslocamento v = direccoes[d[k]];
+		if (!janela_contem(j, (long) o.x + v.dx, (long) o.y + v.dy))
+			continue;
+
+		size_t alcance = pospos_alcance(o, j, v);
+		size_t passos = (tabelas) ?
+			pospos_passos_tabela(o, d[k], &ocupadas) :
+			pospos_passos_linhas(e, o, v, alcance, terreno);
+		passos = (passos < alcance) ? passos : alcance;
+
+		for (size_t i = 1; i <= passos; i++)
+			dst[ret++] = posicao_new(o.x + ((long) i * v.dx), o.y + ((long) i * v.dy));
+	}
 
-#define SIZE (1 + (sizeof(posicao_s) * NJOGADAS))
-	static uchar arr[SIZE] = "";
-	memset(arr, 0, SIZE);
+	return ret;
+}
 
-	const pospos_handler * handlers = pospos_handlers();
-	assert(handlers != NULL);
+/**
+ * @brief Calcula as casas para onde o tipo de movimento torre de xadrez pode ir.
+ * @param e O estado actual.
+ * @param o Posicao de origem.
+ * @param j A janela.
+ * @param terreno Se so os obstaculos bloqueiam.
+ * @param dst Onde guardar as casas.
+ * @returns O numero de casas, sem ter em conta o que as ocupa.
+ */
+size_t pospos_xadrez_torre (const estado_p e, posicao_s o, const janela * j, bool terreno, posicao_p dst)
+{
+	return pospos_deslizante(e, o, j, terreno, direccoes_ortogonais, 4, dst);
+}
+
+/**
+ * @brief Calcula as casas para onde o tipo de movimento bispo de xadrez pode ir.
+ * @param e O estado actual.
+ * @param o Posicao de origem.
+ * @param j A janela.
+ * @param terreno Se so os obstaculos bloqueiam.
+ * @param dst Onde guardar as casas.
+ * @returns O numero de casas, sem ter em conta o que as ocupa.
+ */
+size_t pospos_xadrez_bispo (const estado_p e, posicao_s o, const janela * j, bool terreno, posicao_p dst)
+{
+	return pospos_deslizante(e, o, j, terreno, direccoes_diagonais, 4, dst);
+}
+
+/**
+ * @brief Calcula as casas para onde o tipo de movimento rainha de xadrez pode ir.
+ * @param e O estado actual.
+ * @param o Posicao de origem.
+ * @param j A janela.
+ * @param terreno Se so os obstaculos bloqueiam.
+ * @param dst Onde guardar as casas.
+ * @returns O numero de casas, sem ter em conta o que as ocupa.
+ */
+size_t pospos_xadrez_rainha (const estado_p e, posicao_s o, const janela * j, bool terreno, posicao_p dst)
+{
+	size_t ret = pospos_deslizante(e, o, j, terreno, direccoes_ortogonais, 4, dst);
+	return ret + pospos_deslizante(e, o, j, terreno, direccoes_diagonais, 4, dst + ret);
+}
+
+/**
+ * @brief Calcula as casas para onde o tipo de movimento damas pode ir.
+ *
+ * Uma casa na diagonal, ou duas se saltar por cima de uma casa ocupada.
+ * @param e O estado actual.
+ * @param o Posicao de origem.
+ * @param j A janela.
+ * @param terreno Se so os obstaculos bloqueiam.
+ * @param dst Onde guardar as casas.
+ * @returns O numero de casas, sem ter em conta o que as ocupa.
+ */
+size_t pospos_damas (const estado_p e, posicao_s o, const janela * j, bool terreno, posicao_p dst)
+{
+	/*
+	 *    2 1 0 1 2
+	 * 2 |S| | | |S|
+	 *   -----------
+	 * 1 | |X| |X| |
+	 *   -----------
+	 * 0 | | |J| | |
+	 *   -----------
+	 * 1 | |X| |X| |
+	 *   -----------
+	 * 2 |S| | | |S|
+	 */
+	assert(e != NULL);
+	assert(posicao_valida(o, e->tam));
 
-	posicao_p ret = (posicao_p) (arr + 1);
+	size_t ret = 0;
+	for (size_t i = 0; i < 4; i++) {
+		const deslocamento * d = direccoes + direccoes_diagonais[i];
+		long x = (long) o.x + d->dx;
+		long y = (long) o.y + d->dy;
 
-	/* calcula as posicoes possiveis pra certo mov_type */
-	uchar w = handlers[e->mov_type](ret, &o);
+		if (!janela_contem(j, x, y))
+			continue;
 
-	/* filtra as posicoes validas (i.e., dentro do mapa) */
-	w = pos_filter(ret, w, posicao_valida);
+		posicao_s meio = posicao_new(x, y);
+		dst[ret++] = meio;
 
-	/* filtra as posicoes que podem ser jogadas */
-	w = pospos_filter(e, ret, w, jogada_valida);
+		if (janela_contem(j, x + d->dx, y + d->dy) && pospos_bloqueia(e, meio, terreno))
+			dst[ret++] = posicao_new(x + d->dx, y + d->dy);
+	}
 
-	quantas_jogadas(ret) = w;
+	return ret;
+}
+
+/**
+ * @brief Tipo de funcoes que calculam as casas para onde um tipo de movimento pode ir.
+ */
+typedef size_t (* pospos_handler) (const estado_p e, posicao_s o, const janela * j, bool terreno, posicao_p dst);
 
+/**
+ * @brief Devolve um array de apontadores para funcoes que calculam posicoes possiveis.
+ * @returns Array de apontadores de funcoes.
+ */
+const pospos_handler * pospos_handlers (void)
+{
+	static const pospos_handler ret[MOV_TYPE_QUANTOS] = {
+		[MOV_TYPE_XADREZ_REI]    = pospos_xadrez_rei,
+		[MOV_TYPE_XADREZ_CAVALO] = pospos_xadrez_cavalo,
+		[MOV_TYPE_XADREZ_PEAO]   = pospos_xadrez_peao,
+		[MOV_TYPE_XADREZ_TORRE]  = pospos_xadrez_torre,
+		[MOV_TYPE_XADREZ_BISPO]  = pospos_xadrez_bispo,
+		[MOV_TYPE_XADREZ_RAINHA] = pospos_xadrez_rainha,
+		[MOV_TYPE_DAMAS]         = pospos_damas,
+	};
 	return ret;
-#undef SIZE
+}
+
+size_t posicoes_possiveis (const estado_p e, posicao_s o, const janela * j, bool inimigo, posicao_p dst)
+{
+	assert(e != NULL);
+	assert(e->mov_type < MOV_TYPE_QUANTOS);
+	assert(posicao_valida(o, e->tam));
+	assert(j != NULL);
+	assert(dst != NULL);
+
+	const pospos_handler * handlers = pospos_handlers();
+	assert(handlers != NULL);
+
+	/* as casas para onde o mov_type pode ir, ja dentro da janela */
+	size_t n = handlers[e->mov_type](e, o, j, false, dst);
+	assert(n <= NJOGADAS(e->tam));
+
+	size_t w = 0;
+	for (size_t i = 0; i < n; i++)
+		if (!BB_TESTA(e->bb_obstaculos, dst[i])
+		    && !(inimigo && BB_TESTA(e->bb_inimigos, dst[i])))
+			dst[w++] = dst[i];
+
+	return w;
 }
 
 accao_s accao_new (const char * nome, enum accao accao, posicao_s jog, posicao_s dest)
@@ -213,45 +693,59 @@ accao_s accao_new (const char * nome, enum accao accao, posicao_s jog, posicao_s
 	return ret;
 }
 
-char * accao2str (accao_s accao)
+/**
+ * @brief Escreve um numero em hexadecimal, com um numero fixo de digitos, seguido de um separador.
+ * @param dst Onde escrever.
+ * @param n O numero.
+ * @param digitos O numero de digitos.
+ * @param sep O separador.
+ * @returns O fim do que foi escrito.
+ */
+char * accao_link_hex (char * dst, unsigned n, size_t digitos, char sep)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	for (size_t i = digitos; i > 0; i--, n >>= 4)
+		dst[i - 1] = hex[n & 0xf];
+	dst[digitos] = sep;
+
+	return dst + digitos + 1;
+}
+
+char * accao_link (accao_s accao, char * dst)
 {
 	assert(accao.nome != NULL);
 	assert(accao.accao < ACCAO_INVALID);
+	assert(dst != NULL);
 
-	static char ret[JOGADA_LINK_MAX_BUFFER] = "";
-	memset(ret, 0, JOGADA_LINK_MAX_BUFFER);
-	sprintf(ret,
-		"%s,"
-		"%08x,"
-		"%02hhx,"
-		"%02hhx,"
-		"%02hhx,"
-		"%02hhx",
-		accao.nome,
-		accao.accao,
-		accao.jog.x,
-		accao.jog.y,
-		accao.dest.x,
-		accao.dest.y
-	       );
-	return ret;
+	/* o mesmo que "%s,%08x,%04hx,%04hx,%04hx,%04hx", sem `snprintf` */
+	size_t len = strnlen(accao.nome, sizeof(accao.nome) - 1);
+	memcpy(dst, accao.nome, len);
+
+	char * p = dst + len;
+	*p++ = ',';
+	p = accao_link_hex(p, accao.accao, 8, ',');
+	p = accao_link_hex(p, accao.jog.x, 4, ',');
+	p = accao_link_hex(p, accao.jog.y, 4, ',');
+	p = accao_link_hex(p, accao.dest.x, 4, ',');
+	p = accao_link_hex(p, accao.dest.y, 4, '\0');
+
+	assert((size_t) (p - dst) <= JOGADA_LINK_MAX_BUFFER);
+	return dst;
 }
 
 accao_s str2accao (const char * str)
 {
 	assert(str != NULL);
 	accao_s ret = { 0 };
-#ifdef NDEBUG
-	sscanf(str,
-#else
+	/* a largura e um maximo: os links antigos, com 2 digitos, tambem servem */
 	int r = sscanf(str,
-#endif
-	       "%[^,],"
+	       "%10[^,],"
 	       "%08x,"
-	       "%02hhx,"
-	       "%02hhx,"
-	       "%02hhx,"
-	       "%02hhx",
+	       "%04hx,"
+	       "%04hx,"
+	       "%04hx,"
+	       "%04hx",
 	       ret.nome,
 	       &ret.accao,
 	       &ret.jog.x,
@@ -259,46 +753,44 @@ accao_s str2accao (const char * str)
 	       &ret.dest.x,
 	       &ret.dest.y
 	      );
-	assert(r == 6);
+
+	/* um link mal formado chega de qualquer cliente */
+	if (r != 6 || ret.accao > ACCAO_INVALID)
+		ret.accao = ACCAO_INVALID;
+
 	return ret;
 }
 
-/**
- * @def SIZE
- * @brief Tamanho maximo, em bytes, das jogadas possiveis.
- */
-
-jogada_p jogadas_possiveis (const estado_p e)
+size_t jogadas_possiveis (const estado_p e, jogada_p dst)
 {
 	assert(e != NULL);
 	assert(e->nome != NULL);
 	assert(e->mov_type < MOV_TYPE_QUANTOS);
+	assert(dst != NULL);
 
-	/*
-	 * [0] uchar => quantas jogadas possiveis existem
-	 * [1] jogada_s
-	 * ..
-	 * [N] jogada_s
-	 */
-#define SIZE (1 + (sizeof(jogada_s) * NJOGADAS))
-	static uchar arr[SIZE] = "";
-	memset(arr, 0, SIZE);
-
-	posicao_p pos = posicoes_possiveis(e, e->jog.pos);
-	assert(pos != NULL);
+	posicao_p pos = malloc(NJOGADAS(e->tam) * sizeof(posicao_s));
+	check(pos == NULL, "could not allocate moves");
 
-	jogada_p ret = (jogada_p) (arr + 1);
-	uchar w = quantas_jogadas(ret) = quantas_jogadas(pos);
+	janela j = janela_tabuleiro(e);
+	size_t n = posicoes_possiveis(e, e->jog.pos, &j, false, pos);
 
-	for (size_t i = 0; i < w; i++) {
-		char * link = accao2str(accao_new(e->nome, ACCAO_MOVE, e->jog.pos, pos[i]));
-		assert(link != NULL);
-		strcpy(ret[i].link, link);
-		ret[i].dest = pos[i];
+	/* os links sao escritos directamente nas jogadas, sem copias */
+	for (size_t i = 0; i < n; i++) {
+		accao_link(accao_new(e->nome, ACCAO_MOVE, e->jog.pos, pos[i]), dst[i].link);
+		dst[i].dest = pos[i];
 	}
 
+	free(pos);
+	return n;
+}
+
+jogada_p aloca_jogadas (const estado_p e)
+{
+	assert(e != NULL);
+
+	jogada_p ret = malloc(NJOGADAS(e->tam) * sizeof(jogada_s));
+	check(ret == NULL, "could not allocate moves");
 	return ret;
-#undef SIZE
 }
 
 /**
@@ -312,7 +804,11 @@ estado_s accao_reset_handler (estado_s e, accao_s accao)
 	UNUSED(accao);
 	assert(e.nome != NULL);
 	assert(accao.accao == ACCAO_RESET);
-	return init_estado(0, 0, MOV_TYPE_QUANTOS, e.nome);
+
+	estado_s ret = init_estado(e.tam, 0, 0, MOV_TYPE_QUANTOS, e.nome, aleatorio_proximo(&e.gerador));
+	estado_liberta(&e);
+
+	return ret;
 }
 
 /**
@@ -333,9 +829,12 @@ estado_s accao_move_handler (estado_s ret, accao_s accao)
 	 * nao faz nada
 	 */
 	ifjmp(!posicao_igual(accao.jog, ret.jog.pos), out);
-	ifjmp(!posicao_valida(accao.dest), out);
+	ifjmp(!posicao_valida(accao.dest, ret.tam), out);
 
-	size_t i = pos_inimigos_ind(ret.inimigo, accao.dest, ret.num_inimigos);
+	/* so procura o inimigo se a casa estiver ocupada por algum */
+	size_t i = (BB_TESTA(ret.bb_inimigos, accao.dest)) ?
+		entidade_procura(ret.inimigo, &ret.grelha_inimigos, accao.dest, ret.num_inimigos) :
+		ret.num_inimigos;
 
 	ret = (i < ret.num_inimigos) ? /* se tiver inimigo */
 		ataca_inimigo(ret, i) :
@@ -344,8 +843,12 @@ estado_s accao_move_handler (estado_s ret, accao_s accao)
 	if (ret.matou)
 		ret = move_jogador(ret, accao.dest);
 
-	if (fim_de_ronda(&ret) && posicao_igual(ret.jog.pos, ret.porta))
-		ret = init_estado(ret.nivel, (ret.score + (ret.jog.vida / 5)), ret.mov_type, ret.nome);
+	if (fim_de_ronda(&ret) && posicao_igual(ret.jog.pos, ret.porta)) {
+		estado_s novo = init_estado(ret.tam, ret.nivel, (ret.score + (ret.jog.vida / 5)), ret.mov_type, ret.nome,
+					    aleatorio_proximo(&ret.gerador));
+		estado_liberta(&ret);
+		ret = novo;
+	}
 
 out:
 	return ret;
@@ -367,8 +870,9 @@ estado_s accao_change_mt_handler (estado_s ret, accao_s accao)
 {
 	assert(ret.nome != NULL);
 	assert(accao.accao == ACCAO_CHANGE_MT);
-	assert(accao.dest.x < MOV_TYPE_QUANTOS);
 
+	/* os links podem ser escritos a mao por um cliente da API */
+	ifjmp(accao.dest.x >= MOV_TYPE_QUANTOS, out);
 	ifjmp(!posicao_igual(ret.jog.pos, accao.jog), out);
 
 	ret.mov_type = accao.dest.x;
@@ -412,12 +916,6 @@ const accao_handler * accao_handlers (void)
 	return ret;
 }
 
-/**
- * @brief Calcula o novo estado de acordo com a accao recebida.
- * @param ret O estado actual.
- * @param accao A accao.
- * @returns O novo estado.
- */
 estado_s corre_accao (estado_s ret, accao_s accao)
 {
 	ifjmp(accao.accao >= ACCAO_INVALID, out);
@@ -428,154 +926,190 @@ out:
 	return ret;
 }
 
-/**
- * @brief Actualiza o estado depois de jogar com o bot de indice I.
- * @param ret O estado actual.
- * @param I O indice do bot a jogar.
- * @returns O novo estado.
- */
-estado_s bot_joga_aux (estado_s ret, size_t I)
+bool accao_nula (const estado_p e, accao_s accao)
 {
-	posicao_p posicoes = posicoes_possiveis(&ret, ret.inimigo[I].pos);
-	assert(posicoes != NULL);
-	/* se nao houverem posicoes possiveis, nao faz nada */
-	ifjmp(quantas_jogadas(posicoes) == 0, out);
-
-	quantas_jogadas(posicoes) = pospos_filter(&ret, posicoes, quantas_jogadas(posicoes), nao_tem_inimigos);
-	/* se nao houverem posicoes possiveis, nao faz nada */
-	ifjmp(quantas_jogadas(posicoes) == 0, out);
-
-	size_t mp = pos_mais_perto(posicoes, quantas_jogadas(posicoes), ret.jog.pos);
-
-	ifjmp(mp >= quantas_jogadas(posicoes), out);
-
-	posicao_s p = posicoes[mp];
+	assert(e != NULL);
 
-	/*
-	 * se a posicao mais prox do jog for igual a do jog
-	 * ataca o jog, senao move
-	 */
-	if (posicao_igual(ret.jog.pos, p))
-		ret = ataca_jogador(&ret, I);
-	else
-		ret.inimigo[I].pos = p;
+	bool ret = false;
+
+	/* o fim de jogo comeca um jogo novo, seja qual for a accao */
+	ifjmp(fim_de_jogo(e), out);
+
+	switch (accao.accao) {
+	case ACCAO_RESET:
+		break;
+	case ACCAO_MOVE:
+		ret = !posicao_igual(accao.jog, e->jog.pos) || !posicao_valida(accao.dest, e->tam);
+		break;
+	case ACCAO_CHANGE_MT:
+		ret = !posicao_igual(accao.jog, e->jog.pos) || accao.dest.x >= MOV_TYPE_QUANTOS;
+		break;
+	default:
+		ret = true;
+		break;
+	}
 
 out:
 	return ret;
 }
 
 /**
- * @brief Calcula o novo estado depois de todos os bots jogarem.
- * @param ret O estado actual.
- * @returns O novo estado.
+ * @brief Distancia de uma casa de onde nao se consegue chegar ao jogador.
  */
-estado_s bot_joga (estado_s ret)
-{
-	assert(ret.nome != NULL);
-
-	for (size_t i = 0; i < ret.num_inimigos && !fim_de_jogo(&ret); i++)
-		ret = bot_joga_aux(ret, i);
+#define DIST_INFINITA	UINT16_MAX
 
-	return ret;
-}
+/**
+ * @brief O campo de distancias ate ao jogador, numa janela a volta dele.
+ */
+typedef struct {
+	/** A janela, com no maximo `CAMPO_TAM` por `CAMPO_TAM` casas. */
+	janela j;
+	/** As distancias, indexadas por `campo_indice()`. */
+	uint16_t dist[CAMPO_TAM * CAMPO_TAM];
+} campo;
 
-char * pathname (const char * name)
+/**
+ * @brief Calcula o indice de uma casa da janela de um campo.
+ * @param c O campo.
+ * @param p A casa, dentro da janela.
+ * @returns O indice.
+ */
+size_t campo_indice (const campo * c, posicao_s p)
 {
-	static char ret[11 + 20] = "";
-	sprintf(ret, BASE_PATH "%s", name);
-	return ret;
+	return ((size_t) (p.y - c->j.min.y) * CAMPO_TAM) + (p.x - c->j.min.x);
 }
 
-estado_s ler_estado (accao_s accao)
+/**
+ * @brief Calcula, para cada casa perto do jogador, o numero de jogadas ate ele.
+ *
+ * Uma pesquisa em largura a partir do jogador, com o tipo de movimento
+ * actual, dentro de uma janela de `CAMPO_TAM` por `CAMPO_TAM` casas; num
+ * tabuleiro grande nao se visita o tabuleiro todo. Todos os tipos de
+ * movimento sao simetricos, logo as jogadas que saem de uma casa sao as que
+ * chegam a ela. So os obstaculos bloqueiam: os inimigos mexem-se durante a
+ * ronda.
+ * @param e O estado actual.
+ * @param c Onde guardar o campo.
+ */
+void campo_distancias (const estado_p e, campo * c)
 {
-	assert(accao.nome != NULL);
-	assert(accao.accao < ACCAO_INVALID);
-
-	estado_s ret = { 0 };
-
-	char * path = pathname(accao.nome);
-	assert(path != NULL);
+	assert(e != NULL);
+	assert(c != NULL);
 
-	FILE * f = fopen(path, "rb");
+	const pospos_handler * handlers = pospos_handlers();
+	posicao_s viz[NPOSICOES_JANELA(CAMPO_TAM)];
+	posicao_s fila[CAMPO_TAM * CAMPO_TAM];
+	size_t ini = 0;
+	size_t fim = 0;
+
+	c->j = janela_em_volta(e, e->jog.pos, CAMPO_TAM);
+	for (size_t i = 0; i < CAMPO_TAM * CAMPO_TAM; i++)
+		c->dist[i] = DIST_INFINITA;
+
+	fila[fim++] = e->jog.pos;
+	c->dist[campo_indice(c, e->jog.pos)] = 0;
+
+	while (ini < fim) {
+		posicao_s p = fila[ini++];
+		uint16_t d = c->dist[campo_indice(c, p)] + 1;
+		size_t n = handlers[e->mov_type](e, p, &c->j, true, viz);
+		assert(n <= sizeof(viz) / sizeof(*viz));
+
+		for (size_t i = 0; i < n; i++) {
+			size_t k = campo_indice(c, viz[i]);
+			if (c->dist[k] != DIST_INFINITA || BB_TESTA(e->bb_obstaculos, viz[i]))
+				continue;
+			c->dist[k] = d;
+			fila[fim++] = viz[i];
+		}
+	}
+}
 
-	check(f == NULL, "could not open state file to read");
+/**
+ * @brief Actualiza o estado depois de jogar com o bot de indice I.
+ *
+ * O bot desce no campo de distancias: vai para a casa possivel mais perto
+ * do jogador, em jogadas, e so se ficar mais perto do que esta. Entre casas
+ * a mesma distancia escolhe a mais perto em linha recta.
+ * @param ret O estado actual.
+ * @param I O indice do bot a jogar, que esta dentro da janela do campo.
+ * @param c O campo de distancias ate ao jogador.
+ * @returns O novo estado.
+ */
+estado_s bot_joga_aux (estado_s ret, size_t I, const campo * c)
+{
+	/* os inimigos nao podem ir para cima de obstaculos nem de outros inimigos */
+	posicao_s posicoes[NPOSICOES_JANELA(CAMPO_TAM)];
+	size_t n = posicoes_possiveis(&ret, ret.inimigo[I].pos, &c->j, true, posicoes);
+
+	/* fica so com as posicoes mais perto do jogador */
+	uint16_t actual = c->dist[campo_indice(c, ret.inimigo[I].pos)];
+	uint16_t melhor = actual;
+	size_t w = 0;
+	for (size_t r = 0; r < n; r++) {
+		uint16_t d = c->dist[campo_indice(c, posicoes[r])];
+		if (d < melhor) {
+			melhor = d;
+			w = 0;
+		}
+		if (d == melhor && d < actual)
+			posicoes[w++] = posicoes[r];
+	}
 
-	check(fread(&ret, sizeof(estado_s), 1, f) != 1,
-	      "could not read from state file");
+	/* se nenhuma posicao o aproximar do jogador, nao faz nada */
+	ifjmp(w == 0, out);
 
-	fclose(f);
+	posicao_s p = posicoes[pos_mais_perto(posicoes, w, ret.jog.pos)];
 
-	if (fim_de_jogo(&ret)) {
-		ret = init_estado(0, 0, MOV_TYPE_QUANTOS, ret.nome);
+	/*
+	 * se a posicao mais prox do jog for igual a do jog
+	 * ataca o jog, senao move
+	 */
+	if (posicao_igual(ret.jog.pos, p)) {
+		ret = ataca_jogador(&ret, I);
 	} else {
-		ret = corre_accao(ret, accao);
-		ret = bot_joga(ret);
+		ret = move_inimigo(ret, I, p);
 	}
 
+out:
 	return ret;
 }
 
-void escreve_estado (const estado_p e)
+estado_s bot_joga (estado_s ret)
 {
-	assert(e != NULL);
-	assert(e->nome != NULL);
-
-	char * path = pathname(e->nome);
-	assert(path != NULL);
+	assert(ret.nome != NULL);
 
-	FILE * f = fopen(path, "wb");
+	/* o jogador nao se mexe durante a ronda dos bots, logo o campo serve a todos */
+	campo c;
+	campo_distancias(&ret, &c);
 
-	check(f == NULL, "could not open state file to write");
+	/*
+	 * os bots so se mexem dentro da janela e nenhum morre na sua ronda,
+	 * logo os indices recolhidos antes da ronda continuam validos
+	 */
+	size_t bots[CAMPO_TAM * CAMPO_TAM];
+	size_t n = entidades_recolhe(ret.inimigo, &ret.grelha_inimigos, c.j.min, c.j.max, bots);
 
-	check(fwrite(e, sizeof(estado_s), 1, f) != 1,
-	      "could not write to state file");
+	for (size_t i = 0; i < n && !fim_de_jogo(&ret); i++)
+		ret = bot_joga_aux(ret, bots[i], &c);
 
-	fclose(f);
+	return ret;
 }
 
-void update_highscore (const estado_p e, struct highscore hs[3])
+estado_s joga (estado_s ret, accao_s accao)
 {
-	assert(e != NULL);
-	assert(e->nome != NULL);
-	assert(fim_de_jogo(e));
-	assert(hs != NULL);
-
-	size_t i = 0;
-	for (i = 0; i < 3 && e->score < hs[i].score; i++);
+	/* um nivel novo comeca no turno 0, mas o turno conta desde o inicio do jogo */
+	uint32_t turno = ret.turno;
 
-	if (i < 3) {
-		hs[i].score = e->score;
-		strcpy(hs[i].nome, e->nome);
+	if (fim_de_jogo(&ret)) {
+		estado_s novo = init_estado(ret.tam, 0, 0, MOV_TYPE_QUANTOS, ret.nome, aleatorio_proximo(&ret.gerador));
+		estado_liberta(&ret);
+		ret = novo;
+	} else {
+		ret = corre_accao(ret, accao);
+		ret = bot_joga(ret);
 	}
-}
-
-void escreve_highscore (struct highscore hs[3])
-{
-	assert(hs != NULL);
-	FILE * f = fopen(SCOREFILE_PATH, "wb");
-
-	check(f == NULL,
-	      "could not open highscore file to write");
-
-	check(fwrite(hs, sizeof(struct highscore), 3, f) != 3,
-	      "could not write to highscore file");
-
-	fclose(f);
-}
-
-struct highscore * ler_highscore (void)
-{
-	static struct highscore ret[3] = {0};
-	FILE * f = fopen(SCOREFILE_PATH, "rb");
-
-	check(f == NULL,
-	      "could not open highscore file to read");
-
-	memset(ret, 0, 3 * sizeof(struct highscore));
-	int n = fread(ret, sizeof(struct highscore), 3, f);
-	UNUSED(n);
-
-	ifnnull(f, fclose);
 
+	ret.turno = turno + 1;
 	return ret;
 }
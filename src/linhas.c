@@ -0,0 +1,142 @@
+/** @file */
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "posicao.h"
+#include "entidades.h"
+
+#include "linhas.h"
+
+void linhas_init (linhas * l, posicao_s tam)
+{
+	assert(l != NULL);
+
+	l->w = calloc(LINHAS_ARRUMACOES_QUANTAS * BB_PALAVRAS(tam), sizeof(uint64_t));
+	check(l->w == NULL, "could not allocate lines");
+	l->tam = tam;
+}
+
+void linhas_liberta (linhas * l)
+{
+	assert(l != NULL);
+
+	free(l->w);
+	l->w = NULL;
+}
+
+/**
+ * @brief Calcula o bit de uma posicao em cada arrumacao, contado desde o inicio dos bits.
+ * @param l O conjunto.
+ * @param p A posicao, dentro do tabuleiro.
+ * @param bits Onde guardar os `LINHAS_ARRUMACOES_QUANTAS` bits.
+ */
+void linhas_bits (const linhas * l, posicao_s p, size_t * bits)
+{
+	size_t L = l->tam.x;
+	size_t A = l->tam.y;
+	size_t n = BB_PALAVRAS(l->tam) << 6;
+	/* so e preciso dividir se o tabuleiro for mais largo do que alto */
+	size_t x = (p.x < A) ? p.x : p.x % A;
+	size_t d = p.y + A - x;
+	size_t s = p.y + x;
+
+	bits[LINHAS_COLUNAS] = (p.x * A) + p.y;
+	bits[LINHAS_DIAGONAIS] = n + (((d < A) ? d : d - A) * L) + p.x;
+	bits[LINHAS_ANTIDIAGONAIS] = (2 * n) + (((s < A) ? s : s - A) * L) + p.x;
+}
+
+size_t linhas_indice (const linhas * l, enum linhas_arrumacao a, posicao_s p)
+{
+	assert(l != NULL);
+	assert(a < LINHAS_ARRUMACOES_QUANTAS);
+
+	size_t bits[LINHAS_ARRUMACOES_QUANTAS];
+	linhas_bits(l, p, bits);
+	return bits[a] - ((a * BB_PALAVRAS(l->tam)) << 6);
+}
+
+void linhas_liga (linhas * l, posicao_s p)
+{
+	assert(l != NULL);
+	ifjmp(l->w == NULL, out);
+
+	size_t bits[LINHAS_ARRUMACOES_QUANTAS];
+	linhas_bits(l, p, bits);
+	for (size_t a = 0; a < LINHAS_ARRUMACOES_QUANTAS; a++)
+		l->w[bits[a] >> 6] |= ((uint64_t) 1) << (bits[a] & 63);
+out:
+	return;
+}
+
+void linhas_marca (linhas * l, const entidades p, size_t N)
+{
+	assert(l != NULL);
+	assert(p != NULL || N == 0);
+	ifjmp(l->w == NULL, out);
+
+	for (size_t i = 0; i < N; i++)
+		linhas_liga(l, p[i].pos);
+out:
+	return;
+}
+
+void linhas_desliga (linhas * l, posicao_s p)
+{
+	assert(l != NULL);
+	ifjmp(l->w == NULL, out);
+
+	size_t bits[LINHAS_ARRUMACOES_QUANTAS];
+	linhas_bits(l, p, bits);
+	for (size_t a = 0; a < LINHAS_ARRUMACOES_QUANTAS; a++)
+		l->w[bits[a] >> 6] &= ~(((uint64_t) 1) << (bits[a] & 63));
+out:
+	return;
+}
+
+/**
+ * @brief Junta a mesma palavra de varios arrays.
+ * @param w Os arrays de palavras.
+ * @param nw O numero de arrays.
+ * @param k O indice da palavra.
+ * @returns A uniao das palavras.
+ */
+uint64_t linhas_palavra (const uint64_t * const * w, size_t nw, size_t k)
+{
+	uint64_t ret = 0;
+	for (size_t a = 0; a < nw; a++)
+		ret |= w[a][k];
+	return ret;
+}
+
+size_t linhas_procura (const uint64_t * const * w, size_t nw, size_t ini, size_t n, bool frente)
+{
+	assert(w != NULL);
+	assert(frente || n <= ini + 1);
+
+	if (frente) {
+		size_t fim = ini + n;
+		for (size_t i = ini; i < fim; i = ((i >> 6) + 1) << 6) {
+			uint64_t m = linhas_palavra(w, nw, i >> 6) & (~((uint64_t) 0) << (i & 63));
+			if (m != 0) {
+				size_t b = (i & ~((size_t) 63)) + __builtin_ctzll(m);
+				return (b < fim) ? b - ini : n;
+			}
+		}
+	} else {
+		/* de `ini` ate `fim`, inclusive, com `i` uma casa depois da proxima a ver */
+		size_t fim = ini + 1 - n;
+		for (size_t i = ini + 1; i > fim; i = (i - 1) & ~((size_t) 63)) {
+			size_t s = (i - 1) & 63;
+			uint64_t m = linhas_palavra(w, nw, (i - 1) >> 6)
+				& ((s == 63) ? ~((uint64_t) 0) : (((uint64_t) 1) << (s + 1)) - 1);
+			if (m != 0) {
+				size_t b = ((i - 1) & ~((size_t) 63)) + 63 - __builtin_clzll(m);
+				return (b >= fim) ? ini - b : n;
+			}
+		}
+	}
+
+	return n;
+}
@@ -3,41 +3,46 @@
  * # qq coisa aqui
  */
 #include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
-#include <fcntl.h>  /* `open()` */
-#include <unistd.h> /* `access()` */
+#include <unistd.h>
 
 #include "check.h"
+#include "aleatorio.h"
+#include "api.h"
+#include "armazem.h"
+#include "diario.h"
 #include "posicao.h"
 #include "estado.h"
 #include "html.h"
+#include "partida.h"
+#include "fcgi.h"
+#include "http.h"
+#include "saida.h"
+#include "sessao.h"
 
 /**
- * @brief Cria uma gamefile.
- * @param fname Nome do jogador/ficheiro.
+ * @brief Cria o estado de um jogador novo.
+ * @param fname Nome do jogador.
+ * @param tam As dimensoes do tabuleiro.
  */
-void create_gamefile (const char * fname)
+void create_gamefile (const char * fname, posicao_s tam)
 {
 	assert(fname != NULL);
 
-	char * path = pathname(fname);
-	assert(path != NULL);
+	/* if the player already exists, GTFO */
+	ifjmp(existe_estado(fname), out);
 
-	/* if file exists and we can RW, GTFO */
-	ifjmp(access(path, F_OK | R_OK | W_OK) == 0, out);
-
-	int fd = open(path, O_CREAT | O_RDWR, 0666);
-	check(fd < 0, "could not create state file");
-
-	fd = close(fd);
-	check(fd < 0, "could not close state file");
-
-	estado_s e = init_estado(0, 0, MOV_TYPE_QUANTOS, fname);
+	uint64_t semente = aleatorio_semente();
+	estado_s e = init_estado(tam, 0, 0, MOV_TYPE_QUANTOS, fname, semente);
+	diario_inicia(fname, tam, 0, 0, MOV_TYPE_QUANTOS, semente);
 	escreve_estado(&e);
+	estado_liberta(&e);
 
 out:
 	return;
@@ -48,29 +53,127 @@ out:
  * @param args A `QUERY_STRING`
  * @returns Uma string com o nome do jogador
  */
-char * ler_nome (char * args)
+char * ler_nome (const char * args)
 {
 	assert(args != NULL);
 	static char ret[11] = "";
-	int read = sscanf(args, "nome=%s", ret);
+	int read = sscanf(args, "nome=%10[^&]", ret);
 	return (read == 1) ?
 		ret :
 		NULL;
 }
 
+/**
+ * @brief Limita um lado do tabuleiro a `[TAM_MIN, TAM_MAX]`
+ * @param n O tamanho pedido
+ * @returns O tamanho limitado
+ */
+unsigned long limita_tam (unsigned long n)
+{
+	return (n < TAM_MIN) ?
+		TAM_MIN :
+		(n > TAM_MAX) ?
+		TAM_MAX :
+		n;
+}
+
+/**
+ * @brief Le as dimensoes do tabuleiro da `QUERY_STRING`
+ *
+ * Aceita `tam=N`, para um tabuleiro de N por N, ou `tam=LxA`.
+ * @param args A `QUERY_STRING`
+ * @returns As dimensoes, ou `TAM` por `TAM` se nao forem dadas
+ */
+posicao_s ler_tam (const char * args)
+{
+	assert(args != NULL);
+
+	unsigned long l = TAM;
+	unsigned long a = TAM;
+	const char * tam = strstr(args, "&tam=");
+
+	if (tam != NULL && sscanf(tam, "&tam=%lux%lu", &l, &a) < 2)
+		a = l;
+
+	return posicao_new(limita_tam(l), limita_tam(a));
+}
+
+/**
+ * @brief Le o formato da resposta da `QUERY_STRING`
+ *
+ * Aceita `&api=json` ou `&api=bin`, depois do link de uma jogada ou do `nome=`.
+ * @param args A `QUERY_STRING`
+ * @returns O formato, ou `API_HTML` se nao for dado ou nao for conhecido
+ */
+enum api_formato ler_api (const char * args)
+{
+	assert(args != NULL);
+
+	const api_formato_s * formatos = api_formatos();
+	const char * api = strstr(args, "&api=");
+	enum api_formato ret = API_HTML;
+
+	ifjmp(api == NULL, out);
+	api += 5;
+
+	for (size_t i = 0; i < API_FORMATOS_QUANTOS; i++) {
+		size_t n = strlen(formatos[i].nome);
+		if (strncmp(api, formatos[i].nome, n) == 0 && (api[n] == '\0' || api[n] == '&'))
+			ret = i;
+	}
+
+out:
+	return ret;
+}
+
+/**
+ * @brief Le da `QUERY_STRING` o turno da ultima resposta que o cliente recebeu
+ * @param args A `QUERY_STRING`
+ * @param turno Onde guardar o turno
+ * @returns Verdadeiro se for dado `&turno=N`, falso caso contrario
+ */
+bool ler_turno (const char * args, uint32_t * turno)
+{
+	assert(args != NULL);
+	assert(turno != NULL);
+
+	const char * t = strstr(args, "&turno=");
+	return t != NULL && sscanf(t, "&turno=%" SCNu32, turno) == 1;
+}
+
+/**
+ * @brief Escreve o `ETag` da resposta com um estado, que muda sempre que o estado muda.
+ *
+ * O turno avanca em todas as jogadas e o gerador distingue os jogos do
+ * mesmo jogador. O `ETag` e fraco porque as cores das casas mudam em cada
+ * pagina.
+ * @param e O estado.
+ * @param api O formato da resposta.
+ * @param dst Onde escrever o `ETag`, com `SAIDA_ETAG_MAX` bytes.
+ */
+void estado_etag (const estado_p e, const api_formato_s * api, char * dst)
+{
+	assert(e != NULL);
+	assert(dst != NULL);
+
+	snprintf(dst, SAIDA_ETAG_MAX, "W/\"%" PRIx32 "-%08" PRIx32 "-%s\"",
+		 e->turno, (uint32_t) e->gerador.s[0], api->nome);
+}
+
 /**
  * @brief Imprime a pagina de login
  */
 void login (void)
 {
-	puts(
+	SAIDA_LITERAL(
 		"<body>\n"
-		"<form action=\"http://localhost/cgi-bin/rogue\" method=\"get\">\n"
+		"<form method=\"get\">\n"
 		"Nome do utilizador: <input type=\"text\" name=\"nome\"><br>\n"
+		"Tamanho do tabuleiro: <input type=\"text\" name=\"tam\" value=\"10\"><br>\n"
 		"<input type=\"submit\" value=\"login\">\n"
 		"</form>\n"
-		"</body>"
-	    );
+		"</body>\n"
+		);
 }
 
 /**
@@ -79,44 +182,48 @@ void login (void)
  */
 void print_highscore (const struct highscore * hs)
 {
-	puts("<table><tr><th>Jogador</th><th>Score</th></tr>");
-
-	for (size_t i = 0; i < 3; i++)
-		printf(
-			"<tr>"
-			"<td>%s</td>"
-			"<td>%hhu</td>"
-			"</tr>\n",
-			hs[i].nome,
-			hs[i].score
-		      );
-
-	puts("</table>");
+	SAIDA_LITERAL("<table><tr><th>Jogador</th><th>Score</th></tr>\n");
+
+	for (size_t i = 0; i < 3; i++) {
+		SAIDA_LITERAL("<tr><td>");
+		saida_str(hs[i].nome);
+		SAIDA_LITERAL("</td><td>");
+		saida_num(hs[i].score);
+		SAIDA_LITERAL("</td></tr>\n");
+	}
+
+	SAIDA_LITERAL("</table>\n");
 }
 
 /**
- * @brief O entry point do programa
- * @returns Codigo de sucesso
+ * @brief Responde a um pedido, escrevendo a pagina na saida
+ *
+ * Com `&api=` escreve o estado no formato pedido em vez da pagina e, com
+ * `&turno=`, so o que mudou desde esse turno. Se a accao nao fizer nada e
+ * o cliente ja tiver o estado, pelo `If-None-Match`, responde `304 Not
+ * Modified` sem guardar o estado nem escrever a pagina. Um link mal formado
+ * ou de um jogador sem estado recebe a pagina de login.
+ * @param qs A `QUERY_STRING` do pedido
  */
-int main (void)
+void responde (const char * qs)
 {
-	srand(time(NULL));
-	CONTENT_TYPE;
-
-	char * qs = getenv("QUERY_STRING");
-
 	if (qs == NULL || *qs == '\0')
 		login();
-	ifjmp(qs == NULL || *qs == '\0', ok);
+	ifjmp(qs == NULL || *qs == '\0', out);
 
 	bool is_nome = strncmp("nome=", qs, 5) == 0;
+	enum api_formato formato = ler_api(qs);
+	const api_formato_s * api = api_formatos() + formato;
+
+	uint32_t turno = 0;
+	bool delta = api->imprime_delta != NULL && ler_turno(qs, &turno);
 
 	char * nome = (is_nome) ?
 		ler_nome(qs) :
 		NULL;
 
 	if (is_nome)
-		create_gamefile(nome);
+		create_gamefile(nome, ler_tam(qs));
 
 	accao_s accao = (is_nome) ?
 		accao_new(nome,
@@ -125,19 +232,198 @@ int main (void)
 			  posicao_new(0, 0)) :
 		str2accao(qs);
 
-	estado_s e = ler_estado(accao);
+	estado_s antes = { 0 };
+	estado_s e = { 0 };
+	char etag[SAIDA_ETAG_MAX];
+
+	/* um link mal formado ou de um jogador que nao existe volta ao login */
+	if (accao.accao == ACCAO_INVALID || !estado_actual(accao.nome, &e)) {
+		login();
+		goto liberta;
+	}
+
+	/* a accao nao e executada nem vai para o diario: os bots tambem nao jogam */
+	estado_etag(&e, api, etag);
+	if (accao_nula(&e, accao) && saida_condicao_aceite(etag)) {
+		saida_muda_etag(etag);
+		saida_marca_nao_modificada();
+		goto liberta;
+	}
+
+	e = joga_estado(e, accao, (delta) ? &antes : NULL);
 	escreve_estado(&e);
 
 	if (fim_de_jogo(&e)) {
-		struct highscore * hs = ler_highscore();
+		struct highscore hs[3];
+		ler_highscore(hs);
 		update_highscore(&e, hs);
 		escreve_highscore(hs);
-		login();
-		print_highscore(hs);
+		if (formato == API_HTML) {
+			login();
+			print_highscore(hs);
+		}
 	}
 
-	imprime_jogo(&e);
+	estado_etag(&e, api, etag);
+	saida_muda_etag(etag);
+
+	/* se o cliente estiver atrasado ou o nivel tiver mudado vai o estado inteiro */
+	saida_muda_tipo(api->tipo);
+	if (delta && antes.turno == turno && api_mesmo_nivel(&e, &antes))
+		api->imprime_delta(&e, &antes);
+	else
+		api->imprime(&e);
+
+liberta:
+	estado_liberta(&e);
+	estado_liberta(&antes);
+
+out:
+	return;
+}
+
+/**
+ * @brief Responde a um unico pedido CGI, com um so `write()`.
+ * @param qs A `QUERY_STRING` do pedido
+ * @param ae O `Accept-Encoding` do pedido, ou `NULL`
+ * @param inm O `If-None-Match` do pedido, ou `NULL`
+ * @returns Codigo de sucesso
+ */
+int responde_cgi (const char * qs, const char * ae, const char * inm)
+{
+	char * buf = NULL;
+
+	saida_inicio(CONTENT_TYPE);
+	saida_condicao(inm, (inm != NULL) ? strlen(inm) : 0);
+	responde(qs);
+	size_t n = saida_fim_cgi(saida_codificacao_aceite(ae, (ae != NULL) ? strlen(ae) : 0),
+				 &buf);
+
+	for (ssize_t w = 0; n > 0; buf += w, n -= w) {
+		w = write(STDOUT_FILENO, buf, n);
+		if (w < 0 && errno == EINTR)
+			w = 0;
+		check(w < 0, "could not write response");
+	}
 
-ok:
 	return EXIT_SUCCESS;
 }
+
+/**
+ * @brief Reconstroi o estado de um jogador a partir do seu diario.
+ *
+ * Escreve no `stderr` quantas accoes foram executadas e quanto tempo
+ * demorou cada uma. Se o diario for repetido ate ao fim, compara o estado
+ * reconstruido com o guardado.
+ * @param nome Nome do jogador.
+ * @param max O numero maximo de accoes a executar.
+ * @returns Codigo de sucesso
+ */
+int replay (const char * nome, size_t max)
+{
+	assert(nome != NULL);
+
+	int ret = EXIT_FAILURE;
+	estado_s e;
+	estado_s guardado = { 0 };
+	struct timespec t0, t1;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	size_t n = repete_diario(nome, max, &e);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	if (e.tam.x == 0) {
+		fprintf(stderr, "%s: no valid journal\n", diario_path(nome));
+		goto out;
+	}
+
+	double ns = ((t1.tv_sec - t0.tv_sec) * 1e9) + (t1.tv_nsec - t0.tv_nsec);
+	fprintf(stderr, "%zu actions replayed, %.0f ns/action\n",
+		n, (n > 0) ? ns / n : ns);
+
+	ret = EXIT_SUCCESS;
+
+	if (max == SIZE_MAX && armazem_ler(nome, &guardado)) {
+
+		size_t tam = estado_tamanho(&e);
+		char * a = malloc(tam);
+		char * b = malloc(tam);
+		check(a == NULL || b == NULL, "could not allocate states");
+
+		bool igual = estado_tamanho(&guardado) == tam;
+		if (igual) {
+			estado_serializa(&e, a);
+			estado_serializa(&guardado, b);
+			igual = memcmp(a, b, tam) == 0;
+		}
+
+		fprintf(stderr, "replayed state %s the stored state\n",
+			(igual) ? "matches" : "differs from");
+		ret = (igual) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+		free(a);
+		free(b);
+	}
+
+	char * buf = NULL;
+	saida_inicio(CONTENT_TYPE);
+	imprime_jogo(&e);
+	size_t len = saida_fim(SAIDA_IDENTIDADE, &buf);
+	fwrite(buf, 1, len, stdout);
+
+out:
+	estado_liberta(&e);
+	estado_liberta(&guardado);
+	return ret;
+}
+
+/**
+ * @brief O entry point do programa
+ *
+ * Com `--importa [PASTA]` importa os ficheiros de estado de uma pasta
+ * para o ficheiro slab e sai.
+ * Com `--replay NOME [N]` reconstroi o estado de um jogador a partir do
+ * seu diario, executando no maximo `N` accoes, e escreve a pagina do
+ * estado reconstruido.
+ * Com `--serve PORTA [IMAGENS]` serve o jogo directamente por HTTP.
+ * Corre como worker FastCGI quando recebe `--fcgi` ou quando o `stdin`
+ * e um socket a escuta; caso contrario responde a um unico pedido CGI.
+ * @param argc Numero de argumentos
+ * @param argv Argumentos
+ * @returns Codigo de sucesso
+ */
+int main (int argc, char ** argv)
+{
+	if (argc > 1 && strcmp(argv[1], "--importa") == 0) {
+		size_t n = armazem_importa((argc > 2) ? argv[2] : armazem_pasta());
+		printf("%zu states imported into %s\n", n, armazem_slab_path());
+		return EXIT_SUCCESS;
+	}
+
+	if (argc > 2 && strcmp(argv[1], "--replay") == 0)
+		return replay(argv[2],
+			      (argc > 3) ? strtoull(argv[3], NULL, 10) : SIZE_MAX);
+
+	bool serve = argc > 2 && strcmp(argv[1], "--serve") == 0;
+	bool fcgi = !serve && ((argc > 1 && strcmp(argv[1], "--fcgi") == 0) || fcgi_e_fcgi());
+
+	/* so vale a pena manter estados e camadas em memoria num processo residente */
+	if (serve || fcgi) {
+		sessao_activa(SESSAO_CAPACIDADE,
+			      (armazem_durabilidade() == DURABILIDADE_GRUPO) ?
+			      armazem_grupo_ms() :
+			      SESSAO_FLUSH_MS);
+		html_camadas_activa();
+	}
+
+	if (serve)
+		return http_serve(atoi(argv[2]),
+				  (argc > 3) ? argv[3] : HTTP_IMAGENS,
+				  responde);
+
+	if (fcgi)
+		return fcgi_serve(responde);
+
+	return responde_cgi(getenv("QUERY_STRING"), getenv("HTTP_ACCEPT_ENCODING"),
+			    getenv("HTTP_IF_NONE_MATCH"));
+}
@@ -0,0 +1,153 @@
+/** @file */
+#include "check.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "armazem.h"
+#include "diario.h"
+#include "estado.h"
+#include "jogo.h"
+#include "sessao.h"
+
+#include "partida.h"
+
+bool estado_actual (const char * nome, estado_p e)
+{
+	assert(nome != NULL);
+	assert(e != NULL);
+
+	*e = (estado_s) { 0 };
+
+	if (!sessao_ler(nome, e))
+		return armazem_ler(nome, e);
+
+	return e->tam.x != 0;
+}
+
+estado_s joga_estado (estado_s e, accao_s accao, estado_p antes)
+{
+	assert(accao.nome != NULL);
+	assert(accao.accao < ACCAO_INVALID);
+
+	diario_acrescenta(&accao);
+
+	if (antes != NULL)
+		*antes = estado_copia(&e);
+
+	return joga(e, accao);
+}
+
+estado_s ler_estado (accao_s accao, estado_p antes)
+{
+	assert(accao.nome != NULL);
+
+	estado_s e;
+	check(!estado_actual(accao.nome, &e), "could not read state");
+
+	return joga_estado(e, accao, antes);
+}
+
+size_t repete_diario (const char * nome, size_t max, estado_p e)
+{
+	assert(nome != NULL);
+	assert(e != NULL);
+
+	size_t ret = 0;
+	diario_inicio inicio;
+	diario_accao r;
+	FILE * f = diario_abre(nome);
+	*e = (estado_s) { 0 };
+
+	ifjmp(f == NULL, out);
+	ifjmp(diario_le(f, &inicio, &r) != DIARIO_INICIO, out);
+
+	*e = init_estado(inicio.tam, inicio.nivel, inicio.score, inicio.mov_type, nome, inicio.semente);
+
+	while (ret < max && diario_le(f, &inicio, &r) == DIARIO_ACCAO) {
+		accao_s accao = {
+			.accao = r.accao,
+			.jog = r.jog,
+			.dest = r.dest,
+		};
+		strcpy(accao.nome, e->nome);
+
+		*e = joga(*e, accao);
+		ret++;
+	}
+
+out:
+	ifnnull(f, fclose);
+	return ret;
+}
+
+void escreve_estado (const estado_p e)
+{
+	assert(e != NULL);
+
+	if (!sessao_escreve(e))
+		armazem_escreve(e);
+}
+
+bool existe_estado (const char * nome)
+{
+	assert(nome != NULL);
+	return sessao_existe(nome) || armazem_existe(nome);
+}
+
+void update_highscore (const estado_p e, struct highscore hs[3])
+{
+	assert(e != NULL);
+	assert(e->nome != NULL);
+	assert(fim_de_jogo(e));
+	assert(hs != NULL);
+
+	size_t i = 0;
+	for (i = 0; i < 3 && e->score < hs[i].score; i++);
+
+	if (i < 3) {
+		hs[i].score = e->score;
+		strcpy(hs[i].nome, e->nome);
+	}
+}
+
+void escreve_highscore (struct highscore hs[3])
+{
+	assert(hs != NULL);
+	FILE * f = fopen(SCOREFILE_PATH, "wb");
+
+	check(f == NULL,
+	      "could not open highscore file to write");
+
+	check(fwrite(hs, sizeof(struct highscore), 3, f) != 3,
+	      "could not write to highscore file");
+
+	fclose(f);
+}
+
+void ler_highscore (struct highscore hs[3])
+{
+	assert(hs != NULL);
+	FILE * f = fopen(SCOREFILE_PATH, "rb");
+
+	check(f == NULL,
+	      "could not open highscore file to read");
+
+	uchar buf[3 * sizeof(struct highscore)] = {0};
+	size_t n = fread(buf, 1, sizeof(buf), f);
+
+	ifnnull(f, fclose);
+
+	memset(hs, 0, 3 * sizeof(struct highscore));
+
+	if (n == 3 * sizeof(struct highscore_v0)) {
+		const struct highscore_v0 * v = (const struct highscore_v0 *) buf;
+		for (size_t i = 0; i < 3; i++) {
+			memcpy(hs[i].nome, v[i].nome, sizeof(hs[i].nome));
+			hs[i].nome[sizeof(hs[i].nome) - 1] = '\0';
+			hs[i].score = v[i].score;
+		}
+	} else {
+		memcpy(hs, buf, n);
+	}
+}
@@ -5,13 +5,13 @@
 
 #include "posicao.h"
 
-bool posicao_valida (posicao_s p)
+bool posicao_valida (posicao_s p, posicao_s tam)
 {
 	/*
 	 * Como `abcissa` e `ordenada` sao inteiros sem
 	 * sinal, nao e preciso comparar com 0
 	 */
-	return p.x < TAM && p.y < TAM;
+	return p.x < tam.x && p.y < tam.y;
 }
 
 bool posicao_igual (posicao_s p1, posicao_s p2)
@@ -19,28 +19,6 @@ bool posicao_igual (posicao_s p1, posicao_s p2)
 	return p1.x == p2.x && p1.y == p2.y;
 }
 
-/**
- * @brief Filtra um array de posicoes.
- * @param p Um array de posicoes.
- * @param num O numero de posicoes no array.
- * @param f O predicado.
- * @returns O numero de posicoes que satisfizeram o predicado.
- */
-size_t pos_filter (posicao_p p, size_t num, bool (* f) (posicao_s))
-{
-	assert(p != NULL);
-	assert(num > 0);
-	assert(f != NULL);
-
-	size_t w = 0;
-
-	for (size_t r = 0; r < num; r++)
-		if (f(p[r]))
-			p[w++] = p[r];
-
-	return w;
-}
-
 /**
  * @brief Calcula o quadrado da distancia entre 2 posicoes.
  * @param p1 Uma posicao.
@@ -0,0 +1,474 @@
+/** @file */
+#include "check.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <zlib.h>
+
+#include "saida.h"
+
+/**
+ * @brief O buffer de saida de uma thread.
+ *
+ * Os primeiros `SAIDA_CABECALHOS` bytes ficam livres para os cabecalhos,
+ * que so se sabem no fim, para a resposta inteira ficar seguida.
+ */
+typedef struct {
+	/** Os bytes, com os cabecalhos reservados no inicio. */
+	char * buf;
+	/** O numero de bytes escritos, contando com os reservados. */
+	size_t n;
+	/** A capacidade do buffer. */
+	size_t cap;
+	/** O `Content-Type` da resposta. */
+	const char * tipo;
+} saida_buffer;
+
+/**
+ * @brief O buffer de saida desta thread.
+ */
+static _Thread_local saida_buffer saida = { 0 };
+
+/**
+ * @brief A validacao de uma resposta, pelo `ETag`.
+ */
+typedef struct {
+	/** O `If-None-Match` do pedido, vazio se nao tiver. */
+	char condicao[SAIDA_CONDICAO_MAX];
+	/** O `ETag` da resposta, vazio se nao tiver. */
+	char etag[SAIDA_ETAG_MAX];
+	/** Se a resposta e um `304 Not Modified`. */
+	bool nao_modificada;
+} saida_validacao;
+
+/**
+ * @brief A validacao da resposta actual desta thread.
+ */
+static _Thread_local saida_validacao saida_val = { 0 };
+
+/**
+ * @brief O buffer do corpo comprimido desta thread, com o mesmo espaco
+ * reservado para os cabecalhos.
+ */
+static _Thread_local saida_buffer saida_comprimida = { 0 };
+
+/**
+ * @brief Os compressores desta thread, um por codificacao, criados na
+ * primeira resposta que os usa e reutilizados nas seguintes.
+ */
+static _Thread_local z_stream saida_z[SAIDA_CODIFICACOES_QUANTAS];
+
+/**
+ * @brief Se cada compressor de `saida_z` ja foi criado.
+ */
+static _Thread_local bool saida_z_criado[SAIDA_CODIFICACOES_QUANTAS];
+
+/**
+ * @brief O nivel de compressao, o do zlib por omissao: com o nivel 1 uma
+ * pagina e comprimida em metade do tempo mas fica cerca de 15% maior.
+ */
+#define SAIDA_NIVEL	6
+
+/**
+ * @brief Os numeros de 00 a 99, dois digitos cada.
+ */
+static const char saida_pares[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/**
+ * @brief Garante que cabem mais `n` bytes num buffer de saida.
+ * @param b O buffer.
+ * @param n O numero de bytes.
+ */
+void saida_reserva (saida_buffer * b, size_t n)
+{
+	if (b->n + n <= b->cap)
+		return;
+
+	size_t cap = (b->cap > 0) ? b->cap : SAIDA_CAP;
+	while (b->n + n > cap)
+		cap <<= 1;
+
+	b->buf = realloc(b->buf, cap);
+	check(b->buf == NULL, "could not allocate output buffer");
+	b->cap = cap;
+}
+
+void saida_inicio (const char * tipo)
+{
+	assert(tipo != NULL);
+
+	saida.n = 0;
+	saida_reserva(&saida, SAIDA_CABECALHOS);
+	saida.n = SAIDA_CABECALHOS;
+	saida.tipo = tipo;
+
+	saida_val.condicao[0] = '\0';
+	saida_val.etag[0] = '\0';
+	saida_val.nao_modificada = false;
+}
+
+void saida_muda_tipo (const char * tipo)
+{
+	assert(tipo != NULL);
+	saida.tipo = tipo;
+}
+
+const char * saida_tipo (void)
+{
+	assert(saida.tipo != NULL);
+	return saida.tipo;
+}
+
+void saida_condicao (const char * s, size_t n)
+{
+	/* um `If-None-Match` grande demais e como se nao existisse */
+	if (s == NULL || n >= SAIDA_CONDICAO_MAX)
+		n = 0;
+	else
+		memcpy(saida_val.condicao, s, n);
+	saida_val.condicao[n] = '\0';
+}
+
+bool saida_condicao_aceite (const char * etag)
+{
+	assert(etag != NULL);
+
+	bool ret = false;
+	const char * s = saida_val.condicao;
+
+	/* a comparacao fraca ignora o `W/` dos dois lados */
+	if (strncmp(etag, "W/", 2) == 0)
+		etag += 2;
+	size_t len = strlen(etag);
+
+	while (*s != '\0' && !ret) {
+		while (*s == ',' || *s == ' ' || *s == '\t')
+			s++;
+		if (*s == '*') {
+			ret = true;
+			continue;
+		}
+		if (strncmp(s, "W/", 2) == 0)
+			s += 2;
+
+		/* as aspas delimitam o `ETag`, que pode ter virgulas */
+		const char * fim = (*s == '"') ? strchr(s + 1, '"') : NULL;
+		if (fim == NULL) {
+			while (*s != '\0' && *s != ',')
+				s++;
+			continue;
+		}
+
+		fim++;
+		ret = (size_t) (fim - s) == len && memcmp(s, etag, len) == 0;
+		s = fim;
+	}
+
+	return ret;
+}
+
+void saida_muda_etag (const char * etag)
+{
+	assert(etag != NULL);
+	assert(strlen(etag) < SAIDA_ETAG_MAX);
+	strcpy(saida_val.etag, etag);
+}
+
+const char * saida_etag (void)
+{
+	return (saida_val.etag[0] != '\0') ?
+		saida_val.etag :
+		NULL;
+}
+
+void saida_marca_nao_modificada (void)
+{
+	assert(saida_val.etag[0] != '\0');
+	saida_val.nao_modificada = true;
+}
+
+bool saida_nao_modificada (void)
+{
+	return saida_val.nao_modificada;
+}
+
+size_t saida_posicao (void)
+{
+	return saida.n;
+}
+
+const char * saida_desde (size_t pos, size_t * n)
+{
+	assert(n != NULL);
+	assert(pos >= SAIDA_CABECALHOS && pos <= saida.n);
+
+	*n = saida.n - pos;
+	return saida.buf + pos;
+}
+
+void saida_escreve (const void * buf, size_t n)
+{
+	assert(saida.n >= SAIDA_CABECALHOS);
+
+	if (saida.n + n > saida.cap)
+		saida_reserva(&saida, n);
+	memcpy(saida.buf + saida.n, buf, n);
+	saida.n += n;
+}
+
+void saida_str (const char * s)
+{
+	assert(s != NULL);
+	saida_escreve(s, strlen(s));
+}
+
+void saida_char (char c)
+{
+	saida_escreve(&c, 1);
+}
+
+void saida_num (unsigned long n)
+{
+	size_t digitos = 1;
+	for (unsigned long m = n; m >= 10; m /= 10)
+		digitos++;
+
+	if (saida.n + digitos > saida.cap)
+		saida_reserva(&saida, digitos);
+
+	/* escrito directamente no buffer, do fim para o inicio, dois digitos de cada vez */
+	char * p = saida.buf + saida.n + digitos;
+	saida.n += digitos;
+
+	while (n >= 100) {
+		p -= 2;
+		memcpy(p, saida_pares + ((n % 100) << 1), 2);
+		n /= 100;
+	}
+
+	if (n >= 10)
+		memcpy(p - 2, saida_pares + (n << 1), 2);
+	else
+		p[-1] = '0' + n;
+}
+
+const char * const * saida_codificacoes (void)
+{
+	static const char * const ret[SAIDA_CODIFICACOES_QUANTAS] = {
+		[SAIDA_IDENTIDADE] = "identity",
+		[SAIDA_GZIP]       = "gzip",
+		[SAIDA_DEFLATE]    = "deflate",
+	};
+	return ret;
+}
+
+/**
+ * @brief Le o `q` de uma codificacao do `Accept-Encoding`.
+ * @param s Os parametros da codificacao, depois do nome.
+ * @param fim O fim dos parametros.
+ * @returns O `q`, em milesimas; 1000 se nao for dado.
+ */
+unsigned saida_q (const char * s, const char * fim)
+{
+	unsigned ret = 1000;
+
+	while (s < fim) {
+		/* cada parametro comeca num `;` */
+		while (s < fim && *s != ';')
+			s++;
+		while (s < fim && (*s == ';' || *s == ' ' || *s == '\t'))
+			s++;
+		if (fim - s < 2 || (*s != 'q' && *s != 'Q') || s[1] != '=')
+			continue;
+
+		/* `q=0`, `q=0.5`, `q=1.000` */
+		s += 2;
+		ret = (s < fim && *s == '1') ? 1000 : 0;
+		if (s < fim)
+			s++;
+		if (s < fim && *s == '.')
+			for (unsigned m = 100, i = 1; i <= 3 && s + i < fim && s[i] >= '0' && s[i] <= '9'; m /= 10, i++)
+				ret += (s[i] - '0') * m;
+		if (ret > 1000)
+			ret = 1000;
+	}
+
+	return ret;
+}
+
+enum saida_codificacao saida_codificacao_aceite (const char * s, size_t n)
+{
+	const char * const * nomes = saida_codificacoes();
+	/* o `q` de cada codificacao, -1 se nao for referida */
+	int q[SAIDA_CODIFICACOES_QUANTAS];
+	int todas = -1;
+	enum saida_codificacao ret = SAIDA_IDENTIDADE;
+
+	for (size_t i = 0; i < SAIDA_CODIFICACOES_QUANTAS; i++)
+		q[i] = -1;
+
+	ifjmp(s == NULL, out);
+
+	for (const char * fim = s + n; s < fim; ) {
+		while (s < fim && (*s == ',' || *s == ' ' || *s == '\t'))
+			s++;
+
+		const char * nome = s;
+		while (s < fim && *s != ',' && *s != ';' && *s != ' ' && *s != '\t')
+			s++;
+		size_t len = s - nome;
+
+		const char * param = s;
+		while (s < fim && *s != ',')
+			s++;
+		int v = saida_q(param, s);
+
+		if (len == 1 && *nome == '*')
+			todas = v;
+		for (size_t i = 0; i < SAIDA_CODIFICACOES_QUANTAS; i++)
+			if (len == strlen(nomes[i]) && strncasecmp(nome, nomes[i], len) == 0)
+				q[i] = v;
+	}
+
+	/* as que nao sao referidas tem o `q` de `*` */
+	for (size_t i = 0; i < SAIDA_CODIFICACOES_QUANTAS; i++)
+		if (q[i] < 0)
+			q[i] = todas;
+
+	if (q[SAIDA_GZIP] > 0 && q[SAIDA_GZIP] >= q[SAIDA_DEFLATE])
+		ret = SAIDA_GZIP;
+	else if (q[SAIDA_DEFLATE] > 0)
+		ret = SAIDA_DEFLATE;
+
+out:
+	return ret;
+}
+
+/**
+ * @brief Comprime o corpo da resposta para o buffer do corpo comprimido.
+ * @param cod A codificacao, que nao pode ser `SAIDA_IDENTIDADE`.
+ * @param corpo O corpo.
+ * @param n O tamanho do corpo.
+ * @returns O tamanho do corpo comprimido.
+ */
+size_t saida_comprime (enum saida_codificacao cod, const char * corpo, size_t n)
+{
+	/* o gzip e o zlib so diferem no cabecalho que o zlib escreve */
+	static const int janela[SAIDA_CODIFICACOES_QUANTAS] = {
+		[SAIDA_GZIP]    = MAX_WBITS + 16,
+		[SAIDA_DEFLATE] = MAX_WBITS,
+	};
+
+	assert(cod != SAIDA_IDENTIDADE && cod < SAIDA_CODIFICACOES_QUANTAS);
+	assert(n <= UINT32_MAX);
+
+	z_stream * z = saida_z + cod;
+	if (!saida_z_criado[cod]) {
+		int r = deflateInit2(z, SAIDA_NIVEL, Z_DEFLATED, janela[cod], 8, Z_DEFAULT_STRATEGY);
+		check(r != Z_OK, "could not initialize compressor");
+		saida_z_criado[cod] = true;
+	} else {
+		deflateReset(z);
+	}
+
+	saida_comprimida.n = 0;
+	saida_reserva(&saida_comprimida, SAIDA_CABECALHOS + deflateBound(z, n));
+
+	z->next_in = (Bytef *) corpo;
+	z->avail_in = n;
+	z->next_out = (Bytef *) saida_comprimida.buf + SAIDA_CABECALHOS;
+	z->avail_out = saida_comprimida.cap - SAIDA_CABECALHOS;
+
+	/* com `deflateBound()` bytes livres, chega um so `deflate()` */
+	int r = deflate(z, Z_FINISH);
+	check(r != Z_STREAM_END, "could not compress response");
+
+	saida_comprimida.n = SAIDA_CABECALHOS + z->total_out;
+	return z->total_out;
+}
+
+size_t saida_fim (enum saida_codificacao cod, char ** buf)
+{
+	assert(buf != NULL);
+	assert(saida.n >= SAIDA_CABECALHOS);
+
+	*buf = saida.buf + SAIDA_CABECALHOS;
+	size_t ret = saida.n - SAIDA_CABECALHOS;
+
+	/* um `304 Not Modified` nao tem corpo */
+	if (saida_val.nao_modificada)
+		ret = 0;
+	else if (cod != SAIDA_IDENTIDADE) {
+		ret = saida_comprime(cod, *buf, ret);
+		*buf = saida_comprimida.buf + SAIDA_CABECALHOS;
+	}
+
+	return ret;
+}
+
+/**
+ * @brief Acrescenta um cabecalho, `nome: valor`, aos cabecalhos CGI de uma resposta.
+ * @param cab Os cabecalhos, com `SAIDA_CABECALHOS` bytes.
+ * @param len O tamanho dos cabecalhos ja escritos.
+ * @param nome O nome do cabecalho.
+ * @param valor O valor.
+ * @returns O novo tamanho dos cabecalhos.
+ */
+size_t saida_cabecalho (char * cab, size_t len, const char * nome, const char * valor)
+{
+	int n = snprintf(cab + len, SAIDA_CABECALHOS - len, "%s: %s\n", nome, valor);
+	check(n < 0 || (size_t) n >= SAIDA_CABECALHOS - len, "CGI headers too long");
+	return len + n;
+}
+
+size_t saida_fim_cgi (enum saida_codificacao cod, char ** buf)
+{
+	assert(buf != NULL);
+
+	char * corpo = NULL;
+	size_t n = saida_fim(cod, &corpo);
+
+	char cab[SAIDA_CABECALHOS];
+	size_t len = 0;
+
+	if (saida_val.nao_modificada) {
+		len = saida_cabecalho(cab, len, "Status", "304 Not Modified");
+	} else {
+		char tam[24];
+		snprintf(tam, sizeof(tam), "%zu", n);
+		len = saida_cabecalho(cab, len, "Content-Type", saida.tipo);
+		if (cod != SAIDA_IDENTIDADE)
+			len = saida_cabecalho(cab, len, "Content-Encoding", saida_codificacoes()[cod]);
+		len = saida_cabecalho(cab, len, "Content-Length", tam);
+	}
+
+	if (saida_val.etag[0] != '\0') {
+		len = saida_cabecalho(cab, len, "ETag", saida_val.etag);
+		len = saida_cabecalho(cab, len, "Cache-Control", "no-cache");
+	}
+
+	len = saida_cabecalho(cab, len, "Vary", "Accept-Encoding");
+	check(len + 1 >= SAIDA_CABECALHOS, "CGI headers too long");
+	cab[len++] = '\n';
+
+	/* os cabecalhos ficam mesmo antes do corpo */
+	*buf = corpo - len;
+	memcpy(*buf, cab, len);
+
+	return n + len;
+}
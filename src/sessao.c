@@ -0,0 +1,369 @@
+/** @file */
+#include "check.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "armazem.h"
+#include "diario.h"
+#include "estado.h"
+
+#include "sessao.h"
+
+/**
+ * @brief Indice que nao corresponde a nenhuma entrada.
+ */
+#define SESSAO_NENHUMA	SIZE_MAX
+
+/**
+ * @brief Uma entrada da cache.
+ */
+typedef struct {
+	/** O estado do jogador, uma copia que pertence a cache. */
+	estado_s e;
+	/** Se o estado foi alterado desde que foi escrito. */
+	bool suja;
+	/** Entrada usada mais recentemente que esta. */
+	size_t ant;
+	/** Entrada usada menos recentemente que esta. */
+	size_t seg;
+	/** Proxima entrada no mesmo balde da tabela de hash. */
+	size_t prox;
+} sessao_entrada;
+
+/**
+ * @brief A cache de estados: uma tabela de hash com uma lista LRU.
+ */
+typedef struct {
+	/** As entradas. */
+	sessao_entrada * entradas;
+	/** Numero maximo de entradas. */
+	size_t capacidade;
+	/** Numero de entradas usadas. */
+	size_t num;
+	/** Os baldes da tabela de hash. */
+	size_t * baldes;
+	/** Numero de baldes (potencia de 2). */
+	size_t num_baldes;
+	/** A entrada usada mais recentemente. */
+	size_t mais_recente;
+	/** A entrada usada menos recentemente. */
+	size_t menos_recente;
+	/** Buffer onde a thread de escrita copia os estados alterados. */
+	estado_s * lote;
+	/** Intervalo entre escritas, em milissegundos. */
+	unsigned flush_ms;
+	/** Protege a cache. */
+	pthread_mutex_t lock;
+	/** Serializa o acesso ao disco. */
+	pthread_mutex_t io;
+} sessao_cache;
+
+/**
+ * @brief A cache, inactiva ate `sessao_activa()`.
+ */
+sessao_cache sessao = {
+	.entradas = NULL,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.io = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/**
+ * @brief Calcula o hash (FNV-1a) do nome de um jogador.
+ * @param nome O nome.
+ * @returns O balde do nome.
+ */
+size_t sessao_balde (const char * nome)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (; *nome != '\0'; nome++)
+		h = (h ^ (uchar) *nome) * 0x100000001b3ULL;
+	return h & (sessao.num_baldes - 1);
+}
+
+/**
+ * @brief Procura a entrada de um jogador.
+ * @param nome O nome do jogador.
+ * @returns O indice da entrada, ou `SESSAO_NENHUMA`.
+ */
+size_t sessao_procura (const char * nome)
+{
+	size_t i = sessao.baldes[sessao_balde(nome)];
+	while (i != SESSAO_NENHUMA && strcmp(sessao.entradas[i].e.nome, nome) != 0)
+		i = sessao.entradas[i].prox;
+	return i;
+}
+
+/**
+ * @brief Tira uma entrada da lista LRU.
+ * @param i O indice da entrada.
+ */
+void sessao_lru_tira (size_t i)
+{
+	sessao_entrada * s = sessao.entradas + i;
+
+	if (s->ant != SESSAO_NENHUMA)
+		sessao.entradas[s->ant].seg = s->seg;
+	else
+		sessao.mais_recente = s->seg;
+
+	if (s->seg != SESSAO_NENHUMA)
+		sessao.entradas[s->seg].ant = s->ant;
+	else
+		sessao.menos_recente = s->ant;
+}
+
+/**
+ * @brief Poe uma entrada no inicio da lista LRU.
+ * @param i O indice da entrada.
+ */
+void sessao_lru_poe (size_t i)
+{
+	sessao_entrada * s = sessao.entradas + i;
+
+	s->ant = SESSAO_NENHUMA;
+	s->seg = sessao.mais_recente;
+
+	if (sessao.mais_recente != SESSAO_NENHUMA)
+		sessao.entradas[sessao.mais_recente].ant = i;
+	else
+		sessao.menos_recente = i;
+
+	sessao.mais_recente = i;
+}
+
+/**
+ * @brief Tira uma entrada da tabela de hash.
+ * @param i O indice da entrada.
+ */
+void sessao_hash_tira (size_t i)
+{
+	size_t * p = sessao.baldes + sessao_balde(sessao.entradas[i].e.nome);
+	while (*p != i)
+		p = &sessao.entradas[*p].prox;
+	*p = sessao.entradas[i].prox;
+}
+
+/**
+ * @brief Guarda um estado na cache.
+ * @param e O estado.
+ * @param suja Se o estado tem de ser escrito no disco.
+ */
+void sessao_insere (const estado_p e, bool suja)
+{
+	estado_s expulso = { 0 };
+	bool expulsou = false;
+	bool escrever = false;
+	estado_s copia = estado_copia(e);
+
+	pthread_mutex_lock(&sessao.lock);
+
+	size_t i = sessao_procura(e->nome);
+
+	if (i != SESSAO_NENHUMA) {
+		sessao_lru_tira(i);
+		sessao.entradas[i].suja |= suja;
+		estado_liberta(&sessao.entradas[i].e);
+	} else {
+		if (sessao.num < sessao.capacidade) {
+			i = sessao.num++;
+		} else {
+			/* expulsa a entrada usada menos recentemente */
+			i = sessao.menos_recente;
+			sessao_lru_tira(i);
+			sessao_hash_tira(i);
+			expulso = sessao.entradas[i].e;
+			expulsou = true;
+			escrever = sessao.entradas[i].suja;
+		}
+
+		size_t b = sessao_balde(e->nome);
+		sessao.entradas[i].prox = sessao.baldes[b];
+		sessao.baldes[b] = i;
+		sessao.entradas[i].suja = suja;
+	}
+
+	sessao.entradas[i].e = copia;
+	sessao_lru_poe(i);
+
+	pthread_mutex_unlock(&sessao.lock);
+
+	if (escrever) {
+		pthread_mutex_lock(&sessao.io);
+		armazem_escreve(&expulso);
+		pthread_mutex_unlock(&sessao.io);
+	}
+
+	if (expulsou)
+		estado_liberta(&expulso);
+}
+
+bool sessao_ler (const char * nome, estado_p e)
+{
+	assert(nome != NULL);
+	assert(e != NULL);
+
+	ifjmp(sessao.entradas == NULL, off);
+
+	pthread_mutex_lock(&sessao.lock);
+	size_t i = sessao_procura(nome);
+	if (i != SESSAO_NENHUMA) {
+		*e = estado_copia(&sessao.entradas[i].e);
+		sessao_lru_tira(i);
+		sessao_lru_poe(i);
+	}
+	pthread_mutex_unlock(&sessao.lock);
+
+	ifjmp(i != SESSAO_NENHUMA, out);
+
+	pthread_mutex_lock(&sessao.io);
+	bool lido = armazem_ler(nome, e);
+	pthread_mutex_unlock(&sessao.io);
+
+	/* um jogador que nao existe nao fica na cache */
+	if (lido)
+		sessao_insere(e, false);
+	else
+		*e = (estado_s) { 0 };
+
+out:
+	return true;
+off:
+	return false;
+}
+
+bool sessao_existe (const char * nome)
+{
+	assert(nome != NULL);
+
+	ifjmp(sessao.entradas == NULL, off);
+
+	pthread_mutex_lock(&sessao.lock);
+	bool ret = sessao_procura(nome) != SESSAO_NENHUMA;
+	pthread_mutex_unlock(&sessao.lock);
+
+	return ret;
+off:
+	return false;
+}
+
+bool sessao_escreve (const estado_p e)
+{
+	assert(e != NULL);
+
+	ifjmp(sessao.entradas == NULL, off);
+
+	/* com `DURABILIDADE_FSYNC` so se responde depois de o estado estar no disco */
+	bool sync = armazem_durabilidade() == DURABILIDADE_FSYNC;
+	sessao_insere(e, !sync);
+
+	if (sync) {
+		pthread_mutex_lock(&sessao.io);
+		armazem_escreve(e);
+		pthread_mutex_unlock(&sessao.io);
+	}
+
+	return true;
+off:
+	return false;
+}
+
+void sessao_flush (void)
+{
+	ifjmp(sessao.entradas == NULL, out);
+
+	/*
+	 * o lock do disco e apanhado primeiro para que uma entrada expulsa
+	 * entretanto nunca seja reescrita com uma versao mais antiga
+	 */
+	pthread_mutex_lock(&sessao.io);
+
+	/* as accoes vao para os diarios antes dos estados a que levaram */
+	diario_flush();
+
+	pthread_mutex_lock(&sessao.lock);
+	size_t n = 0;
+	for (size_t i = 0; i < sessao.num; i++) {
+		if (!sessao.entradas[i].suja)
+			continue;
+		sessao.lote[n++] = estado_copia(&sessao.entradas[i].e);
+		sessao.entradas[i].suja = false;
+	}
+	pthread_mutex_unlock(&sessao.lock);
+
+	armazem_escreve_lote(sessao.lote, n);
+
+	for (size_t i = 0; i < n; i++)
+		estado_liberta(sessao.lote + i);
+
+	pthread_mutex_unlock(&sessao.io);
+
+out:
+	return;
+}
+
+/**
+ * @brief A thread que escreve os estados alterados em background.
+ * @param arg Os sinais que terminam o programa.
+ * @returns Nunca retorna.
+ */
+void * sessao_flusher (void * arg)
+{
+	const sigset_t * sinais = arg;
+	const struct timespec t = {
+		.tv_sec = sessao.flush_ms / 1000,
+		.tv_nsec = (sessao.flush_ms % 1000) * 1000000L,
+	};
+
+	for (;;) {
+		int sig = sigtimedwait(sinais, NULL, &t);
+		sessao_flush();
+		if (sig > 0)
+			exit(EXIT_SUCCESS);
+	}
+
+	return NULL;
+}
+
+void sessao_activa (size_t capacidade, unsigned flush_ms)
+{
+	static sigset_t sinais;
+
+	assert(capacidade > 0);
+	assert(sessao.entradas == NULL);
+
+	sessao.capacidade = capacidade;
+	sessao.num = 0;
+	sessao.mais_recente = sessao.menos_recente = SESSAO_NENHUMA;
+	sessao.flush_ms = flush_ms;
+
+	for (sessao.num_baldes = 1; sessao.num_baldes < (capacidade << 1); sessao.num_baldes <<= 1);
+
+	sessao.baldes = malloc(sessao.num_baldes * sizeof(size_t));
+	sessao.lote = malloc(capacidade * sizeof(estado_s));
+	sessao.entradas = malloc(capacidade * sizeof(sessao_entrada));
+	check(sessao.baldes == NULL || sessao.lote == NULL || sessao.entradas == NULL,
+	      "could not allocate session cache");
+
+	for (size_t i = 0; i < sessao.num_baldes; i++)
+		sessao.baldes[i] = SESSAO_NENHUMA;
+
+	/* os diarios sao escritos com os estados */
+	diario_adia();
+
+	/* os sinais ficam bloqueados em todas as threads e sao recebidos pelo flusher */
+	sigemptyset(&sinais);
+	sigaddset(&sinais, SIGINT);
+	sigaddset(&sinais, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &sinais, NULL);
+
+	pthread_t t;
+	errno = pthread_create(&t, NULL, sessao_flusher, &sinais);
+	check(errno != 0, "could not start session flusher");
+	pthread_detach(t);
+}
@@ -0,0 +1,462 @@
+/** @file */
+/**
+ * Gera carga no binario CGI do jogo, como um servidor web com muitos jogadores.
+ *
+ * Uso: `rogue-carga [-b BINARIO] [-p PASTA] [-u JOGADORES] [-c CONCORRENCIA]
+ * [-n PEDIDOS] [-z EXPOENTE] [-t TAM] [-s SEMENTE]`
+ *
+ * Cada pedido corre `BINARIO` com a `QUERY_STRING` e o `ROGUE_BASE_PATH`
+ * no ambiente, como um servidor web, e le a pagina do `stdout`. O jogador
+ * de cada pedido e escolhido com uma distribuicao de Zipf de `EXPOENTE`:
+ * o jogador de ordem `k` faz pedidos com uma frequencia proporcional a
+ * `1 / k ^ EXPOENTE`, como os jogadores reais. O primeiro pedido de cada
+ * jogador e o login; os seguintes sao uma das jogadas da ultima pagina que
+ * recebeu, ao acaso, ou outro link da pagina se nao houver jogadas.
+ *
+ * `CONCORRENCIA` threads fazem os pedidos ao mesmo tempo, nunca dois do
+ * mesmo jogador. No fim escreve o numero de pedidos por segundo e os
+ * percentis da latencia, do `posix_spawn()` ao fim do processo.
+ */
+#define _GNU_SOURCE /* `pipe2()` */
+#include "check.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "aleatorio.h"
+#include "posicao.h"
+
+/**
+ * @brief O tamanho maximo da `QUERY_STRING` de um pedido.
+ */
+#define CARGA_QS_MAX	64
+
+/**
+ * @brief O numero maximo de links lidos de uma pagina.
+ */
+#define CARGA_LINKS_MAX	256
+
+/**
+ * @brief O numero maximo de variaveis de ambiente passadas ao binario.
+ */
+#define CARGA_AMBIENTE_MAX	8
+
+/**
+ * @brief Um jogador simulado.
+ */
+typedef struct {
+	/** O proximo pedido: o login ou um link da ultima pagina. */
+	char qs[CARGA_QS_MAX];
+	/** Se ha um pedido do jogador a ser feito. */
+	atomic_flag ocupado;
+} jogador;
+
+/**
+ * @brief A configuracao da carga, partilhada por todas as threads.
+ */
+typedef struct {
+	/** O binario CGI. */
+	const char * binario;
+	/** O `ROGUE_BASE_PATH`, com a `/` no fim. */
+	char pasta[256];
+	/** O lado do tabuleiro dos jogos novos. */
+	unsigned tam;
+	/** A semente das threads. */
+	uint64_t semente;
+	/** Os jogadores. */
+	jogador * jogadores;
+	/** O numero de jogadores. */
+	size_t num_jogadores;
+	/** A distribuicao acumulada da popularidade dos jogadores. */
+	double * zipf;
+	/** O numero de pedidos a fazer. */
+	uint64_t pedidos;
+	/** O numero de pedidos ja comecados. */
+	_Atomic uint64_t comecados;
+	/** A latencia de cada pedido, em nanossegundos. */
+	uint64_t * latencias;
+	/** O numero de pedidos que falharam. */
+	_Atomic uint64_t erros;
+	/** O numero de paginas sem nenhum link. */
+	_Atomic uint64_t sem_links;
+} carga;
+
+/**
+ * @brief O trabalho de uma thread.
+ */
+typedef struct {
+	/** A carga. */
+	carga * c;
+	/** O gerador da thread. */
+	aleatorio a;
+	/** A pagina do ultimo pedido. */
+	char * buf;
+	/** A capacidade de `buf`. */
+	size_t cap;
+} trabalho;
+
+/**
+ * @brief Devolve o tempo actual em nanossegundos.
+ * @returns O tempo.
+ */
+uint64_t agora (void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return ((uint64_t) t.tv_sec * 1000000000ULL) + t.tv_nsec;
+}
+
+/**
+ * @brief Calcula a distribuicao acumulada de Zipf.
+ * @param n O numero de jogadores.
+ * @param s O expoente.
+ * @returns As `n` probabilidades acumuladas, a ultima igual a 1.
+ */
+double * zipf_calcula (size_t n, double s)
+{
+	double * ret = malloc(n * sizeof(double));
+	check(ret == NULL, "could not allocate the Zipf distribution");
+
+	double soma = 0;
+	for (size_t k = 0; k < n; k++)
+		ret[k] = (soma += pow((double) (k + 1), -s));
+	for (size_t k = 0; k < n; k++)
+		ret[k] /= soma;
+	ret[n - 1] = 1.0;
+
+	return ret;
+}
+
+/**
+ * @brief Escolhe um jogador da distribuicao de Zipf.
+ * @param c A carga.
+ * @param a O gerador.
+ * @returns O indice do jogador.
+ */
+size_t zipf_escolhe (const carga * c, aleatorio * a)
+{
+	/* 53 bits aleatorios, em [0, 1) */
+	double u = (aleatorio_proximo(a) >> 11) * 0x1.0p-53;
+	size_t ini = 0;
+	size_t fim = c->num_jogadores - 1;
+
+	while (ini < fim) {
+		size_t meio = ini + ((fim - ini) >> 1);
+		if (c->zipf[meio] <= u)
+			ini = meio + 1;
+		else
+			fim = meio;
+	}
+
+	return ini;
+}
+
+/**
+ * @brief Escreve o pedido de login de um jogador.
+ * @param c A carga.
+ * @param i O indice do jogador.
+ * @param dst Onde escrever, com `CARGA_QS_MAX` bytes.
+ */
+void login (const carga * c, size_t i, char * dst)
+{
+	snprintf(dst, CARGA_QS_MAX, "nome=c%09zu&tam=%u", i, c->tam);
+}
+
+/**
+ * @brief Corre o binario CGI com uma `QUERY_STRING` e le a pagina.
+ * @param t O trabalho da thread, onde fica a pagina.
+ * @param qs A `QUERY_STRING`.
+ * @param n Onde guardar o tamanho da pagina.
+ * @returns Verdadeiro se o binario terminou com sucesso, falso caso contrario.
+ */
+bool pedido (trabalho * t, const char * qs, size_t * n)
+{
+	char env_qs[CARGA_QS_MAX + 16];
+	char env_pasta[sizeof(t->c->pasta) + 32];
+	char env_armazem[64];
+	char * env[CARGA_AMBIENTE_MAX];
+	size_t k = 0;
+
+	snprintf(env_qs, sizeof(env_qs), "QUERY_STRING=%s", qs);
+	snprintf(env_pasta, sizeof(env_pasta), "ROGUE_BASE_PATH=%s", t->c->pasta);
+	env[k++] = env_qs;
+	env[k++] = env_pasta;
+	env[k++] = "REQUEST_METHOD=GET";
+
+	/* o tipo de armazenamento e o de quem corre a carga */
+	const char * armazem = getenv("ROGUE_ARMAZEM");
+	if (armazem != NULL) {
+		snprintf(env_armazem, sizeof(env_armazem), "ROGUE_ARMAZEM=%s", armazem);
+		env[k++] = env_armazem;
+	}
+	env[k] = NULL;
+
+	/* com `O_CLOEXEC`, os filhos das outras threads nao herdam o pipe */
+	int fd[2];
+	check(pipe2(fd, O_CLOEXEC) != 0, "could not create pipe");
+
+	posix_spawn_file_actions_t fa;
+	posix_spawn_file_actions_init(&fa);
+	posix_spawn_file_actions_adddup2(&fa, fd[1], STDOUT_FILENO);
+
+	char * argv[] = { (char *) t->c->binario, NULL };
+	pid_t pid;
+	int r = posix_spawn(&pid, t->c->binario, &fa, NULL, argv, env);
+	posix_spawn_file_actions_destroy(&fa);
+	close(fd[1]);
+	check(r != 0, "could not run the CGI binary");
+
+	*n = 0;
+	for (;;) {
+		if (*n + 4096 > t->cap) {
+			t->cap = (t->cap > 0) ? t->cap << 1 : 64 * 1024;
+			t->buf = realloc(t->buf, t->cap);
+			check(t->buf == NULL, "could not allocate page");
+		}
+		ssize_t lidos = read(fd[0], t->buf + *n, t->cap - *n - 1);
+		if (lidos < 0 && errno == EINTR)
+			continue;
+		if (lidos <= 0)
+			break;
+		*n += lidos;
+	}
+	t->buf[*n] = '\0';
+	close(fd[0]);
+
+	int estado = 0;
+	while (waitpid(pid, &estado, 0) < 0 && errno == EINTR);
+
+	return WIFEXITED(estado) && WEXITSTATUS(estado) == 0;
+}
+
+/**
+ * @brief Escolhe o proximo pedido de um jogador a partir da pagina que recebeu.
+ *
+ * Prefere as jogadas, `NOME,00000001,...`, aos outros links, como o reset
+ * no fim do jogo.
+ * @param t O trabalho da thread, com a pagina.
+ * @param dst Onde escrever o pedido, com `CARGA_QS_MAX` bytes.
+ * @returns Verdadeiro se a pagina tiver algum link, falso caso contrario.
+ */
+bool proximo (trabalho * t, char * dst)
+{
+	const char * links[CARGA_LINKS_MAX];
+	size_t tams[CARGA_LINKS_MAX];
+	size_t n = 0;
+	size_t jogadas = 0;
+
+	for (const char * p = t->buf; n < CARGA_LINKS_MAX && (p = strstr(p, "href=\"?")) != NULL; ) {
+		p += 7;
+		const char * fim = strchr(p, '"');
+		if (fim == NULL)
+			break;
+		if ((size_t) (fim - p) < CARGA_QS_MAX) {
+			const char * accao = strchr(p, ',');
+			bool jogada = accao != NULL && accao < fim && strncmp(accao, ",00000001,", 10) == 0;
+
+			/* as jogadas ficam no inicio */
+			size_t i = n++;
+			if (jogada) {
+				links[i] = links[jogadas];
+				tams[i] = tams[jogadas];
+				i = jogadas++;
+			}
+			links[i] = p;
+			tams[i] = fim - p;
+		}
+		p = fim;
+	}
+
+	ifjmp(n == 0, err);
+
+	size_t k = aleatorio_ate(&t->a, (jogadas > 0) ? jogadas : n);
+	memcpy(dst, links[k], tams[k]);
+	dst[tams[k]] = '\0';
+
+	return true;
+err:
+	return false;
+}
+
+/**
+ * @brief Faz pedidos ate a carga ter todos os pedidos comecados.
+ * @param arg O trabalho da thread.
+ * @returns `NULL`.
+ */
+void * gera (void * arg)
+{
+	trabalho * t = arg;
+	carga * c = t->c;
+
+	for (uint64_t i = c->comecados++; i < c->pedidos; i = c->comecados++) {
+		/* um jogador so faz um pedido de cada vez */
+		jogador * j = NULL;
+		do {
+			j = c->jogadores + zipf_escolhe(c, &t->a);
+		} while (atomic_flag_test_and_set(&j->ocupado));
+
+		size_t n = 0;
+		uint64_t t0 = agora();
+		bool ok = pedido(t, j->qs, &n);
+		c->latencias[i] = agora() - t0;
+
+		if (!ok)
+			c->erros++;
+
+		if (!proximo(t, j->qs)) {
+			c->sem_links++;
+			login(c, j - c->jogadores, j->qs);
+		}
+
+		atomic_flag_clear(&j->ocupado);
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Compara duas latencias, para o `qsort()`.
+ * @param a Uma latencia.
+ * @param b A outra latencia.
+ * @returns Negativo, 0 ou positivo, se `a` for menor, igual ou maior que `b`.
+ */
+int compara (const void * a, const void * b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Calcula um percentil das latencias.
+ * @param l As latencias, ordenadas.
+ * @param n O numero de latencias.
+ * @param p O percentil, entre 0 e 1.
+ * @returns A latencia, em microssegundos.
+ */
+double percentil (const uint64_t * l, uint64_t n, double p)
+{
+	uint64_t i = (uint64_t) ceil(p * n);
+	return l[(i > 0) ? i - 1 : 0] / 1e3;
+}
+
+/**
+ * @brief O entry point do gerador de carga.
+ * @param argc Numero de argumentos
+ * @param argv Argumentos
+ * @returns Codigo de sucesso
+ */
+int main (int argc, char ** argv)
+{
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned threads = (ncpu > 0) ? ncpu : 1;
+	const char * pasta = getenv("ROGUE_BASE_PATH");
+	double expoente = 1.0;
+	carga * c = calloc(1, sizeof(carga));
+	check(c == NULL, "could not allocate the load");
+
+	c->binario = "./rogue";
+	c->num_jogadores = 10000;
+	c->pedidos = 100000;
+	c->tam = TAM;
+	c->semente = aleatorio_semente();
+
+	int opt;
+	while ((opt = getopt(argc, argv, "b:p:u:c:n:z:t:s:")) != -1) {
+		switch (opt) {
+		case 'b': c->binario = optarg; break;
+		case 'p': pasta = optarg; break;
+		case 'u': c->num_jogadores = strtoull(optarg, NULL, 10); break;
+		case 'c': threads = strtoul(optarg, NULL, 10); break;
+		case 'n': c->pedidos = strtoull(optarg, NULL, 10); break;
+		case 'z': expoente = strtod(optarg, NULL); break;
+		case 't': c->tam = strtoul(optarg, NULL, 10); break;
+		case 's': c->semente = strtoull(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-b BINARIO] [-p PASTA] [-u JOGADORES] [-c CONCORRENCIA] "
+				"[-n PEDIDOS] [-z EXPOENTE] [-t TAM] [-s SEMENTE]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	threads = (threads < 1) ? 1 : threads;
+	c->num_jogadores = (c->num_jogadores < 1) ? 1 : (c->num_jogadores > 1000000000) ? 1000000000 : c->num_jogadores;
+	c->tam = (c->tam < TAM_MIN) ? TAM_MIN : (c->tam > TAM_MAX) ? TAM_MAX : c->tam;
+
+	/* a pasta e criada se nao existir, e o binario espera a `/` no fim */
+	if (pasta == NULL || *pasta == '\0')
+		pasta = "/tmp/rogue-carga/";
+	size_t len = strlen(pasta);
+	snprintf(c->pasta, sizeof(c->pasta), "%s%s", pasta, (pasta[len - 1] == '/') ? "" : "/");
+	check(mkdir(c->pasta, 0777) != 0 && errno != EEXIST, "could not create the base path");
+
+	c->jogadores = calloc(c->num_jogadores, sizeof(jogador));
+	c->latencias = calloc(c->pedidos + 1, sizeof(uint64_t));
+	c->zipf = zipf_calcula(c->num_jogadores, expoente);
+	trabalho * t = calloc(threads, sizeof(trabalho));
+	pthread_t * ids = calloc(threads, sizeof(pthread_t));
+	check(c->jogadores == NULL || c->latencias == NULL || t == NULL || ids == NULL,
+	      "could not allocate the players");
+
+	for (size_t i = 0; i < c->num_jogadores; i++) {
+		login(c, i, c->jogadores[i].qs);
+		atomic_flag_clear(&c->jogadores[i].ocupado);
+	}
+
+	printf("%" PRIu64 " pedidos de %zu jogadores (zipf %.2f) a %s, %u em simultaneo, em %s\n\n",
+	       c->pedidos, c->num_jogadores, expoente, c->binario, threads, c->pasta);
+	fflush(stdout);
+
+	uint64_t t0 = agora();
+
+	for (unsigned i = 0; i < threads; i++) {
+		t[i].c = c;
+		aleatorio_semeia(&t[i].a, c->semente + i);
+		check(pthread_create(ids + i, NULL, gera, t + i) != 0, "could not create thread");
+	}
+
+	for (unsigned i = 0; i < threads; i++) {
+		pthread_join(ids[i], NULL);
+		free(t[i].buf);
+	}
+
+	uint64_t ns = agora() - t0;
+	uint64_t n = c->pedidos;
+
+	if (n > 0) {
+		qsort(c->latencias, n, sizeof(uint64_t), compara);
+		printf("%" PRIu64 " pedidos em %.3f s: %.0f pedidos/s\n", n, ns / 1e9, n / (ns / 1e9));
+		printf("latencia (us): p50 %.0f, p90 %.0f, p99 %.0f, p999 %.0f, max %.0f\n",
+		       percentil(c->latencias, n, 0.50),
+		       percentil(c->latencias, n, 0.90),
+		       percentil(c->latencias, n, 0.99),
+		       percentil(c->latencias, n, 0.999),
+		       percentil(c->latencias, n, 1.0));
+		printf("%" PRIu64 " erros, %" PRIu64 " paginas sem links\n", (uint64_t) c->erros, (uint64_t) c->sem_links);
+	}
+
+	int ret = (c->erros > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+	free(ids);
+	free(t);
+	free(c->zipf);
+	free(c->latencias);
+	free(c->jogadores);
+	free(c);
+
+	return ret;
+}
@@ -0,0 +1,655 @@
+/** @file */
+/**
+ * Simula jogos sem HTML, com um jogador automatico, em varias threads.
+ *
+ * Uso: `rogue-sim [-j THREADS] [-n JOGOS] [-t TAM] [-l NIVEIS] [-s SEMENTE]`
+ *
+ * Cada jogo comeca com `init_estado()` e cada jogada e um `corre_accao()`
+ * seguido de `bot_joga()`, como num pedido. O jogador experimenta as
+ * jogadas candidatas numa copia do estado, com a ronda dos bots, e fica com
+ * a melhor: um inimigo que ataca o jogador ganha a vida que perde quando e
+ * atacado, logo o que conta e nao ser atacado nem ficar encurralado, depois
+ * matar, depois ter um inimigo para matar na jogada seguinte, depois a vida
+ * e por fim ficar perto do inimigo mais fraco ou, no fim da ronda, da porta.
+ * As candidatas sao esperar, mudar de tipo de movimento e as jogadas, com
+ * os ataques primeiro e depois as que ficam mais perto do alvo. Um nivel e
+ * abandonado se o jogador passar muito tempo sem matar nenhum inimigo.
+ * No fim escreve, por nivel, quantos jogos chegaram a ele, quantos o
+ * ganharam, quantos morreram nele e quantos ficaram presos, e a
+ * distribuicao do score final; o numero de jogadas por segundo serve de
+ * benchmark do motor do jogo, que corre uma vez por candidata em cada jogada.
+ *
+ * O jogo `i` e semeado com `SEMENTE + i`, logo os resultados so dependem
+ * da semente, nao do numero de threads.
+ */
+#include "check.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <unistd.h>
+
+#include "aleatorio.h"
+#include "estado.h"
+#include "jogo.h"
+
+/**
+ * @brief O nivel maximo simulado; um jogo que o passe acaba.
+ */
+#define NIVEIS_MAX	64
+
+/**
+ * @brief O maior score com uma entrada propria no histograma.
+ */
+#define SCORE_MAX	1024
+
+/**
+ * @brief O maximo de jogadas experimentadas em cada turno.
+ */
+#define CANDIDATAS	16
+
+/**
+ * @brief O ruido somado ao valor de cada jogada, para o jogador nao andar as voltas.
+ */
+#define RUIDO	4
+
+/**
+ * @brief O peso de cada inimigo que ja atacou o jogador e nunca mais morre.
+ */
+#define PESO_FORTE	1000000
+
+/**
+ * @brief O peso de ficar sem nenhuma accao que escape ao ataque seguinte.
+ */
+#define PESO_ENCURRALADO	500000
+
+/**
+ * @brief O peso de cada inimigo morto.
+ */
+#define PESO_MATA	1000
+
+/**
+ * @brief O peso de poder matar um inimigo na jogada seguinte.
+ */
+#define PESO_PRESA	200
+
+/**
+ * @brief O peso de cada ponto de vida.
+ */
+#define PESO_VIDA	10
+
+/**
+ * @brief O peso do quadrado da distancia ao alvo, dez vezes maior no fim da ronda.
+ */
+#define PESO_DISTANCIA	10
+
+/**
+ * @brief Os resultados de um nivel.
+ */
+typedef struct {
+	/** Jogos que chegaram ao nivel. */
+	uint64_t jogados;
+	/** Jogos que passaram o nivel. */
+	uint64_t ganhos;
+	/** Jogos que acabaram com o jogador morto no nivel. */
+	uint64_t mortes;
+	/** Jogos abandonados por o jogador nao sair do nivel. */
+	uint64_t presos;
+	/** Jogadas feitas no nivel. */
+	uint64_t jogadas;
+} resultado_nivel;
+
+/**
+ * @brief Os resultados de uma thread.
+ */
+typedef struct {
+	/** Por nivel; o indice 0 nao e usado. */
+	resultado_nivel nivel[NIVEIS_MAX + 1];
+	/** Histograma do score final; a ultima entrada tem os maiores que `SCORE_MAX`. */
+	uint64_t score[SCORE_MAX + 1];
+	/** Jogos que passaram o ultimo nivel simulado. */
+	uint64_t sobreviventes;
+} resultados;
+
+/**
+ * @brief O trabalho de uma thread.
+ */
+typedef struct {
+	/** As dimensoes do tabuleiro. */
+	posicao_s tam;
+	/** O ultimo nivel simulado. */
+	unsigned niveis;
+	/** A semente do primeiro jogo. */
+	uint64_t semente;
+	/** O numero total de jogos. */
+	uint64_t jogos;
+	/** O primeiro jogo desta thread. */
+	uint64_t primeiro;
+	/** A distancia entre os jogos desta thread. */
+	uint64_t passo;
+	/** Os resultados da thread. */
+	resultados r;
+} trabalho;
+
+/**
+ * @brief Devolve o tempo actual em nanossegundos.
+ * @returns O tempo.
+ */
+uint64_t agora (void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return ((uint64_t) t.tv_sec * 1000000000ULL) + t.tv_nsec;
+}
+
+/**
+ * @brief Calcula a posicao do inimigo mais perto do jogador.
+ *
+ * Os que morrem com um golpe vem antes dos outros, que ja nao vale a pena atacar.
+ * @param e O estado do jogo, com pelo menos um inimigo.
+ * @returns A posicao.
+ */
+posicao_s inimigo_mais_perto (const estado_p e)
+{
+	assert(e->num_inimigos > 0);
+
+	posicao_s ret = e->inimigo[0].pos;
+	bool fraco = false;
+	uint64_t melhor = UINT64_MAX;
+
+	for (size_t i = 0; i < e->num_inimigos; i++) {
+		int64_t dx = (int64_t) e->inimigo[i].pos.x - e->jog.pos.x;
+		int64_t dy = (int64_t) e->inimigo[i].pos.y - e->jog.pos.y;
+		uint64_t d = (dx * dx) + (dy * dy);
+		bool f = e->inimigo[i].vida == 1;
+		if ((f && !fraco) || (f == fraco && d < melhor)) {
+			fraco = f;
+			melhor = d;
+			ret = e->inimigo[i].pos;
+		}
+	}
+
+	return ret;
+}
+
+/**
+ * @brief Calcula o alvo do jogador: a porta no fim da ronda, senao o inimigo mais perto.
+ * @param e O estado do jogo.
+ * @returns A posicao.
+ */
+posicao_s alvo (const estado_p e)
+{
+	return (fim_de_ronda(e)) ?
+		e->porta :
+		inimigo_mais_perto(e);
+}
+
+/**
+ * @brief Calcula a vida do inimigo numa posicao.
+ * @param e O estado do jogo.
+ * @param p A posicao, ocupada por um inimigo.
+ * @returns A vida.
+ */
+uchar vida_inimigo (const estado_p e, posicao_s p)
+{
+	return e->inimigo[entidade_procura(e->inimigo, &e->grelha_inimigos, p, e->num_inimigos)].vida;
+}
+
+/**
+ * @brief Verifica se nenhum inimigo pode atacar uma casa na ronda dos bots.
+ *
+ * Os movimentos sao simetricos: os inimigos que chegam a casa sao os que
+ * estao onde o jogador chegaria a partir dela.
+ * @param e O estado do jogo.
+ * @param j A janela.
+ * @param p A casa.
+ * @param aux Espaco para `NJOGADAS(e->tam)` posicoes.
+ * @returns `true` se a casa for segura.
+ */
+bool casa_segura (const estado_p e, const janela * j, posicao_s p, posicao_p aux)
+{
+	size_t n = posicoes_possiveis(e, p, j, false, aux);
+
+	for (size_t i = 0; i < n; i++)
+		ifjmp(BB_TESTA(e->bb_inimigos, aux[i]), err);
+
+	return true;
+err:
+	return false;
+}
+
+/**
+ * @brief Verifica se o jogador tem uma accao que escape ao ataque seguinte.
+ *
+ * Esperar, ir para uma casa segura sem atacar um inimigo que ja nao morre
+ * ou mudar para um tipo de movimento com que nenhum inimigo o alcance.
+ * @param e O estado do jogo.
+ * @param pos Espaco para `NJOGADAS(e->tam)` posicoes.
+ * @param aux Espaco para `NJOGADAS(e->tam)` posicoes.
+ * @returns `true` se tiver.
+ */
+bool tem_saida (const estado_p e, posicao_p pos, posicao_p aux)
+{
+	janela j = janela_tabuleiro(e);
+	ifjmp(casa_segura(e, &j, e->jog.pos, aux), ok);
+
+	size_t n = posicoes_possiveis(e, e->jog.pos, &j, false, pos);
+	for (size_t i = 0; i < n; i++)
+		ifjmp((!BB_TESTA(e->bb_inimigos, pos[i]) || vida_inimigo(e, pos[i]) == 1)
+		      && casa_segura(e, &j, pos[i], aux), ok);
+
+	estado_s outro = *e;
+	for (size_t i = 0; i < MOV_TYPE_QUANTOS; i++) {
+		outro.mov_type = i;
+		ifjmp(casa_segura(&outro, &j, e->jog.pos, aux), ok);
+	}
+
+	return false;
+ok:
+	return true;
+}
+
+/**
+ * @brief Verifica se o jogador pode matar um inimigo e acabar numa casa segura.
+ * @param e O estado do jogo.
+ * @param pos Espaco para `NJOGADAS(e->tam)` posicoes.
+ * @param aux Espaco para `NJOGADAS(e->tam)` posicoes.
+ * @returns `true` se puder.
+ */
+bool tem_presa (const estado_p e, posicao_p pos, posicao_p aux)
+{
+	janela j = janela_tabuleiro(e);
+	size_t n = posicoes_possiveis(e, e->jog.pos, &j, false, pos);
+
+	for (size_t i = 0; i < n; i++)
+		ifjmp(BB_TESTA(e->bb_inimigos, pos[i]) && vida_inimigo(e, pos[i]) == 1
+		      && casa_segura(e, &j, pos[i], aux), ok);
+
+	return false;
+ok:
+	return true;
+}
+
+/**
+ * @brief Calcula o quadrado da distancia do jogador ao alvo.
+ *
+ * No fim da ronda e a distancia depois da melhor jogada seguinte, para o
+ * jogador nao ficar preso atras de um obstaculo a caminho da porta.
+ * @param e O estado do jogo.
+ * @param pos Espaco para `NJOGADAS(e->tam)` posicoes.
+ * @returns A distancia.
+ */
+int64_t distancia_alvo (const estado_p e, posicao_p pos)
+{
+	posicao_s p = alvo(e);
+	janela j = janela_tabuleiro(e);
+	size_t n = (fim_de_ronda(e)) ?
+		posicoes_possiveis(e, e->jog.pos, &j, false, pos) :
+		0;
+	int64_t ret = INT64_MAX;
+
+	pos[n++] = e->jog.pos;
+	for (size_t i = 0; i < n; i++) {
+		int64_t dx = (int64_t) p.x - pos[i].x;
+		int64_t dy = (int64_t) p.y - pos[i].y;
+		int64_t d = (dx * dx) + (dy * dy);
+		ret = (d < ret) ? d : ret;
+	}
+
+	return ret;
+}
+
+/**
+ * @brief Avalia uma accao, jogando-a numa copia do estado.
+ *
+ * Um inimigo com mais de uma vida ja atacou e, ao alcance, volta a atacar
+ * sempre que for atacado, por isso nunca morre: cada um pesa mais do que
+ * tudo o resto, menos morrer ou passar o nivel.
+ * @param e O estado do jogo.
+ * @param accao A accao.
+ * @param pos Espaco para `NJOGADAS(e->tam) + 1` posicoes.
+ * @param aux Espaco para `NJOGADAS(e->tam)` posicoes.
+ * @returns O valor da accao, maior quanto melhor.
+ */
+int64_t avalia (const estado_p e, accao_s accao, posicao_p pos, posicao_p aux)
+{
+	estado_s c = estado_copia(e);
+	int64_t ret = INT64_MAX;
+
+	c = corre_accao(c, accao);
+	ifjmp(c.nivel != e->nivel, out);
+	c = bot_joga(c);
+
+	ret = (fim_de_jogo(&c)) ? -1000 * (int64_t) PESO_FORTE : 0;
+	for (size_t i = 0; i < c.num_inimigos; i++)
+		if (c.inimigo[i].vida > 1)
+			ret -= PESO_FORTE;
+
+	if (!tem_saida(&c, pos, aux))
+		ret -= PESO_ENCURRALADO;
+	if (tem_presa(&c, pos, aux))
+		ret += PESO_PRESA;
+
+	ret += PESO_MATA * ((int64_t) c.score - e->score);
+	ret += PESO_VIDA * (int64_t) c.jog.vida;
+	ret -= PESO_DISTANCIA * distancia_alvo(&c, pos) * ((fim_de_ronda(&c)) ? 10 : 1);
+
+out:
+	estado_liberta(&c);
+	return ret;
+}
+
+/**
+ * @brief Escolhe as jogadas candidatas: os ataques e as que ficam mais perto do alvo.
+ *
+ * Ficam no inicio de `pos`, pela ordem em que foram escolhidas.
+ * @param e O estado do jogo.
+ * @param pos As jogadas possiveis.
+ * @param n O numero de jogadas possiveis.
+ * @returns O numero de candidatas, no maximo `CANDIDATAS`.
+ */
+size_t candidatas (const estado_p e, posicao_p pos, size_t n)
+{
+	size_t w = 0;
+
+	for (size_t i = 0; i < n && w < CANDIDATAS; i++) {
+		if (BB_TESTA(e->bb_inimigos, pos[i])) {
+			posicao_s t = pos[w];
+			pos[w++] = pos[i];
+			pos[i] = t;
+		}
+	}
+
+	posicao_s p = alvo(e);
+	for (; w < n && w < CANDIDATAS; w++) {
+		size_t k = w + pos_mais_perto(pos + w, n - w, p);
+		posicao_s t = pos[w];
+		pos[w] = pos[k];
+		pos[k] = t;
+	}
+
+	return w;
+}
+
+/**
+ * @brief Escolhe a accao do jogador automatico.
+ * @param e O estado do jogo.
+ * @param a O gerador do ruido.
+ * @returns A accao.
+ */
+accao_s politica (const estado_p e, aleatorio * a)
+{
+	size_t N = NJOGADAS(e->tam);
+	posicao_p pos = malloc(((3 * N) + 1) * sizeof(posicao_s));
+	check(pos == NULL, "could not allocate moves");
+	posicao_p aux = pos + N;
+
+	janela j = janela_tabuleiro(e);
+	size_t n = candidatas(e, pos, posicoes_possiveis(e, e->jog.pos, &j, false, pos));
+
+	/* esperar nao custa vida e deixa os inimigos virem ter com ele */
+	accao_s ret = accao_new(e->nome, ACCAO_IGNORE, e->jog.pos, e->jog.pos);
+	int64_t melhor = avalia(e, ret, aux, aux + N + 1);
+
+	for (size_t i = 0; i < n + MOV_TYPE_QUANTOS; i++) {
+		accao_s accao = (i < n) ?
+			accao_new(e->nome, ACCAO_MOVE, e->jog.pos, pos[i]) :
+			accao_new(e->nome, ACCAO_CHANGE_MT, e->jog.pos, posicao_new(i - n, 0));
+		if (accao.accao == ACCAO_CHANGE_MT && accao.dest.x == e->mov_type)
+			continue;
+
+		int64_t v = avalia(e, accao, aux, aux + N + 1);
+		v = (i < n && v < INT64_MAX - RUIDO) ? v + (int64_t) aleatorio_ate(a, RUIDO) : v;
+		if (v > melhor) {
+			melhor = v;
+			ret = accao;
+		}
+	}
+
+	free(pos);
+	return ret;
+}
+
+/**
+ * @brief Joga um jogo ate o jogador morrer, ficar preso ou passar o ultimo nivel.
+ * @param t O trabalho da thread.
+ * @param i O numero do jogo.
+ */
+void simula_jogo (trabalho * t, uint64_t i)
+{
+	aleatorio g;
+	aleatorio_semeia(&g, t->semente + i);
+	uint64_t semente = aleatorio_proximo(&g);
+
+	aleatorio a;
+	aleatorio_semeia(&a, aleatorio_proximo(&g));
+
+	/* sem inimigos nem vida a perder, o jogador pode andar as voltas para sempre */
+	uint64_t limite = (4 * (uint64_t) t->tam.x * t->tam.y) + 1000;
+	/* um inimigo que ja atacou nunca morre, e o nivel nunca acaba: desiste se nao matar nenhum */
+	uint64_t paciencia = (8 * (uint64_t) ((t->tam.x > t->tam.y) ? t->tam.x : t->tam.y)) + 100;
+
+	estado_s e = init_estado(t->tam, 0, 0, MOV_TYPE_QUANTOS, "sim", semente);
+
+	for (;;) {
+		uchar nivel = e.nivel;
+		resultado_nivel * r = t->r.nivel + nivel;
+		uint64_t jogadas = 0;
+		uint64_t matou = 0;
+
+		r->jogados++;
+
+		while (e.nivel == nivel && !fim_de_jogo(&e) && jogadas < limite
+		       && (fim_de_ronda(&e) || jogadas - matou < paciencia)) {
+			unsigned score = e.score;
+			e = corre_accao(e, politica(&e, &a));
+			e = bot_joga(e);
+			jogadas++;
+			if (e.score != score)
+				matou = jogadas;
+		}
+
+		r->jogadas += jogadas;
+
+		if (fim_de_jogo(&e)) {
+			r->mortes++;
+			break;
+		}
+
+		if (e.nivel == nivel) {
+			r->presos++;
+			break;
+		}
+
+		r->ganhos++;
+
+		if (e.nivel > t->niveis) {
+			t->r.sobreviventes++;
+			break;
+		}
+	}
+
+	t->r.score[(e.score < SCORE_MAX) ? e.score : SCORE_MAX]++;
+	estado_liberta(&e);
+}
+
+/**
+ * @brief Joga os jogos de uma thread.
+ * @param arg O trabalho da thread.
+ * @returns `NULL`.
+ */
+void * simula (void * arg)
+{
+	trabalho * t = arg;
+
+	for (uint64_t i = t->primeiro; i < t->jogos; i += t->passo)
+		simula_jogo(t, i);
+
+	return NULL;
+}
+
+/**
+ * @brief Calcula um percentil do histograma do score.
+ * @param r Os resultados.
+ * @param jogos O numero de jogos.
+ * @param p O percentil, entre 0 e 1.
+ * @returns O score.
+ */
+unsigned percentil (const resultados * r, uint64_t jogos, double p)
+{
+	uint64_t alvo = (uint64_t) (p * (jogos - 1)) + 1;
+	uint64_t acc = 0;
+	unsigned ret = 0;
+
+	while (ret < SCORE_MAX && (acc += r->score[ret]) < alvo)
+		ret++;
+
+	return ret;
+}
+
+/**
+ * @brief Escreve os resultados de todas as threads.
+ * @param r Os resultados, ja juntos.
+ * @param jogos O numero de jogos.
+ * @param ns O tempo que demorou, em nanossegundos.
+ * @param threads O numero de threads.
+ * @param niveis O nivel que acaba os jogos.
+ */
+void imprime_resultados (const resultados * r, uint64_t jogos, uint64_t ns, unsigned threads, unsigned niveis)
+{
+	uint64_t jogadas = 0;
+
+	printf("nivel     jogados      ganhos      mortes      presos  %%ganhos  jogadas/nivel\n");
+	for (size_t n = 1; n <= NIVEIS_MAX && r->nivel[n].jogados > 0; n++) {
+		const resultado_nivel * l = r->nivel + n;
+		jogadas += l->jogadas;
+		printf("%5zu %11" PRIu64 " %11" PRIu64 " %11" PRIu64 " %11" PRIu64 " %7.2f%% %14.1f\n",
+		       n, l->jogados, l->ganhos, l->mortes, l->presos,
+		       (100.0 * l->ganhos) / l->jogados,
+		       (double) l->jogadas / l->jogados);
+	}
+
+	uint64_t soma = 0;
+	for (size_t s = 0; s <= SCORE_MAX; s++)
+		soma += s * r->score[s];
+
+	printf("\nscore: media %.2f, p50 %u, p90 %u, p99 %u, max %s%u\n",
+	       (double) soma / jogos,
+	       percentil(r, jogos, 0.50),
+	       percentil(r, jogos, 0.90),
+	       percentil(r, jogos, 0.99),
+	       (r->score[SCORE_MAX] > 0) ? ">=" : "",
+	       percentil(r, jogos, 1.0));
+	printf("%" PRIu64 " jogos passaram o nivel %u\n", r->sobreviventes, niveis);
+
+	double s = ns / 1e9;
+	printf("\n%" PRIu64 " jogos, %" PRIu64 " jogadas em %.3f s com %u threads: %.0f jogos/s, %.0f jogadas/s\n",
+	       jogos, jogadas, s, threads, jogos / s, jogadas / s);
+}
+
+/**
+ * @brief Le as dimensoes do tabuleiro, `N` ou `LxA`.
+ * @param str O argumento.
+ * @returns As dimensoes, entre `TAM_MIN` e `TAM_MAX`.
+ */
+posicao_s ler_tam (const char * str)
+{
+	unsigned l = TAM;
+	unsigned a = 0;
+
+	if (sscanf(str, "%ux%u", &l, &a) < 2)
+		a = l;
+
+	l = (l < TAM_MIN) ? TAM_MIN : (l > TAM_MAX) ? TAM_MAX : l;
+	a = (a < TAM_MIN) ? TAM_MIN : (a > TAM_MAX) ? TAM_MAX : a;
+
+	return posicao_new(l, a);
+}
+
+/**
+ * @brief O entry point do simulador.
+ * @param argc Numero de argumentos
+ * @param argv Argumentos
+ * @returns Codigo de sucesso
+ */
+int main (int argc, char ** argv)
+{
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned threads = (ncpu > 0) ? ncpu : 1;
+	uint64_t jogos = 100000;
+	posicao_s tam = posicao_new(TAM, TAM);
+	unsigned niveis = NIVEIS_MAX;
+	uint64_t semente = aleatorio_semente();
+
+	int opt;
+	while ((opt = getopt(argc, argv, "j:n:t:l:s:")) != -1) {
+		switch (opt) {
+		case 'j': threads = strtoul(optarg, NULL, 10); break;
+		case 'n': jogos = strtoull(optarg, NULL, 10); break;
+		case 't': tam = ler_tam(optarg); break;
+		case 'l': niveis = strtoul(optarg, NULL, 10); break;
+		case 's': semente = strtoull(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-j THREADS] [-n JOGOS] [-t TAM] [-l NIVEIS] [-s SEMENTE]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	threads = (threads < 1) ? 1 : threads;
+	niveis = (niveis < 1) ? 1 : (niveis > NIVEIS_MAX) ? NIVEIS_MAX : niveis;
+
+	printf("%" PRIu64 " jogos em %hux%hu ate ao nivel %u, semente %" PRIu64 "\n\n",
+	       jogos, tam.x, tam.y, niveis, semente);
+
+	trabalho * t = calloc(threads, sizeof(trabalho));
+	pthread_t * ids = calloc(threads, sizeof(pthread_t));
+	check(t == NULL || ids == NULL, "could not allocate threads");
+
+	uint64_t t0 = agora();
+
+	for (unsigned i = 0; i < threads; i++) {
+		t[i] = (trabalho) {
+			.tam = tam,
+			.niveis = niveis,
+			.semente = semente,
+			.jogos = jogos,
+			.primeiro = i,
+			.passo = threads,
+		};
+		check(pthread_create(ids + i, NULL, simula, t + i) != 0, "could not create thread");
+	}
+
+	resultados * r = calloc(1, sizeof(resultados));
+	check(r == NULL, "could not allocate results");
+
+	for (unsigned i = 0; i < threads; i++) {
+		pthread_join(ids[i], NULL);
+
+		for (size_t n = 0; n <= NIVEIS_MAX; n++) {
+			r->nivel[n].jogados += t[i].r.nivel[n].jogados;
+			r->nivel[n].ganhos += t[i].r.nivel[n].ganhos;
+			r->nivel[n].mortes += t[i].r.nivel[n].mortes;
+			r->nivel[n].presos += t[i].r.nivel[n].presos;
+			r->nivel[n].jogadas += t[i].r.nivel[n].jogadas;
+		}
+		for (size_t s = 0; s <= SCORE_MAX; s++)
+			r->score[s] += t[i].r.score[s];
+		r->sobreviventes += t[i].r.sobreviventes;
+	}
+
+	uint64_t ns = agora() - t0;
+
+	if (jogos > 0)
+		imprime_resultados(r, jogos, ns, threads, niveis);
+
+	free(r);
+	free(ids);
+	free(t);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,378 @@
+/** @file */
+#include "check.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "estado.h"
+
+#include "slab.h"
+
+/**
+ * @brief O ficheiro slab aberto.
+ */
+typedef struct {
+	/** O caminho do ficheiro. */
+	char path[PATH_MAX];
+	/** O descritor do ficheiro, ou -1 se nao houver nenhum aberto. */
+	int fd;
+	/** O ficheiro mapeado em memoria. */
+	slab_cabecalho * cab;
+	/** O tamanho do mapeamento. */
+	size_t tam;
+} slab_ficheiro;
+
+/**
+ * @brief O ficheiro slab aberto por este processo.
+ */
+slab_ficheiro slab = {
+	.fd = -1,
+	.cab = NULL,
+};
+
+/**
+ * @brief Calcula o tamanho de um ficheiro slab.
+ * @param C O numero de registos.
+ */
+#define slab_tamanho(C)		(SLAB_OFFSET + ((C) * sizeof(slab_registo)))
+
+/**
+ * @brief Os registos de um ficheiro slab mapeado.
+ * @param CAB O cabecalho do ficheiro.
+ */
+#define slab_registos(CAB)	((slab_registo *) (((char *) (CAB)) + SLAB_OFFSET))
+
+/**
+ * @brief Calcula o hash (FNV-1a) do nome de um jogador.
+ * @param nome O nome.
+ * @returns O hash.
+ */
+uint64_t slab_hash (const char * nome)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (; *nome != '\0'; nome++)
+		h = (h ^ (uchar) *nome) * 0x100000001b3ULL;
+	return h;
+}
+
+/**
+ * @brief Calcula o checksum (FNV-1a) de uma copia.
+ * @param c A copia.
+ * @returns O checksum.
+ */
+uint64_t slab_soma (const slab_copia * c)
+{
+	size_t n = (c->tam <= SLAB_DADOS) ? c->tam : 0;
+	uint64_t h = (0xcbf29ce484222325ULL ^ c->seq ^ ((uint64_t) c->tam << 32)) * 0x100000001b3ULL;
+	for (size_t i = 0; i < n; i++)
+		h = (h ^ c->dados[i]) * 0x100000001b3ULL;
+	return h | 1;
+}
+
+/**
+ * @brief Escolhe a copia valida mais recente de um registo.
+ * @param r O registo.
+ * @returns O indice da copia, ou 2 se nenhuma for valida.
+ */
+size_t slab_copia_actual (const slab_registo * r)
+{
+	bool v0 = r->copia[0].seq != 0 && r->copia[0].soma == slab_soma(r->copia + 0);
+	bool v1 = r->copia[1].seq != 0 && r->copia[1].soma == slab_soma(r->copia + 1);
+
+	if (v0 && v1)
+		return (r->copia[0].seq > r->copia[1].seq) ? 0 : 1;
+
+	return (v0) ? 0 :
+		(v1) ? 1 :
+		2;
+}
+
+/**
+ * @brief Procura o registo de um jogador, ou o registo livre onde deve ficar.
+ * @param cab O cabecalho do ficheiro.
+ * @param nome O nome do jogador.
+ * @returns O indice do registo.
+ */
+size_t slab_procura (const slab_cabecalho * cab, const char * nome)
+{
+	const slab_registo * r = slab_registos(cab);
+	uint64_t mask = cab->capacidade - 1;
+	size_t i = slab_hash(nome) & mask;
+
+	while (r[i].nome[0] != '\0' && strncmp(r[i].nome, nome, sizeof(r[i].nome)) != 0)
+		i = (i + 1) & mask;
+
+	return i;
+}
+
+/**
+ * @brief Mapeia um ficheiro slab em memoria.
+ * @param fd O descritor do ficheiro.
+ * @param tam Onde guardar o tamanho do mapeamento.
+ * @returns O cabecalho do ficheiro mapeado.
+ */
+slab_cabecalho * slab_mapeia (int fd, size_t * tam)
+{
+	struct stat st;
+	check(fstat(fd, &st) < 0, "could not stat slab file");
+
+	*tam = st.st_size;
+	slab_cabecalho * cab = mmap(NULL, *tam, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	check(cab == MAP_FAILED, "could not map slab file");
+
+	return cab;
+}
+
+/**
+ * @brief Inicializa um ficheiro slab vazio.
+ * @param fd O descritor do ficheiro.
+ * @param capacidade O numero de registos.
+ */
+void slab_inicializa (int fd, uint64_t capacidade)
+{
+	check(ftruncate(fd, slab_tamanho(capacidade)) < 0, "could not size slab file");
+
+	slab_cabecalho cab = {
+		.versao = SLAB_VERSAO,
+		.tam_registo = sizeof(slab_registo),
+		.capacidade = capacidade,
+		.num = 0,
+		.substituido = 0,
+	};
+	memcpy(cab.magic, SLAB_MAGIC, sizeof(cab.magic));
+
+	check(pwrite(fd, &cab, sizeof(cab), 0) != sizeof(cab), "could not write slab header");
+}
+
+void slab_fecha (void)
+{
+	ifjmp(slab.fd < 0, out);
+
+	munmap(slab.cab, slab.tam);
+	close(slab.fd);
+
+	slab.fd = -1;
+	slab.cab = NULL;
+
+out:
+	return;
+}
+
+void slab_abre (const char * path)
+{
+	assert(path != NULL);
+
+	char p[PATH_MAX] = "";
+	snprintf(p, sizeof(p), "%s", path);
+
+	slab_fecha();
+	strcpy(slab.path, p);
+
+	slab.fd = open(slab.path, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+	check(slab.fd < 0, "could not open slab file");
+
+	/* so um processo inicializa um ficheiro novo */
+	check(flock(slab.fd, LOCK_EX) < 0, "could not lock slab file");
+	struct stat st;
+	check(fstat(slab.fd, &st) < 0, "could not stat slab file");
+	if (st.st_size == 0)
+		slab_inicializa(slab.fd, SLAB_CAPACIDADE_MIN);
+	flock(slab.fd, LOCK_UN);
+
+	slab.cab = slab_mapeia(slab.fd, &slab.tam);
+
+	check(memcmp(slab.cab->magic, SLAB_MAGIC, sizeof(slab.cab->magic)) != 0
+	      || slab.cab->versao != SLAB_VERSAO
+	      || slab.cab->tam_registo != sizeof(slab_registo)
+	      || slab.tam < slab_tamanho(slab.cab->capacidade),
+	      "invalid slab file");
+}
+
+/**
+ * @brief Bloqueia o ficheiro slab, reabrindo-o se tiver sido substituido.
+ * @param op `LOCK_SH` ou `LOCK_EX`.
+ */
+void slab_bloqueia (int op)
+{
+	check(slab.fd < 0, "slab file is not open");
+
+	for (;;) {
+		check(flock(slab.fd, op) < 0, "could not lock slab file");
+		ifjmp(!slab.cab->substituido, out);
+		/* outro processo fez crescer o ficheiro */
+		flock(slab.fd, LOCK_UN);
+		slab_abre(slab.path);
+	}
+
+out:
+	return;
+}
+
+/**
+ * @brief Desbloqueia o ficheiro slab.
+ */
+void slab_desbloqueia (void)
+{
+	flock(slab.fd, LOCK_UN);
+}
+
+/**
+ * @brief Espera que uma zona do ficheiro mapeado esteja no disco.
+ * @param p O inicio da zona.
+ * @param n O tamanho da zona.
+ */
+void slab_msync (const void * p, size_t n)
+{
+	const size_t pag = sysconf(_SC_PAGESIZE);
+	uintptr_t ini = ((uintptr_t) p) & ~(pag - 1);
+	uintptr_t fim = (uintptr_t) p + n;
+	check(msync((void *) ini, fim - ini, MS_SYNC) < 0, "could not sync slab file");
+}
+
+/**
+ * @brief Duplica a capacidade do ficheiro slab.
+ *
+ * Escreve um ficheiro novo ao lado, substitui o antigo com `rename()` e
+ * marca o antigo como substituido. Tem de ser chamada com `LOCK_EX`.
+ * O ficheiro novo vai sempre para o disco antes do `rename()`, qualquer
+ * que seja a durabilidade pedida, senao um crash perdia todos os jogadores.
+ */
+void slab_cresce (void)
+{
+	char tmp[PATH_MAX + 4] = "";
+	snprintf(tmp, sizeof(tmp), "%s.tmp", slab.path);
+
+	int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	check(fd < 0, "could not create slab file");
+	/* o novo ficheiro fica bloqueado ate esta operacao acabar */
+	check(flock(fd, LOCK_EX) < 0, "could not lock slab file");
+
+	slab_inicializa(fd, slab.cab->capacidade << 1);
+
+	size_t tam = 0;
+	slab_cabecalho * cab = slab_mapeia(fd, &tam);
+
+	const slab_registo * r = slab_registos(slab.cab);
+	slab_registo * nr = slab_registos(cab);
+
+	for (size_t i = 0; i < slab.cab->capacidade; i++)
+		if (r[i].nome[0] != '\0')
+			nr[slab_procura(cab, r[i].nome)] = r[i];
+	cab->num = slab.cab->num;
+
+	slab_msync(cab, tam);
+	check(rename(tmp, slab.path) < 0, "could not replace slab file");
+	slab.cab->substituido = 1;
+
+	munmap(slab.cab, slab.tam);
+	close(slab.fd);
+
+	slab.fd = fd;
+	slab.cab = cab;
+	slab.tam = tam;
+}
+
+bool slab_ler (const char * nome, void * dados, size_t * n)
+{
+	assert(nome != NULL);
+	assert(dados != NULL);
+	assert(n != NULL);
+
+	slab_bloqueia(LOCK_SH);
+
+	const slab_registo * r = slab_registos(slab.cab) + slab_procura(slab.cab, nome);
+	size_t c = (r->nome[0] != '\0') ?
+		slab_copia_actual(r) :
+		2;
+	if (c < 2) {
+		const slab_copia * cp = r->copia + c;
+		*n = cp->tam;
+		if (cp->tam <= SLAB_DADOS)
+			memcpy(dados, cp->dados, cp->tam);
+	}
+
+	slab_desbloqueia();
+
+	return c < 2;
+}
+
+bool slab_existe (const char * nome)
+{
+	assert(nome != NULL);
+
+	slab_bloqueia(LOCK_SH);
+	const slab_registo * r = slab_registos(slab.cab) + slab_procura(slab.cab, nome);
+	/* um registo sem nenhuma copia valida, de uma escrita interrompida, nao conta */
+	bool ret = r->nome[0] != '\0' && slab_copia_actual(r) < 2;
+	slab_desbloqueia();
+
+	return ret;
+}
+
+void slab_escreve (const char * nome, const void * dados, size_t n, bool sync)
+{
+	assert(nome != NULL);
+	assert(nome[0] != '\0');
+	assert(n <= SLAB_DADOS || (n == SLAB_EXTERNO && dados == NULL));
+
+	slab_bloqueia(LOCK_EX);
+
+	size_t i = slab_procura(slab.cab, nome);
+	slab_registo * r = slab_registos(slab.cab) + i;
+	bool novo = r->nome[0] == '\0';
+
+	if (novo) {
+		/* mantem a taxa de ocupacao abaixo de 3/4 */
+		if ((slab.cab->num + 1) * 4 > slab.cab->capacidade * 3) {
+			slab_cresce();
+			i = slab_procura(slab.cab, nome);
+			r = slab_registos(slab.cab) + i;
+		}
+		memset(r, 0, sizeof(slab_registo));
+		slab.cab->num++;
+	}
+
+	/* escreve por cima da copia que nao e a actual */
+	size_t c = slab_copia_actual(r);
+	size_t w = (c == 0) ? 1 : 0;
+	uint64_t seq = (c < 2) ?
+		r->copia[c].seq + 1 :
+		1;
+
+	r->copia[w].tam = n;
+	if (n <= SLAB_DADOS)
+		memcpy(r->copia[w].dados, dados, n);
+	r->copia[w].seq = seq;
+	r->copia[w].soma = slab_soma(r->copia + w);
+
+	/* o nome so aparece depois de haver uma copia valida */
+	if (novo)
+		strncpy(r->nome, nome, sizeof(r->nome) - 1);
+
+	if (sync) {
+		slab_msync(r, sizeof(slab_registo));
+		if (novo)
+			slab_msync(slab.cab, sizeof(slab_cabecalho));
+	}
+
+	slab_desbloqueia();
+}
+
+void slab_sincroniza (void)
+{
+	ifjmp(slab.fd < 0, out);
+
+	slab_bloqueia(LOCK_SH);
+	check(fdatasync(slab.fd) < 0, "could not sync slab file");
+	slab_desbloqueia();
+
+out:
+	return;
+}